@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "Report.hpp"
+
+namespace ws::bench {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    // fewer sizes and iterations, for a smoke run in CI
+    bool quick = false;
+    Report report;
+};
+
+// value at `p` (0..1) of the sorted samples, 0 if there are none
+double percentile(std::vector<double> values, double p);
+
+// in-process, no sockets
+void benchMask(Options& options);
+void benchUtf8(Options& options);
+void benchDeflate(Options& options);
+void benchCodec(Options& options);
+
+// against the loopback EchoServer, over TCP and (when available) TLS
+void benchThroughput(Options& options);
+void benchLatency(Options& options);
+void benchSetup(Options& options);
+// send()/recv() against io_uring over plain TCP, Linux only
+void benchUring(Options& options);
+// callbacks against coroutines with many connections on one reactor, Linux only
+void benchCoroutines(Options& options);
+// how much a connection holds unsent when the sender outpaces the socket, with each overflow policy
+void benchBackpressure(Options& options);
+// `echoPort` is an echo server in another process (see spawnEchoProcess), so its memory is not counted
+void benchMemory(Options& options, uint16_t echoPort);
+// wolfSSL against kernel TLS, with a TLS echo server in another process so only the client's CPU time is counted
+void benchKernelTls(Options& options, uint16_t echoPort);
+
+// against any echo server, e.g. `miniws-bench connect wss://localhost:9443 50`
+void benchConnect(Options& options, std::string_view url, size_t count);
+
+// Forks a process running an EchoServer and returns its port. Must be called before any
+// thread is started. The server exits once this process does. std::nullopt where fork() is unavailable.
+std::optional<uint16_t> spawnEchoProcess(bool tls = false);
+
+}
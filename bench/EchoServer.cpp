@@ -0,0 +1,355 @@
+#include "EchoServer.hpp"
+
+#include <FrameReader.hpp>
+#include <Frame.hpp>
+#include <Handshake.hpp>
+#include <SocketUtil.hpp>
+#include <TcpTransport.hpp>
+
+#include <wolfssl/options.h>
+#include <wolfssl/ssl.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <string_view>
+
+#ifndef _WIN32
+# include <netinet/in.h>
+#endif
+
+using namespace geode;
+
+namespace ws::bench {
+
+namespace {
+#ifdef _WIN32
+    constexpr int ShutdownBoth = SD_BOTH;
+#else
+    constexpr int ShutdownBoth = SHUT_RDWR;
+#endif
+
+    // server side of a TLS connection, only as much as the echo loop needs
+    class ServerTlsTransport : public BaseTransport {
+    public:
+        ServerTlsTransport(WOLFSSL* ssl, qsox::SockFd fd) : ssl(ssl), fd(fd) {}
+
+        ~ServerTlsTransport() override {
+            wolfSSL_free(ssl);
+            closeSocket(fd);
+        }
+
+        Result<size_t> send(const void* data, size_t size) override {
+            int written = wolfSSL_write(ssl, data, static_cast<int>(size));
+            if (written <= 0) {
+                return Err(fmt::format("TLS write failed ({})", wolfSSL_get_error(ssl, written)));
+            }
+
+            return Ok(static_cast<size_t>(written));
+        }
+
+        Result<size_t> receive(void* buffer, size_t size) override {
+            int received = wolfSSL_read(ssl, buffer, static_cast<int>(size));
+            if (received <= 0) {
+                // close_notify or a dropped socket, either way the connection is over
+                return Ok(0);
+            }
+
+            return Ok(static_cast<size_t>(received));
+        }
+
+        Result<> shutdown() override {
+            // only the socket: wolfSSL_shutdown would race the thread blocked in wolfSSL_read
+            ::shutdown(fd, ShutdownBoth);
+            return Ok();
+        }
+
+    private:
+        WOLFSSL* ssl;
+        qsox::SockFd fd;
+    };
+
+    std::optional<std::string_view> findHeader(std::string_view request, std::string_view name) {
+        size_t pos = request.find("\r\n");
+
+        while (pos != std::string_view::npos && pos + 2 < request.size()) {
+            size_t start = pos + 2;
+            size_t end = request.find("\r\n", start);
+            auto line = request.substr(start, end - start);
+
+            size_t colon = line.find(':');
+            if (colon == name.size() && std::equal(name.begin(), name.end(), line.begin(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            })) {
+                auto value = line.substr(colon + 1);
+                while (!value.empty() && value.front() == ' ') {
+                    value.remove_prefix(1);
+                }
+
+                return value;
+            }
+
+            pos = end;
+        }
+
+        return std::nullopt;
+    }
+
+    Result<> sendFrame(BaseTransport& transport, Opcode opcode, std::span<const uint8_t> payload) {
+        uint8_t header[MaxFrameHeaderSize];
+        size_t headerSize = encodeFrameHeader(header, static_cast<uint8_t>(opcode), payload.size(), std::nullopt);
+
+        ConstBuffer buffers[] = {{header, headerSize}, {payload.data(), payload.size()}};
+        GEODE_UNWRAP(transport.sendAllv(buffers));
+
+        return Ok();
+    }
+
+    // reads the upgrade request and accepts it, handing anything sent after it to `reader`
+    Result<> acceptUpgrade(BaseTransport& transport, FrameReader& reader) {
+        std::string request;
+        uint8_t buffer[4096];
+        size_t end;
+
+        while ((end = request.find("\r\n\r\n")) == std::string::npos) {
+            if (request.size() > 16 * 1024) {
+                return Err("upgrade request too large");
+            }
+
+            GEODE_UNWRAP_INTO(size_t received, transport.receive(buffer, sizeof(buffer)));
+            if (received == 0) {
+                return Err("connection closed during the upgrade");
+            }
+
+            request.append(reinterpret_cast<const char*>(buffer), received);
+        }
+
+        auto key = findHeader(std::string_view(request).substr(0, end + 2), "Sec-WebSocket-Key");
+        if (!key) {
+            return Err("upgrade request without Sec-WebSocket-Key");
+        }
+
+        auto response = fmt::format(
+            "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: {}\r\n\r\n",
+            expectedAcceptKey(*key)
+        );
+
+        GEODE_UNWRAP(transport.sendAll(response.data(), response.size()));
+
+        // a pipelining client may have sent its first frames right behind the request
+        auto leftover = std::string_view(request).substr(end + 4);
+        reader.feed({reinterpret_cast<const uint8_t*>(leftover.data()), leftover.size()});
+
+        return Ok();
+    }
+}
+
+Result<std::unique_ptr<EchoServer>> EchoServer::start(bool tls) {
+    WOLFSSL_CTX* ctx = nullptr;
+
+    if (tls) {
+#ifdef MINIWS_BENCH_CERTS
+        wolfSSL_Init();
+
+        ctx = wolfSSL_CTX_new(wolfTLSv1_3_server_method());
+        if (!ctx) {
+            return Err("unable to create a TLS server context");
+        }
+
+        if (wolfSSL_CTX_use_certificate_chain_file(ctx, MINIWS_BENCH_CERTS "/server-cert.pem") != WOLFSSL_SUCCESS
+            || wolfSSL_CTX_use_PrivateKey_file(ctx, MINIWS_BENCH_CERTS "/server-key.pem", WOLFSSL_FILETYPE_PEM) != WOLFSSL_SUCCESS
+        ) {
+            wolfSSL_CTX_free(ctx);
+            return Err("unable to load the test certificate from " MINIWS_BENCH_CERTS);
+        }
+#else
+        return Err("built without MINIWS_BENCH_CERTS, TLS is unavailable");
+#endif
+    }
+
+    auto fail = [&](std::string message) -> Result<std::unique_ptr<EchoServer>> {
+        if (ctx) {
+            wolfSSL_CTX_free(ctx);
+        }
+
+        return Err(std::move(message));
+    };
+
+    auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == qsox::BaseSocket::InvalidSockFd) {
+        return fail(lastSocketError());
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addrLen = sizeof(addr);
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+        || ::listen(fd, SOMAXCONN) != 0
+        || ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0
+    ) {
+        auto error = lastSocketError();
+        closeSocket(fd);
+        return fail(std::move(error));
+    }
+
+    auto server = std::unique_ptr<EchoServer>(new EchoServer(fd, ntohs(addr.sin_port), ctx));
+    server->acceptThread = std::thread([server = server.get()] {
+        server->acceptLoop();
+    });
+
+    return Ok(std::move(server));
+}
+
+EchoServer::~EchoServer() {
+    stopping = true;
+
+    // wakes accept(), then every connection blocked in a read
+#ifdef _WIN32
+    closeSocket(listener);
+#else
+    ::shutdown(listener, ShutdownBoth);
+#endif
+    acceptThread.join();
+
+    std::vector<std::thread> running;
+    {
+        std::lock_guard lock(mutex);
+        for (auto& connection : connections) {
+            (void) connection->shutdown();
+        }
+
+        running = std::move(workers);
+    }
+
+    for (auto& worker : running) {
+        worker.join();
+    }
+
+#ifndef _WIN32
+    closeSocket(listener);
+#endif
+
+    if (tlsContext) {
+        wolfSSL_CTX_free(tlsContext);
+    }
+}
+
+std::string EchoServer::url() const {
+    return fmt::format("{}://127.0.0.1:{}", tlsContext ? "wss" : "ws", listenPort);
+}
+
+size_t EchoServer::connectionCount() {
+    std::lock_guard lock(mutex);
+    return connections.size();
+}
+
+void EchoServer::acceptLoop() {
+    while (!stopping) {
+        auto fd = ::accept(listener, nullptr, nullptr);
+        if (fd == qsox::BaseSocket::InvalidSockFd) {
+            if (stopping) {
+                return;
+            }
+
+            continue;
+        }
+
+        std::lock_guard lock(mutex);
+        if (stopping) {
+            closeSocket(fd);
+            return;
+        }
+
+        workers.emplace_back([this, fd] {
+            auto transport = this->wrap(fd);
+            if (transport.isErr()) {
+                return;
+            }
+
+            this->serve(std::move(transport).unwrap());
+        });
+    }
+}
+
+Result<std::shared_ptr<BaseTransport>> EchoServer::wrap(qsox::SockFd fd) {
+    if (!tlsContext) {
+        return Ok(std::make_shared<TcpTransport>(fd));
+    }
+
+    auto ssl = wolfSSL_new(tlsContext);
+    if (!ssl) {
+        closeSocket(fd);
+        return Err("unable to create a TLS session");
+    }
+
+    wolfSSL_set_fd(ssl, static_cast<int>(fd));
+    auto transport = std::make_shared<ServerTlsTransport>(ssl, fd);
+
+    if (wolfSSL_accept(ssl) != WOLFSSL_SUCCESS) {
+        return Err("TLS handshake failed");
+    }
+
+    return Ok(std::move(transport));
+}
+
+void EchoServer::serve(std::shared_ptr<BaseTransport> transport) {
+    {
+        std::lock_guard lock(mutex);
+        if (stopping) {
+            return;
+        }
+
+        connections.push_back(transport);
+    }
+
+    FrameReader reader;
+
+    auto run = [&]() -> Result<> {
+        GEODE_UNWRAP(acceptUpgrade(*transport, reader));
+
+        while (true) {
+            while (auto event = reader.next()) {
+                if (event->type == FrameEvent::Type::Error) {
+                    uint8_t code[2] = {static_cast<uint8_t>(event->closeCode >> 8), static_cast<uint8_t>(event->closeCode)};
+                    return sendFrame(*transport, Opcode::Close, code);
+                }
+
+                switch (event->opcode) {
+                    case Opcode::Text:
+                    case Opcode::Binary:
+                        GEODE_UNWRAP(sendFrame(*transport, event->opcode, event->payload));
+                        break;
+
+                    case Opcode::Ping:
+                        GEODE_UNWRAP(sendFrame(*transport, Opcode::Pong, event->payload));
+                        break;
+
+                    case Opcode::Close:
+                        return sendFrame(*transport, Opcode::Close, event->payload);
+
+                    default:
+                        break;
+                }
+            }
+
+            GEODE_UNWRAP_INTO(size_t received, reader.fill(*transport));
+            if (received == 0) {
+                return Ok();
+            }
+        }
+    };
+
+    // errors only mean the client went away, which is how every benchmark connection ends
+    (void) run();
+
+    std::lock_guard lock(mutex);
+    connections.erase(std::find(connections.begin(), connections.end(), transport));
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Geode/Result.hpp>
+#include <BaseTransport.hpp>
+#include <qsox/BaseSocket.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct WOLFSSL_CTX;
+
+namespace ws::bench {
+
+// Minimal WebSocket echo server on 127.0.0.1, so benchmarks need no outside process.
+// Every connection gets its own thread: data messages come back unmasked and unchanged,
+// pings are answered, and a close is echoed before the connection is dropped.
+// No extensions are negotiated.
+class EchoServer {
+public:
+    // listens on an ephemeral port. TLS 1.3 uses the test certificate that ships with wolfSSL,
+    // so it fails when the build did not point MINIWS_BENCH_CERTS at it
+    static geode::Result<std::unique_ptr<EchoServer>> start(bool tls);
+    ~EchoServer();
+
+    EchoServer(const EchoServer&) = delete;
+    EchoServer& operator=(const EchoServer&) = delete;
+
+    uint16_t port() const {
+        return listenPort;
+    }
+
+    // ws://127.0.0.1:<port> or wss://...
+    std::string url() const;
+
+    // connections currently being served
+    size_t connectionCount();
+
+private:
+    qsox::SockFd listener;
+    uint16_t listenPort;
+    WOLFSSL_CTX* tlsContext;
+
+    std::atomic<bool> stopping = false;
+    std::thread acceptThread;
+
+    std::mutex mutex;
+    // shut down on destruction, which wakes the thread blocked reading from it
+    std::vector<std::shared_ptr<BaseTransport>> connections;
+    std::vector<std::thread> workers;
+
+    EchoServer(qsox::SockFd listener, uint16_t port, WOLFSSL_CTX* tlsContext)
+        : listener(listener), listenPort(port), tlsContext(tlsContext) {}
+
+    void acceptLoop();
+    void serve(std::shared_ptr<BaseTransport> transport);
+    geode::Result<std::shared_ptr<BaseTransport>> wrap(qsox::SockFd fd);
+};
+
+}
@@ -0,0 +1,103 @@
+#include "MemoryTransport.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace geode;
+
+namespace ws::bench {
+
+std::pair<std::shared_ptr<MemoryTransport>, std::shared_ptr<MemoryTransport>> MemoryTransport::createPair() {
+    auto aToB = std::make_shared<Pipe>();
+    auto bToA = std::make_shared<Pipe>();
+
+    return {
+        std::shared_ptr<MemoryTransport>(new MemoryTransport(bToA, aToB)),
+        std::shared_ptr<MemoryTransport>(new MemoryTransport(aToB, bToA)),
+    };
+}
+
+Result<size_t> MemoryTransport::send(const void* data, size_t size) {
+    ConstBuffer buffer{data, size};
+    return this->sendv({&buffer, 1});
+}
+
+Result<size_t> MemoryTransport::sendv(std::span<const ConstBuffer> buffers) {
+    size_t total = 0;
+
+    {
+        std::lock_guard lock(outbound->mutex);
+        if (outbound->closed) {
+            return Err("connection closed");
+        }
+
+        // reclaim what the reader already took before growing
+        if (outbound->head > 0 && outbound->head == outbound->data.size()) {
+            outbound->data.clear();
+            outbound->head = 0;
+        }
+
+        for (auto& buffer : buffers) {
+            auto bytes = static_cast<const uint8_t*>(buffer.data);
+            outbound->data.insert(outbound->data.end(), bytes, bytes + buffer.size);
+            total += buffer.size;
+        }
+    }
+
+    outbound->cv.notify_one();
+    this->countWrite(total);
+
+    return Ok(total);
+}
+
+size_t MemoryTransport::take(Pipe& pipe, void* buffer, size_t size) {
+    size_t count = std::min(size, pipe.data.size() - pipe.head);
+    std::memcpy(buffer, pipe.data.data() + pipe.head, count);
+    pipe.head += count;
+
+    return count;
+}
+
+Result<size_t> MemoryTransport::receive(void* buffer, size_t size) {
+    std::unique_lock lock(inbound->mutex);
+    inbound->cv.wait(lock, [&] { return inbound->head < inbound->data.size() || inbound->closed; });
+
+    // after a shutdown, whatever is left is still delivered before the end of stream
+    size_t count = take(*inbound, buffer, size);
+    this->countRead(count);
+
+    return Ok(count);
+}
+
+Result<std::optional<size_t>> MemoryTransport::tryReceive(void* buffer, size_t size) {
+    std::lock_guard lock(inbound->mutex);
+
+    if (inbound->head == inbound->data.size() && !inbound->closed) {
+        return Ok(std::nullopt);
+    }
+
+    size_t count = take(*inbound, buffer, size);
+    this->countRead(count);
+
+    return Ok(std::optional<size_t>{count});
+}
+
+Result<> MemoryTransport::shutdown() {
+    for (auto& pipe : {inbound, outbound}) {
+        {
+            std::lock_guard lock(pipe->mutex);
+            pipe->closed = true;
+        }
+
+        pipe->cv.notify_all();
+    }
+
+    return Ok();
+}
+
+size_t MemoryTransport::available() const {
+    std::lock_guard lock(inbound->mutex);
+    return inbound->data.size() - inbound->head;
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <BaseTransport.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace ws::bench {
+
+// One end of an in-process connection: what one end sends, the other receives, with no
+// kernel or network in between. receive() blocks until data arrives or the peer shuts down.
+class MemoryTransport : public BaseTransport {
+public:
+    static std::pair<std::shared_ptr<MemoryTransport>, std::shared_ptr<MemoryTransport>> createPair();
+
+    geode::Result<size_t> send(const void* data, size_t size) override;
+    geode::Result<size_t> receive(void* buffer, size_t size) override;
+    geode::Result<> shutdown() override;
+
+    geode::Result<size_t> sendv(std::span<const ConstBuffer> buffers) override;
+    geode::Result<std::optional<size_t>> tryReceive(void* buffer, size_t size) override;
+
+    // bytes sent by the peer and not yet received
+    size_t available() const;
+
+private:
+    struct Pipe {
+        mutable std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<uint8_t> data;
+        size_t head = 0;
+        bool closed = false;
+    };
+
+    std::shared_ptr<Pipe> inbound;
+    std::shared_ptr<Pipe> outbound;
+
+    MemoryTransport(std::shared_ptr<Pipe> inbound, std::shared_ptr<Pipe> outbound)
+        : inbound(std::move(inbound)), outbound(std::move(outbound)) {}
+
+    // takes up to `size` bytes, the pipe must be locked
+    static size_t take(Pipe& pipe, void* buffer, size_t size);
+};
+
+}
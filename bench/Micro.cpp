@@ -0,0 +1,412 @@
+#include "Bench.hpp"
+#include "MemoryTransport.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <miniws.hpp>
+#include <Deflate.hpp>
+#include <Frame.hpp>
+#include <FrameReader.hpp>
+#include <Mask.hpp>
+#include <Random.hpp>
+#include <Utf8.hpp>
+
+namespace ws::bench {
+
+// the masking loop miniws used before the vectorized kernels, kept as the baseline
+static void maskBytewise(uint8_t* data, size_t size, const uint8_t key[4]) {
+    for (size_t i = 0; i < size; ++i) {
+        data[i] ^= key[i % 4];
+    }
+}
+
+template <typename F>
+static double measureGBps(size_t bytesPerRun, std::chrono::milliseconds duration, F&& fn) {
+    // run for a fixed time so small buffers get enough iterations
+    size_t runs = 0;
+    auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+
+    do {
+        fn();
+        ++runs;
+        elapsed = Clock::now() - start;
+    } while (elapsed < duration);
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return static_cast<double>(bytesPerRun) * runs / seconds / 1e9;
+}
+
+static std::chrono::milliseconds runTime(const Options& options) {
+    return std::chrono::milliseconds(options.quick ? 50 : 200);
+}
+
+static bool verifyMask() {
+    std::vector<uint8_t> input(1021), expected, actual(input.size());
+    fillRandom(input.data(), input.size());
+
+    uint32_t key = randomMaskKey();
+    uint8_t keyBytes[4];
+    std::memcpy(keyBytes, &key, 4);
+
+    expected = input;
+    maskBytewise(expected.data(), expected.size(), keyBytes);
+
+    // masking in uneven chunks must give the same result as one pass
+    size_t offset = 0;
+    for (size_t chunk : {3, 17, 64, 1, 255, 681}) {
+        applyMaskCopy(actual.data() + offset, input.data() + offset, chunk, key, offset);
+        offset += chunk;
+    }
+
+    return offset == input.size() && actual == expected;
+}
+
+void benchMask(Options& options) {
+    if (!verifyMask()) {
+        std::printf("mask: kernel output does not match the bytewise loop!\n");
+        return;
+    }
+
+    uint32_t key = randomMaskKey();
+    uint8_t keyBytes[4];
+    std::memcpy(keyBytes, &key, 4);
+
+    std::printf("%-10s %14s %14s %14s\n", "size", "bytewise GB/s", "in-place GB/s", "copy GB/s");
+
+    for (size_t size : {64, 1024, 16 * 1024, 1024 * 1024, 16 * 1024 * 1024}) {
+        std::vector<uint8_t> buffer(size), output(size);
+        fillRandom(buffer.data(), buffer.size());
+
+        auto duration = runTime(options);
+        double before = measureGBps(size, duration, [&] { maskBytewise(buffer.data(), size, keyBytes); });
+        double inPlace = measureGBps(size, duration, [&] { applyMask(buffer.data(), size, key); });
+        double copy = measureGBps(size, duration, [&] { applyMaskCopy(output.data(), buffer.data(), size, key); });
+
+        std::printf("%-10zu %14.2f %14.2f %14.2f\n", size, before, inPlace, copy);
+
+        options.report.add("mask", {{"size", double(size)}}, {
+            {"bytewise_gbps", before},
+            {"in_place_gbps", inPlace},
+            {"copy_gbps", copy},
+        });
+    }
+}
+
+// the bytewise state machine, kept as the reference the vector kernels are checked against
+static bool validateBytewise(const uint8_t* data, size_t size) {
+    size_t i = 0;
+    while (i < size) {
+        uint8_t lead = data[i];
+        size_t length = lead < 0x80 ? 1 : lead < 0xc2 ? 0 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : lead < 0xf5 ? 4 : 0;
+        if (length == 0 || i + length > size) {
+            return false;
+        }
+
+        uint8_t low = lead == 0xe0 ? 0xa0 : lead == 0xf0 ? 0x90 : 0x80;
+        uint8_t high = lead == 0xed ? 0x9f : lead == 0xf4 ? 0x8f : 0xbf;
+
+        for (size_t k = 1; k < length; ++k) {
+            uint8_t byte = data[i + k];
+            if (byte < low || byte > high) {
+                return false;
+            }
+
+            low = 0x80;
+            high = 0xbf;
+        }
+
+        i += length;
+    }
+
+    return true;
+}
+
+// mostly ASCII with some 2, 3 and 4 byte characters, like chat messages in several languages
+static std::vector<uint8_t> makeText(size_t size, bool asciiOnly) {
+    static const char* pieces[] = { "hello ", "world ", "caf\xc3\xa9 ", "\xe2\x82\xac" "42 ", "\xe6\x97\xa5\xe6\x9c\xac ", "\xf0\x9f\x98\x80 " };
+
+    std::vector<uint8_t> text;
+    while (text.size() < size) {
+        const char* piece = pieces[asciiOnly ? text.size() % 2 : randomMaskKey() % 6];
+        text.insert(text.end(), piece, piece + std::strlen(piece));
+    }
+
+    // cut back to a character boundary
+    text.resize(size);
+    while (!text.empty() && !validateBytewise(text.data(), text.size())) {
+        text.pop_back();
+    }
+
+    return text;
+}
+
+static bool verifyUtf8() {
+    for (int round = 0; round < 200; ++round) {
+        auto text = makeText(1 + randomMaskKey() % 4096, false);
+
+        // flipping a byte now and then makes most rounds invalid somewhere
+        if (round % 2 && !text.empty()) {
+            text[randomMaskKey() % text.size()] ^= static_cast<uint8_t>(1 << (randomMaskKey() % 8));
+        }
+
+        bool expected = validateBytewise(text.data(), text.size());
+        uint32_t key = randomMaskKey();
+
+        auto masked = text;
+        applyMask(masked.data(), masked.size(), key);
+
+        // uneven pieces, split inside characters too
+        Utf8Validator validator;
+        size_t offset = 0;
+        while (offset < masked.size()) {
+            size_t piece = std::min<size_t>(masked.size() - offset, 1 + randomMaskKey() % 300);
+            validator.feedMasked({masked.data() + offset, piece}, key, offset);
+            offset += piece;
+        }
+
+        if (validator.complete() != expected || (expected && masked != text)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Unmasking and validating a text payload as two passes against the fused kernel.
+void benchUtf8(Options& options) {
+    if (!verifyUtf8()) {
+        std::printf("utf8: validator does not match the bytewise state machine!\n");
+        return;
+    }
+
+    uint32_t key = randomMaskKey();
+
+    std::printf("%-6s %-10s %14s %14s %14s %14s\n", "", "size", "bytewise GB/s", "validate GB/s", "two-pass GB/s", "fused GB/s");
+
+    for (bool asciiOnly : {true, false}) {
+        const char* name = asciiOnly ? "ascii" : "mixed";
+
+        for (size_t size : {64, 1024, 16 * 1024, 1024 * 1024}) {
+            auto text = makeText(size, asciiOnly);
+            auto duration = runTime(options);
+
+            // results go somewhere the compiler cannot see through, or it drops the bytewise loop entirely
+            volatile bool sink = false;
+
+            // the masking runs flip the text back and forth, the validator does not care which way it is
+            double bytewise = measureGBps(text.size(), duration, [&] { sink = validateBytewise(text.data(), text.size()); });
+            double validate = measureGBps(text.size(), duration, [&] { sink = isValidUtf8(text); });
+            double twoPass = measureGBps(text.size(), duration, [&] {
+                applyMask(text.data(), text.size(), key);
+                sink = isValidUtf8(text);
+            });
+            double fused = measureGBps(text.size(), duration, [&] {
+                Utf8Validator validator;
+                sink = validator.feedMasked(text, key);
+            });
+
+            std::printf("%-6s %-10zu %14.2f %14.2f %14.2f %14.2f\n", name, text.size(), bytewise, validate, twoPass, fused);
+
+            options.report.add("utf8", {{"text", name}, {"size", double(text.size())}}, {
+                {"bytewise_gbps", bytewise},
+                {"validate_gbps", validate},
+                {"two_pass_gbps", twoPass},
+                {"fused_gbps", fused},
+            });
+        }
+    }
+}
+
+// something shaped like our market data feed: small JSON objects with lots of repeated keys
+static std::vector<std::string> makeFeedMessages(size_t count) {
+    std::vector<std::string> messages;
+    messages.reserve(count);
+
+    const char* symbols[] = { "BTC-USD", "ETH-USD", "SOL-USD", "DOGE-USD", "ADA-USD" };
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t noise = randomMaskKey();
+        char message[512];
+        int len = std::snprintf(message, sizeof(message),
+            "{\"type\":\"ticker\",\"sequence\":%zu,\"product_id\":\"%s\",\"price\":\"%u.%02u\","
+            "\"best_bid\":\"%u.%02u\",\"best_ask\":\"%u.%02u\",\"side\":\"%s\",\"last_size\":\"0.%06u\","
+            "\"time\":\"2024-05-01T12:00:%02zu.%06uZ\",\"trade_id\":%u}",
+            1000000 + i, symbols[i % 5],
+            30000 + noise % 100, noise % 100,
+            30000 + noise % 100, (noise >> 8) % 100,
+            30000 + noise % 100, (noise >> 16) % 100,
+            (noise & 1) ? "buy" : "sell", noise % 1000000,
+            i % 60, noise % 1000000, noise);
+        messages.emplace_back(message, len);
+    }
+
+    return messages;
+}
+
+void benchDeflate(Options& options) {
+    auto messages = makeFeedMessages(options.quick ? 2000 : 20000);
+
+    size_t rawBytes = 0;
+    for (auto& msg : messages) {
+        rawBytes += msg.size();
+    }
+
+    // 2 byte header plus extended length for anything past 125 bytes, as the server would frame it
+    auto wireSize = [](size_t payload) {
+        return payload + (payload < 126 ? 2 : 4);
+    };
+
+    size_t plainWire = 0;
+    for (auto& msg : messages) {
+        plainWire += wireSize(msg.size());
+    }
+
+    std::printf("%zu feed messages, %.1f bytes on average\n", messages.size(), double(rawBytes) / messages.size());
+    std::printf("%-28s %12s %8s %14s %14s\n", "mode", "wire B/msg", "ratio", "deflate ns/msg", "inflate ns/msg");
+    std::printf("%-28s %12.1f %8.2f %14s %14s\n", "uncompressed", double(plainWire) / messages.size(), 1.0, "-", "-");
+
+    struct Mode {
+        const char* name;
+        int level;
+        bool noContextTakeover;
+    };
+
+    for (auto mode : {
+        Mode{"level 1, context takeover", 1, false},
+        Mode{"level 6, context takeover", 6, false},
+        Mode{"level 1, no takeover", 1, true},
+        Mode{"level 6, no takeover", 6, true},
+    }) {
+        CompressionOptions compression{
+            .clientNoContextTakeover = mode.noContextTakeover,
+            .serverNoContextTakeover = mode.noContextTakeover,
+            .level = mode.level,
+            .minSize = 0
+        };
+        DeflateParams params{
+            .clientNoContextTakeover = mode.noContextTakeover,
+            .serverNoContextTakeover = mode.noContextTakeover
+        };
+
+        // one side compresses, the other inflates, like the two ends of a connection
+        auto sender = PerMessageDeflate::create(compression, params).unwrap();
+        auto receiver = PerMessageDeflate::create(compression, params).unwrap();
+
+        std::vector<std::vector<uint8_t>> compressed;
+        compressed.reserve(messages.size());
+
+        size_t wire = 0;
+        auto start = Clock::now();
+        for (auto& msg : messages) {
+            auto out = sender->compress({reinterpret_cast<const uint8_t*>(msg.data()), msg.size()}).unwrap();
+            compressed.emplace_back(out.begin(), out.end());
+            wire += wireSize(out.size());
+        }
+        double deflateNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / messages.size();
+
+        bool ok = true;
+        start = Clock::now();
+        for (size_t i = 0; i < compressed.size(); ++i) {
+            auto res = receiver->decompress(compressed[i], 1 << 20);
+            ok = ok && res.isOk() && res.unwrap().size() == messages[i].size();
+        }
+        double inflateNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / messages.size();
+
+        std::printf("%-28s %12.1f %8.2f %14.0f %14.0f%s\n",
+            mode.name, double(wire) / messages.size(), double(plainWire) / wire, deflateNs, inflateNs,
+            ok ? "" : "  (round trip FAILED)");
+
+        options.report.add("deflate", {{"mode", mode.name}}, {
+            {"wire_bytes_per_msg", double(wire) / messages.size()},
+            {"ratio", double(plainWire) / wire},
+            {"deflate_ns_per_msg", deflateNs},
+            {"inflate_ns_per_msg", inflateNs},
+            {"round_trip_ok", ok ? 1.0 : 0.0},
+        });
+    }
+}
+
+// Frame layer alone, over an in-memory transport: encoding is what a client does to send
+// (header plus masking copy), decoding is parsing and unmasking those same frames.
+void benchCodec(Options& options) {
+    auto [sender, receiver] = MemoryTransport::createPair();
+
+    std::vector<size_t> sizes = options.quick
+        ? std::vector<size_t>{16, 1024, 1024 * 1024}
+        : std::vector<size_t>{16, 125, 1024, 16 * 1024, 1024 * 1024};
+
+    std::printf("%-10s %14s %12s %14s %12s\n", "size", "encode frm/s", "encode GB/s", "decode frm/s", "decode GB/s");
+
+    for (size_t size : sizes) {
+        std::vector<uint8_t> payload(size);
+        fillRandom(payload.data(), payload.size());
+
+        // batches of about 4 MiB, so the pipe stays small and the reader sees realistic bursts
+        size_t batch = std::max<size_t>(1, 4 * 1024 * 1024 / (size + MaxFrameHeaderSize));
+
+        FrameReader reader;
+        std::vector<uint8_t> frame;
+        auto encodeTime = Clock::duration::zero();
+        auto decodeTime = Clock::duration::zero();
+        size_t frames = 0;
+        bool ok = true;
+
+        while (ok && encodeTime + decodeTime < runTime(options)) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < batch; ++i) {
+                uint8_t header[MaxFrameHeaderSize];
+                uint32_t key = randomMaskKey();
+                size_t headerSize = encodeFrameHeader(header, static_cast<uint8_t>(Opcode::Binary), size, key);
+
+                // masked while copied into the frame, as the reactor encodes into its outbox
+                frame.resize(headerSize + size);
+                std::memcpy(frame.data(), header, headerSize);
+                applyMaskCopy(frame.data() + headerSize, payload.data(), size, key);
+
+                ok = ok && sender->sendAll(frame.data(), frame.size()).isOk();
+            }
+            auto encoded = Clock::now();
+            encodeTime += encoded - start;
+
+            size_t decoded = 0;
+            while (ok && decoded < batch) {
+                if (auto event = reader.next()) {
+                    ok = event->type == FrameEvent::Type::Message && event->payload.size() == size;
+                    ++decoded;
+                    continue;
+                }
+
+                ok = reader.fill(*receiver).isOk();
+            }
+            decodeTime += Clock::now() - encoded;
+
+            frames += batch;
+        }
+
+        if (!ok) {
+            std::printf("%-10zu  (round trip FAILED)\n", size);
+            continue;
+        }
+
+        auto rate = [&](Clock::duration time) {
+            return frames / std::chrono::duration<double>(time).count();
+        };
+
+        double encodeRate = rate(encodeTime), decodeRate = rate(decodeTime);
+        std::printf("%-10zu %14.0f %12.2f %14.0f %12.2f\n",
+            size, encodeRate, encodeRate * size / 1e9, decodeRate, decodeRate * size / 1e9);
+
+        options.report.add("codec", {{"size", double(size)}}, {
+            {"encode_frames_per_sec", encodeRate},
+            {"encode_gbps", encodeRate * size / 1e9},
+            {"decode_frames_per_sec", decodeRate},
+            {"decode_gbps", decodeRate * size / 1e9},
+        });
+    }
+}
+
+}
@@ -0,0 +1,989 @@
+#include "Bench.hpp"
+#include "EchoServer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <miniws.hpp>
+#include <Reactor.hpp>
+#include <Random.hpp>
+#include <Task.hpp>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/resource.h>
+# include <unistd.h>
+#endif
+
+namespace ws::bench {
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+
+    std::sort(values.begin(), values.end());
+    return values[static_cast<size_t>(p * (values.size() - 1))];
+}
+
+// A closed client's reading thread may still be on its way out, so clients are never destroyed
+// before the process exits; scenarios hand them here when they are done with them.
+static void retire(std::unique_ptr<Client> client) {
+    static auto* finished = new std::vector<std::unique_ptr<Client>>();
+
+    client->close();
+    finished->push_back(std::move(client));
+}
+
+struct ConnectSample {
+    double firstMessageMs;
+    bool resumed;
+    size_t earlyDataBytes;
+};
+
+// opens a connection, sends one message and waits for the echo
+static std::optional<ConnectSample> connectOnce(Client& client, std::string_view url) {
+    struct Waiter {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool received = false;
+    };
+
+    // shared with the callback, which stays installed after this returns
+    auto waiter = std::make_shared<Waiter>();
+
+    // no sink, so nothing is even formatted
+    client.onLogRecord(nullptr);
+    client.onMessageView([waiter](std::string_view) {
+        std::lock_guard lock(waiter->mutex);
+        waiter->received = true;
+        waiter->cv.notify_one();
+    });
+
+    auto start = Clock::now();
+
+    // queued before open, so pipelining and early data can carry it
+    client.send("ping");
+    if (client.open(url).isErr()) {
+        return std::nullopt;
+    }
+
+    std::unique_lock lock(waiter->mutex);
+    if (!waiter->cv.wait_for(lock, std::chrono::seconds(5), [&] { return waiter->received; })) {
+        return std::nullopt;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return ConnectSample{ms, client.connectTimings().tlsResumed, client.connectTimings().earlyDataBytes};
+}
+
+// echoes seen by a client's callback, waited on by the thread driving the benchmark
+struct EchoCounter {
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t received = 0;
+
+    void add() {
+        std::lock_guard lock(mutex);
+        ++received;
+        cv.notify_all();
+    }
+
+    bool waitFor(size_t count, std::chrono::seconds timeout = std::chrono::seconds(60)) {
+        std::unique_lock lock(mutex);
+        return cv.wait_for(lock, timeout, [&] { return received >= count; });
+    }
+};
+
+struct Target {
+    const char* name;
+    std::unique_ptr<EchoServer> server;
+    // for the clients, null over plain TCP
+    std::shared_ptr<TlsContext> tls;
+};
+
+// a plain and a TLS echo server; TLS is left out (and says why) when it cannot be set up
+static std::vector<Target> startTargets() {
+    std::vector<Target> targets;
+
+    if (auto tcp = EchoServer::start(false); tcp.isOk()) {
+        targets.push_back({"tcp", std::move(tcp).unwrap(), nullptr});
+    } else {
+        std::printf("  tcp: skipped, %s\n", tcp.unwrapErr().c_str());
+    }
+
+    auto tls = EchoServer::start(true);
+    if (tls.isErr()) {
+        std::printf("  tls: skipped, %s\n", tls.unwrapErr().c_str());
+        return targets;
+    }
+
+    auto context = TlsContext::create();
+    if (context.isErr()) {
+        std::printf("  tls: skipped, %s\n", context.unwrapErr().c_str());
+        return targets;
+    }
+
+    targets.push_back({"tls", std::move(tls).unwrap(), std::move(context).unwrap()});
+    return targets;
+}
+
+static std::unique_ptr<Client> connectClient(const Target& target, Reactor* reactor = nullptr) {
+    auto client = std::make_unique<Client>();
+    if (target.tls) {
+        client->setTlsContext(target.tls);
+    }
+    if (reactor) {
+        client->setReactor(reactor);
+    }
+
+    if (!connectOnce(*client, target.server->url())) {
+        std::printf("  %s: unable to connect to %s\n", target.name, target.server->url().c_str());
+        retire(std::move(client));
+        return nullptr;
+    }
+
+    return client;
+}
+
+static std::vector<std::byte> randomPayload(size_t size) {
+    std::vector<std::byte> payload(size);
+    fillRandom(reinterpret_cast<uint8_t*>(payload.data()), payload.size());
+    return payload;
+}
+
+// Messages per second through a full round trip, with a window of about 4 MiB in flight
+// so the sender neither waits for every echo nor queues the whole run at once.
+void benchThroughput(Options& options) {
+    std::vector<size_t> sizes = options.quick
+        ? std::vector<size_t>{16, 4 * 1024, 1024 * 1024}
+        : std::vector<size_t>{16, 256, 4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024};
+
+    size_t budget = options.quick ? 8 * 1024 * 1024 : 64 * 1024 * 1024;
+
+    std::printf("%-6s %-10s %8s %14s %10s\n", "", "size", "count", "msgs/s", "MB/s");
+
+    for (auto& target : startTargets()) {
+        auto client = connectClient(target);
+        if (!client) {
+            continue;
+        }
+
+        auto counter = std::make_shared<EchoCounter>();
+        client->onBinary([counter](std::span<const std::byte>) {
+            counter->add();
+        });
+
+        for (size_t size : sizes) {
+            size_t count = std::clamp<size_t>(budget / size, 8, options.quick ? 2000 : 20000);
+            size_t window = std::max<size_t>(1, 4 * 1024 * 1024 / size);
+            auto payload = randomPayload(size);
+
+            size_t base;
+            {
+                std::lock_guard lock(counter->mutex);
+                base = counter->received;
+            }
+
+            bool ok = true;
+            auto start = Clock::now();
+
+            for (size_t sent = 0; ok && sent < count; ++sent) {
+                if (sent >= window) {
+                    ok = counter->waitFor(base + sent - window + 1);
+                }
+
+                client->send(payload);
+            }
+
+            ok = ok && counter->waitFor(base + count);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            if (!ok) {
+                std::printf("%-6s %-10zu %8zu  (timed out)\n", target.name, size, count);
+                break;
+            }
+
+            double rate = count / seconds;
+            std::printf("%-6s %-10zu %8zu %14.0f %10.1f\n", target.name, size, count, rate, rate * size / 1e6);
+
+            options.report.add("throughput", {{"transport", target.name}, {"size", double(size)}}, {
+                {"messages", double(count)},
+                {"msgs_per_sec", rate},
+                {"mb_per_sec", rate * size / 1e6},
+            });
+        }
+
+        retire(std::move(client));
+    }
+}
+
+// One 64 byte message at a time, from send() to the echo's callback.
+void benchLatency(Options& options) {
+    size_t rounds = options.quick ? 200 : 2000;
+    auto payload = randomPayload(64);
+
+    std::printf("%-6s %-8s %10s %10s %10s %10s %10s\n", "", "mode", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+
+    for (auto& target : startTargets()) {
+        for (bool useReactor : {false, true}) {
+            const char* mode = useReactor ? "reactor" : "thread";
+
+            std::unique_ptr<Reactor> reactor;
+            if (useReactor) {
+                auto created = Reactor::create();
+                if (created.isErr()) {
+                    std::printf("%-6s %-8s  skipped, %s\n", target.name, mode, created.unwrapErr().c_str());
+                    continue;
+                }
+
+                reactor = std::move(created).unwrap();
+                reactor->start();
+            }
+
+            auto client = connectClient(target, reactor.get());
+            if (!client) {
+                continue;
+            }
+
+            auto counter = std::make_shared<EchoCounter>();
+            client->onBinary([counter](std::span<const std::byte>) {
+                counter->add();
+            });
+
+            std::vector<double> samples;
+            samples.reserve(rounds);
+
+            for (size_t i = 0; i < rounds; ++i) {
+                auto start = Clock::now();
+                client->send(payload);
+
+                if (!counter->waitFor(i + 1, std::chrono::seconds(5))) {
+                    std::printf("%-6s %-8s  (timed out)\n", target.name, mode);
+                    break;
+                }
+
+                samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            }
+
+            retire(std::move(client));
+
+            if (samples.size() < rounds) {
+                continue;
+            }
+
+            double p50 = percentile(samples, 0.5), p90 = percentile(samples, 0.9);
+            double p99 = percentile(samples, 0.99), p999 = percentile(samples, 0.999);
+            double max = percentile(samples, 1.0);
+
+            std::printf("%-6s %-8s %10.1f %10.1f %10.1f %10.1f %10.1f\n", target.name, mode, p50, p90, p99, p999, max);
+
+            options.report.add("latency", {{"transport", target.name}, {"mode", mode}, {"size", 64.0}}, {
+                {"rounds", double(rounds)},
+                {"p50_us", p50},
+                {"p90_us", p90},
+                {"p99_us", p99},
+                {"p999_us", p999},
+                {"max_us", max},
+            });
+        }
+    }
+}
+
+// Connections opened one after another, each timed until its first echoed message.
+// Over TLS every connection after the first resumes the session.
+void benchSetup(Options& options) {
+    size_t count = options.quick ? 20 : 200;
+
+    std::printf("%-6s %8s %10s %10s %10s %8s\n", "", "count", "conn/s", "p50 ms", "p99 ms", "resumed");
+
+    for (auto& target : startTargets()) {
+        std::vector<std::unique_ptr<Client>> clients;
+        std::vector<double> samples;
+        size_t resumed = 0, failures = 0;
+
+        auto start = Clock::now();
+
+        for (size_t i = 0; i < count; ++i) {
+            auto& client = clients.emplace_back(std::make_unique<Client>());
+            if (target.tls) {
+                client->setTlsContext(target.tls);
+            }
+
+            auto sample = connectOnce(*client, target.server->url());
+            if (!sample) {
+                ++failures;
+                continue;
+            }
+
+            samples.push_back(sample->firstMessageMs);
+            resumed += sample->resumed;
+        }
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        for (auto& client : clients) {
+            retire(std::move(client));
+        }
+
+        double rate = samples.size() / seconds;
+        double p50 = percentile(samples, 0.5), p99 = percentile(samples, 0.99);
+
+        std::printf("%-6s %8zu %10.0f %10.2f %10.2f %8zu%s\n",
+            target.name, count, rate, p50, p99, resumed, failures ? "  (some failed)" : "");
+
+        options.report.add("setup", {{"transport", target.name}}, {
+            {"connections", double(count)},
+            {"failures", double(failures)},
+            {"resumed", double(resumed)},
+            {"conn_per_sec", rate},
+            {"p50_ms", p50},
+            {"p99_ms", p99},
+        });
+    }
+}
+
+// Plain TCP echo traffic from several threaded clients at once, over send()/recv() and over a shared
+// io_uring. Syscalls are counted on the client side: transport reads and writes for the sockets,
+// io_uring_enter calls for the ring.
+void benchUring(Options& options) {
+    auto driver = UringDriver::create();
+    if (driver.isErr()) {
+        std::printf("  skipped, %s\n", driver.unwrapErr().c_str());
+        return;
+    }
+
+    auto echo = EchoServer::start(false);
+    if (echo.isErr()) {
+        std::printf("  skipped, %s\n", echo.unwrapErr().c_str());
+        return;
+    }
+
+    Target target{"tcp", std::move(echo).unwrap(), nullptr};
+
+    size_t connections = options.quick ? 4 : 16;
+    size_t perConnection = options.quick ? 2000 : 20000;
+    std::vector<size_t> sizes = options.quick
+        ? std::vector<size_t>{64, 4 * 1024}
+        : std::vector<size_t>{64, 1024, 16 * 1024, 64 * 1024};
+
+    std::printf("%-7s %-8s %8s %14s %10s %12s\n", "", "size", "count", "msgs/s", "MB/s", "syscalls/msg");
+
+    for (bool useUring : {false, true}) {
+        const char* name = useUring ? "uring" : "socket";
+        auto uring = useUring ? driver.unwrap() : nullptr;
+
+        std::vector<std::unique_ptr<Client>> clients;
+        std::vector<std::shared_ptr<EchoCounter>> counters;
+
+        for (size_t i = 0; i < connections; ++i) {
+            auto client = std::make_unique<Client>();
+            client->setUringDriver(uring);
+
+            if (!connectOnce(*client, target.server->url())) {
+                std::printf("%-7s unable to connect to %s\n", name, target.server->url().c_str());
+                retire(std::move(client));
+                break;
+            }
+
+            auto counter = std::make_shared<EchoCounter>();
+            client->onBinary([counter](std::span<const std::byte>) {
+                counter->add();
+            });
+
+            clients.push_back(std::move(client));
+            counters.push_back(std::move(counter));
+        }
+
+        // reads and writes for the sockets, enters for the ring
+        auto syscalls = [&] {
+            if (uring) {
+                return uring->stats().enters;
+            }
+
+            uint64_t total = 0;
+            for (auto& client : clients) {
+                auto m = client->metrics();
+                total += m.reads + m.writes;
+            }
+            return total;
+        };
+
+        for (size_t size : sizes) {
+            if (clients.size() < connections) {
+                break;
+            }
+
+            size_t count = std::min(perConnection, std::max<size_t>(8, 64 * 1024 * 1024 / connections / size));
+            size_t window = std::max<size_t>(1, 256 * 1024 / size);
+            auto payload = randomPayload(size);
+
+            std::vector<size_t> bases;
+            for (auto& counter : counters) {
+                std::lock_guard lock(counter->mutex);
+                bases.push_back(counter->received);
+            }
+
+            std::atomic<bool> ok = true;
+            uint64_t syscallsBefore = syscalls();
+            auto start = Clock::now();
+
+            std::vector<std::thread> senders;
+            for (size_t i = 0; i < clients.size(); ++i) {
+                senders.emplace_back([&, i] {
+                    for (size_t sent = 0; ok && sent < count; ++sent) {
+                        if (sent >= window && !counters[i]->waitFor(bases[i] + sent - window + 1)) {
+                            ok = false;
+                        }
+
+                        clients[i]->send(payload);
+                    }
+
+                    if (!counters[i]->waitFor(bases[i] + count)) {
+                        ok = false;
+                    }
+                });
+            }
+
+            for (auto& sender : senders) {
+                sender.join();
+            }
+
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            size_t messages = count * clients.size();
+
+            if (!ok) {
+                std::printf("%-7s %-8zu %8zu  (timed out)\n", name, size, messages);
+                break;
+            }
+
+            double rate = messages / seconds;
+            double perMessage = double(syscalls() - syscallsBefore) / messages;
+            std::printf("%-7s %-8zu %8zu %14.0f %10.1f %12.2f\n", name, size, messages, rate, rate * size / 1e6, perMessage);
+
+            options.report.add("uring", {{"backend", name}, {"size", double(size)}, {"connections", double(connections)}}, {
+                {"messages", double(messages)},
+                {"msgs_per_sec", rate},
+                {"mb_per_sec", rate * size / 1e6},
+                {"syscalls_per_msg", perMessage},
+            });
+        }
+
+        for (auto& client : clients) {
+            retire(std::move(client));
+        }
+    }
+}
+
+// a connection's share of benchCoroutines, on the reactor thread from start to end
+static Task<> echoRounds(Client& client, std::span<const std::byte> payload, size_t rounds, std::shared_ptr<EchoCounter> done) {
+    for (size_t i = 0; i < rounds; ++i) {
+        if ((co_await client.send(payload)).isErr() || (co_await client.receive()).isErr()) {
+            break;
+        }
+    }
+
+    done->add();
+}
+
+static Task<> connectAwaiting(Client& client, std::string url, std::shared_ptr<EchoCounter> attempted) {
+    (void) co_await client.connect(url);
+    attempted->add();
+}
+
+// Many connections on one reactor thread, each doing 64 byte round trips. With callbacks, every echo is
+// handed to the driving thread, which sends the next round once all connections answered; coroutines
+// send the next message as soon as their echo is received, without leaving the reactor thread.
+void benchCoroutines(Options& options) {
+    size_t connections = options.quick ? 50 : 500;
+    size_t rounds = options.quick ? 20 : 200;
+    auto payload = randomPayload(64);
+
+    std::printf("%-6s %-10s %8s %14s\n", "", "mode", "conns", "round trips/s");
+
+    for (auto& target : startTargets()) {
+        for (bool useCoroutines : {false, true}) {
+            const char* mode = useCoroutines ? "coroutine" : "callback";
+
+            auto created = Reactor::create();
+            if (created.isErr()) {
+                std::printf("%-6s %-10s  skipped, %s\n", target.name, mode, created.unwrapErr().c_str());
+                return;
+            }
+
+            auto reactor = std::move(created).unwrap();
+            reactor->start();
+
+            std::vector<std::unique_ptr<Client>> clients;
+            auto counter = std::make_shared<EchoCounter>();
+            bool ok = true;
+
+            for (size_t i = 0; i < connections; ++i) {
+                auto& client = clients.emplace_back(std::make_unique<Client>());
+                client->onLogRecord(nullptr);
+                client->setReactor(reactor.get());
+                if (target.tls) {
+                    client->setTlsContext(target.tls);
+                }
+
+                if (useCoroutines) {
+                    spawn(*reactor, connectAwaiting(*client, target.server->url(), counter));
+                } else {
+                    client->onBinary([counter](std::span<const std::byte>) {
+                        counter->add();
+                    });
+                    ok = ok && client->open(target.server->url()).isOk();
+                }
+            }
+
+            auto start = Clock::now();
+
+            if (useCoroutines) {
+                ok = counter->waitFor(connections) && std::all_of(clients.begin(), clients.end(), [](auto& client) {
+                    return client->isConnected();
+                });
+
+                start = Clock::now();
+
+                for (size_t i = 0; ok && i < clients.size(); ++i) {
+                    spawn(*reactor, echoRounds(*clients[i], payload, rounds, counter));
+                }
+
+                ok = ok && counter->waitFor(2 * connections);
+            } else {
+                // messages sent while connecting wait for the handshake, so the first round overlaps with setup
+                for (size_t round = 0; ok && round < rounds; ++round) {
+                    for (auto& client : clients) {
+                        client->send(payload);
+                    }
+
+                    ok = counter->waitFor(connections * (round + 1));
+                }
+            }
+
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            for (auto& client : clients) {
+                retire(std::move(client));
+            }
+
+            if (!ok) {
+                std::printf("%-6s %-10s  (failed or timed out)\n", target.name, mode);
+                continue;
+            }
+
+            double rate = connections * rounds / seconds;
+            std::printf("%-6s %-10s %8zu %14.0f\n", target.name, mode, connections, rate);
+
+            options.report.add("coroutines", {{"transport", target.name}, {"mode", mode}}, {
+                {"connections", double(connections)},
+                {"round_trips", double(connections * rounds)},
+                {"round_trips_per_sec", rate},
+            });
+        }
+    }
+}
+
+
+// One reactor connection fed 64 KiB messages by a thread that never waits for them, with each overflow
+// policy and without a limit. Reports the most the client held unsent, and what became of the messages.
+void benchBackpressure(Options& options) {
+    size_t messages = options.quick ? 200 : 2000;
+    auto payload = randomPayload(64 * 1024);
+
+    struct Variant {
+        const char* name;
+        std::optional<OverflowPolicy> policy;
+    };
+
+    const Variant variants[] = {
+        {"none", std::nullopt},
+        {"block", OverflowPolicy::Block},
+        {"drop", OverflowPolicy::DropOldest},
+        {"fail", OverflowPolicy::FailFast},
+    };
+
+    std::printf("%-6s %-6s %12s %8s %8s %8s %10s\n", "", "policy", "peak KiB", "written", "dropped", "refused", "MB/s");
+
+    for (auto& target : startTargets()) {
+        for (auto& variant : variants) {
+            auto created = Reactor::create();
+            if (created.isErr()) {
+                std::printf("%-6s %-6s  skipped, %s\n", target.name, variant.name, created.unwrapErr().c_str());
+                return;
+            }
+
+            auto reactor = std::move(created).unwrap();
+            reactor->start();
+
+            auto client = std::make_unique<Client>();
+            auto counter = std::make_shared<EchoCounter>();
+            client->onLogRecord(nullptr);
+            client->setReactor(reactor.get());
+            if (target.tls) {
+                client->setTlsContext(target.tls);
+            }
+            if (variant.policy) {
+                client->setBackpressure({.highWaterMark = 512 * 1024, .lowWaterMark = 128 * 1024, .policy = *variant.policy});
+            }
+            client->onBinary([counter](std::span<const std::byte>) {
+                counter->add();
+            });
+
+            bool ok = client->open(target.server->url()).isOk();
+            auto deadline = Clock::now() + std::chrono::seconds(10);
+            while (ok && !client->isConnected() && Clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            auto start = Clock::now();
+            size_t refused = 0;
+            size_t peak = 0;
+
+            for (size_t i = 0; ok && i < messages; ++i) {
+                refused += !client->send(payload).queued();
+                peak = std::max(peak, client->bufferedAmount());
+            }
+
+            deadline = Clock::now() + std::chrono::seconds(60);
+            while (ok && client->bufferedAmount() > 0 && Clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            // frames counted as they are encoded, so dropped messages are not among them
+            size_t written = client->metrics().framesOut[static_cast<size_t>(Opcode::Binary)];
+            ok = ok && client->bufferedAmount() == 0 && counter->waitFor(written);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            retire(std::move(client));
+
+            if (!ok) {
+                std::printf("%-6s %-6s  (failed or timed out)\n", target.name, variant.name);
+                continue;
+            }
+
+            size_t dropped = messages - refused - written;
+            double rate = written * payload.size() / seconds / 1e6;
+            std::printf("%-6s %-6s %12zu %8zu %8zu %8zu %10.1f\n", target.name, variant.name, peak / 1024, written, dropped, refused, rate);
+
+            options.report.add("backpressure", {{"transport", target.name}, {"policy", variant.name}}, {
+                {"peak_buffered_bytes", double(peak)},
+                {"written", double(written)},
+                {"dropped", double(dropped)},
+                {"refused", double(refused)},
+                {"mb_per_sec", rate},
+            });
+        }
+    }
+}
+
+// user and system CPU time of this process so far, in seconds; 0 where it cannot be read
+static double cpuSeconds() {
+#ifndef _WIN32
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        auto seconds = [](const timeval& tv) { return tv.tv_sec + tv.tv_usec / 1e6; };
+        return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+    }
+#endif
+
+    return 0.0;
+}
+
+// Bulk echo traffic over one connection, once with wolfSSL sealing and opening records and once with
+// the kernel doing it. CPU seconds per GB counts the client's threads only, sending and receiving.
+void benchKernelTls(Options& options, uint16_t echoPort) {
+    size_t size = 64 * 1024;
+    size_t total = options.quick ? 64 * 1024 * 1024 : 1024 * 1024 * 1024;
+    size_t count = total / size;
+    size_t window = std::max<size_t>(1, 4 * 1024 * 1024 / size);
+    auto payload = randomPayload(size);
+    auto url = "wss://127.0.0.1:" + std::to_string(echoPort);
+
+    std::printf("%-8s %8s %10s %12s\n", "", "count", "MB/s", "cpu s/GB");
+
+    for (bool offload : {false, true}) {
+        const char* name = offload ? "kernel" : "wolfssl";
+
+        TlsOptions tlsOptions;
+        tlsOptions.kernelOffload = offload;
+
+        auto context = TlsContext::create(std::move(tlsOptions));
+        if (context.isErr()) {
+            std::printf("%-8s skipped, %s\n", name, context.unwrapErr().c_str());
+            continue;
+        }
+
+        auto client = std::make_unique<Client>();
+        client->setTlsContext(std::move(context).unwrap());
+
+        if (!connectOnce(*client, url)) {
+            std::printf("%-8s unable to connect to %s\n", name, url.c_str());
+            retire(std::move(client));
+            continue;
+        }
+
+        // the connection still works without the kernel, it just measures wolfSSL twice
+        if (offload && !client->connectTimings().tlsKernelOffload) {
+            std::printf("%-8s skipped, the kernel did not take the connection (see the client log)\n", name);
+            retire(std::move(client));
+            continue;
+        }
+
+        auto counter = std::make_shared<EchoCounter>();
+        client->onBinary([counter](std::span<const std::byte>) {
+            counter->add();
+        });
+
+        bool ok = true;
+        double cpuBefore = cpuSeconds();
+        auto start = Clock::now();
+
+        for (size_t sent = 0; ok && sent < count; ++sent) {
+            if (sent >= window) {
+                ok = counter->waitFor(sent - window + 1);
+            }
+
+            client->send(payload);
+        }
+
+        ok = ok && counter->waitFor(count);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        double cpu = cpuSeconds() - cpuBefore;
+
+        if (!ok) {
+            std::printf("%-8s %8zu  (timed out)\n", name, count);
+        } else {
+            // every byte is sent and received once, so a GB here is 2 GB through TLS
+            double gigabytes = double(count) * size / 1e9;
+            double rate = double(count) * size / seconds / 1e6;
+            std::printf("%-8s %8zu %10.1f %12.2f\n", name, count, rate, cpu / gigabytes);
+
+            options.report.add("ktls", {{"backend", name}, {"size", double(size)}}, {
+                {"messages", double(count)},
+                {"mb_per_sec", rate},
+                {"cpu_sec_per_gb", cpu / gigabytes},
+            });
+        }
+
+        retire(std::move(client));
+    }
+}
+
+// resident set size of this process, 0 where it cannot be read
+static size_t residentBytes() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+
+    if (statm >> pages >> resident) {
+        return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+
+    return 0;
+}
+
+// Resident memory added per open, idle connection, client side only.
+void benchMemory(Options& options, uint16_t echoPort) {
+    if (residentBytes() == 0) {
+        std::printf("  skipped, resident memory is only read on Linux\n");
+        return;
+    }
+
+    size_t count = options.quick ? 50 : 500;
+    auto url = "ws://127.0.0.1:" + std::to_string(echoPort);
+
+    std::printf("%-8s %8s %14s\n", "mode", "count", "bytes/conn");
+
+    for (bool useReactor : {false, true}) {
+        const char* mode = useReactor ? "reactor" : "thread";
+
+        std::unique_ptr<Reactor> reactor;
+        if (useReactor) {
+            auto created = Reactor::create();
+            if (created.isErr()) {
+                std::printf("%-8s  skipped, %s\n", mode, created.unwrapErr().c_str());
+                continue;
+            }
+
+            reactor = std::move(created).unwrap();
+            reactor->start();
+        }
+
+        std::vector<std::unique_ptr<Client>> clients;
+        size_t opened = 0;
+
+        size_t before = residentBytes();
+
+        for (size_t i = 0; i < count; ++i) {
+            auto& client = clients.emplace_back(std::make_unique<Client>());
+            if (reactor) {
+                client->setReactor(reactor.get());
+            }
+
+            opened += connectOnce(*client, url).has_value();
+        }
+
+        size_t after = residentBytes();
+
+        for (auto& client : clients) {
+            retire(std::move(client));
+        }
+
+        if (opened == 0) {
+            std::printf("%-8s  unable to connect to %s\n", mode, url.c_str());
+            continue;
+        }
+
+        double perConnection = double(after > before ? after - before : 0) / opened;
+        std::printf("%-8s %8zu %14.0f\n", mode, opened, perConnection);
+
+        options.report.add("memory", {{"mode", mode}}, {
+            {"connections", double(opened)},
+            {"rss_bytes_per_conn", perConnection},
+        });
+    }
+}
+
+void benchConnect(Options& options, std::string_view url, size_t count) {
+    std::printf("connect: time to first message, %zu connections to %.*s\n", count, static_cast<int>(url.size()), url.data());
+
+    struct Mode {
+        const char* name;
+        bool pipelining;
+        bool earlyData;
+    };
+
+    const Mode modes[] = {
+        {"plain", false, false},
+        {"pipelined", true, false},
+        {"pipelined + 0-RTT", true, true},
+    };
+
+    for (auto& mode : modes) {
+        // a fresh context per mode, so the first connection of each does a full handshake
+        std::shared_ptr<TlsContext> tls;
+        if (url.starts_with("wss://")) {
+            auto created = TlsContext::create();
+            if (created.isErr()) {
+                std::printf("  failed to create TLS context: %s\n", created.unwrapErr().c_str());
+                return;
+            }
+
+            tls = std::move(created).unwrap();
+        }
+
+        // connections are kept open until the mode is done, closing them races the server's teardown
+        std::vector<std::unique_ptr<Client>> clients;
+        std::vector<double> full, resumed;
+        size_t earlyConnections = 0, failures = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            auto& client = clients.emplace_back(std::make_unique<Client>());
+            if (tls) {
+                client->setTlsContext(tls);
+            }
+            client->setHandshakePipelining(mode.pipelining);
+            client->setEarlyData(mode.earlyData);
+
+            auto sample = connectOnce(*client, url);
+            if (!sample) {
+                ++failures;
+                continue;
+            }
+
+            (sample->resumed ? resumed : full).push_back(sample->firstMessageMs);
+            earlyConnections += sample->earlyDataBytes > 0;
+        }
+
+        for (auto& client : clients) {
+            retire(std::move(client));
+        }
+
+        std::printf(
+            "  %-18s full: %3zu  p50 %7.2f ms  p90 %7.2f ms | resumed: %3zu  p50 %7.2f ms  p90 %7.2f ms | 0-RTT used %zu, failed %zu\n",
+            mode.name,
+            full.size(), percentile(full, 0.5), percentile(full, 0.9),
+            resumed.size(), percentile(resumed, 0.5), percentile(resumed, 0.9),
+            earlyConnections, failures
+        );
+
+        options.report.add("connect", {{"url", std::string(url)}, {"mode", mode.name}}, {
+            {"full", double(full.size())},
+            {"full_p50_ms", percentile(full, 0.5)},
+            {"full_p90_ms", percentile(full, 0.9)},
+            {"resumed", double(resumed.size())},
+            {"resumed_p50_ms", percentile(resumed, 0.5)},
+            {"resumed_p90_ms", percentile(resumed, 0.9)},
+            {"early_data_used", double(earlyConnections)},
+            {"failures", double(failures)},
+        });
+    }
+}
+
+std::optional<uint16_t> spawnEchoProcess(bool tls) {
+#ifdef _WIN32
+    return std::nullopt;
+#else
+    int portPipe[2], alivePipe[2];
+    if (pipe(portPipe) != 0) {
+        return std::nullopt;
+    }
+
+    if (pipe(alivePipe) != 0) {
+        close(portPipe[0]);
+        close(portPipe[1]);
+        return std::nullopt;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        for (int fd : {portPipe[0], portPipe[1], alivePipe[0], alivePipe[1]}) {
+            close(fd);
+        }
+
+        return std::nullopt;
+    }
+
+    if (pid == 0) {
+        close(portPipe[0]);
+        close(alivePipe[1]);
+
+        auto server = EchoServer::start(tls);
+        uint16_t port = server.isOk() ? server.unwrap()->port() : 0;
+        (void) !write(portPipe[1], &port, sizeof(port));
+        close(portPipe[1]);
+
+        // the parent holds the write end, so this returns once it exits
+        char byte;
+        (void) !read(alivePipe[0], &byte, 1);
+        _exit(0);
+    }
+
+    close(portPipe[1]);
+    close(alivePipe[0]);
+    // stays open for as long as this process lives
+    fcntl(alivePipe[1], F_SETFD, FD_CLOEXEC);
+
+    uint16_t port = 0;
+    bool ok = read(portPipe[0], &port, sizeof(port)) == sizeof(port);
+    close(portPipe[0]);
+
+    if (!ok || port == 0) {
+        return std::nullopt;
+    }
+
+    return port;
+#endif
+}
+
+}
@@ -0,0 +1,107 @@
+#include "Report.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <fmt/format.h>
+#include <iterator>
+
+#ifndef MINIWS_VERSION
+# define MINIWS_VERSION "unknown"
+#endif
+
+namespace ws::bench {
+
+namespace {
+    void appendString(std::string& out, std::string_view str) {
+        out += '"';
+
+        for (char c : str) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<int>(c));
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+
+        out += '"';
+    }
+
+    void appendNumber(std::string& out, double value) {
+        // JSON has no NaN or infinity, a scenario that could not measure something reports null
+        if (!std::isfinite(value)) {
+            out += "null";
+            return;
+        }
+
+        fmt::format_to(std::back_inserter(out), "{}", value);
+    }
+}
+
+void Report::add(std::string scenario, Params params, Values values) {
+    entries.push_back({std::move(scenario), std::move(params), std::move(values)});
+}
+
+std::string Report::toJson() const {
+    std::string out = "{\n  \"version\": ";
+    appendString(out, MINIWS_VERSION);
+    out += ",\n  \"quick\": ";
+    out += quick ? "true" : "false";
+    out += ",\n  \"results\": [";
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        auto& entry = entries[i];
+
+        out += i == 0 ? "\n    {\"scenario\": " : ",\n    {\"scenario\": ";
+        appendString(out, entry.scenario);
+
+        out += ", \"params\": {";
+        for (size_t j = 0; j < entry.params.size(); ++j) {
+            auto& [name, value] = entry.params[j];
+            if (j > 0) out += ", ";
+
+            appendString(out, name);
+            out += ": ";
+
+            if (auto str = std::get_if<std::string>(&value)) {
+                appendString(out, *str);
+            } else {
+                appendNumber(out, std::get<double>(value));
+            }
+        }
+
+        out += "}, \"values\": {";
+        for (size_t j = 0; j < entry.values.size(); ++j) {
+            auto& [name, value] = entry.values[j];
+            if (j > 0) out += ", ";
+
+            appendString(out, name);
+            out += ": ";
+            appendNumber(out, value);
+        }
+
+        out += "}}";
+    }
+
+    out += "\n  ]\n}\n";
+    return out;
+}
+
+bool Report::writeTo(const std::string& path) const {
+    auto file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    auto json = this->toJson();
+    bool ok = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+
+    return std::fclose(file) == 0 && ok;
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace ws::bench {
+
+// Collects benchmark results and writes them as JSON, one entry per measurement:
+//   {"version": "...", "quick": false, "results": [
+//     {"scenario": "throughput", "params": {"transport": "tcp", "size": 16}, "values": {"msgs_per_sec": ...}}
+//   ]}
+// Params say what was measured and stay the same between runs, values are the numbers to compare.
+class Report {
+public:
+    using Param = std::variant<std::string, double>;
+    using Params = std::vector<std::pair<std::string, Param>>;
+    using Values = std::vector<std::pair<std::string, double>>;
+
+    bool quick = false;
+
+    void add(std::string scenario, Params params, Values values);
+
+    std::string toJson() const;
+    // false if the file could not be written
+    bool writeTo(const std::string& path) const;
+
+private:
+    struct Entry {
+        std::string scenario;
+        Params params;
+        Values values;
+    };
+
+    std::vector<Entry> entries;
+};
+
+}
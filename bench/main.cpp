@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Bench.hpp"
+
+using namespace ws::bench;
+
+static void usage(const char* self) {
+    std::printf(
+        "usage: %s [scenario...] [--quick] [--json <file>]\n"
+        "       %s connect <ws(s)://echo-server> [connections] [--json <file>]\n"
+        "scenarios: mask utf8 deflate codec memory throughput latency setup uring coro backpressure ktls (all of them by default)\n",
+        self, self
+    );
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    std::string jsonPath;
+    std::vector<std::string_view> args;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+
+        if (arg == "--quick") {
+            options.quick = true;
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--help" || arg.starts_with("--")) {
+            usage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    options.report.quick = options.quick;
+
+    auto finish = [&] {
+        if (!jsonPath.empty() && !options.report.writeTo(jsonPath)) {
+            std::printf("unable to write %s\n", jsonPath.c_str());
+            return 1;
+        }
+
+        return 0;
+    };
+
+    // needs an outside server, so it only runs when asked for
+    if (!args.empty() && args[0] == "connect") {
+        if (args.size() < 2) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        std::string url(args[1]);
+        benchConnect(options, url, args.size() > 2 ? std::strtoul(std::string(args[2]).c_str(), nullptr, 10) : 20);
+        return finish();
+    }
+
+    auto selected = [&](std::string_view name) {
+        return args.empty() || std::find(args.begin(), args.end(), name) != args.end();
+    };
+
+    // forked before anything starts a thread, so the server's memory and CPU time are not counted as ours
+    std::optional<uint16_t> memoryEcho;
+    if (selected("memory")) {
+        memoryEcho = spawnEchoProcess();
+    }
+
+    std::optional<uint16_t> tlsEcho;
+    if (selected("ktls")) {
+        tlsEcho = spawnEchoProcess(true);
+    }
+
+    struct Scenario {
+        const char* name;
+        void (*run)(Options&);
+    };
+
+    const Scenario scenarios[] = {
+        {"mask", benchMask},
+        {"utf8", benchUtf8},
+        {"deflate", benchDeflate},
+        {"codec", benchCodec},
+        {"memory", nullptr},
+        {"throughput", benchThroughput},
+        {"latency", benchLatency},
+        {"setup", benchSetup},
+        {"uring", benchUring},
+        {"coro", benchCoroutines},
+        {"backpressure", benchBackpressure},
+        {"ktls", nullptr},
+    };
+
+    for (auto& scenario : scenarios) {
+        if (!selected(scenario.name)) {
+            continue;
+        }
+
+        std::printf("\n== %s\n", scenario.name);
+
+        bool memory = std::string_view(scenario.name) == "memory";
+        auto echo = memory ? memoryEcho : tlsEcho;
+
+        if (scenario.run) {
+            scenario.run(options);
+        } else if (echo) {
+            memory ? benchMemory(options, *echo) : benchKernelTls(options, *echo);
+        } else {
+            std::printf("  skipped, unable to start an echo server process\n");
+        }
+
+        std::fflush(stdout);
+    }
+
+    return finish();
+}
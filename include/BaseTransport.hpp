@@ -1,9 +1,21 @@
 #pragma once
 
 #include <Geode/Result.hpp>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
 
 namespace ws {
 
+class ConnectionMetrics;
+
+struct ConstBuffer {
+    const void* data;
+    size_t size;
+};
+
 class BaseTransport {
 public:
     virtual ~BaseTransport() = default;
@@ -14,6 +26,40 @@ public:
 
     virtual geode::Result<> receiveExact(void* buffer, size_t size);
     virtual geode::Result<size_t> sendAll(const void* data, size_t size);
+
+    // Gathered write, may send less than the total just like send().
+    // The default only sends the first non-empty buffer; transports should override it.
+    virtual geode::Result<size_t> sendv(std::span<const ConstBuffer> buffers);
+    virtual geode::Result<size_t> sendAllv(std::span<const ConstBuffer> buffers);
+
+    // Event loop support. nativeHandle() is the OS socket to wait on, or -1 if there is none
+    virtual intptr_t nativeHandle() const { return -1; }
+    virtual geode::Result<> setNonBlocking(bool enabled);
+
+    // Non-blocking variants for event loops; std::nullopt means the call would have blocked.
+    // The defaults just call the blocking versions, which suits transports that never block
+    virtual geode::Result<std::optional<size_t>> tryReceive(void* buffer, size_t size);
+    virtual geode::Result<std::optional<size_t>> trySendv(std::span<const ConstBuffer> buffers);
+
+    // true while the transport holds bytes it accepted but could not hand to the socket yet
+    virtual bool hasPendingOutput() const { return false; }
+    // true when a receive would return data without the socket becoming readable first
+    virtual bool hasPendingInput() const { return false; }
+    // Blocks until a receive would not block, or `timeout` passes; false on timeout.
+    // The default polls nativeHandle(), transports that do their own waiting override it
+    virtual bool waitReadable(std::chrono::milliseconds timeout);
+
+    // counts every read and write call into `metrics` from now on, nullptr stops counting
+    void setMetrics(ConnectionMetrics* metrics) {
+        this->metrics = metrics;
+    }
+
+protected:
+    ConnectionMetrics* metrics = nullptr;
+
+    // for implementations, once per call that reached the socket (or TLS library)
+    void countRead(size_t bytes);
+    void countWrite(size_t bytes);
 };
 
-}
\ No newline at end of file
+}
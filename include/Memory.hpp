@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace ws {
+    struct MemoryStats {
+        // bytes handed out and not given back yet, and the most there ever were at once
+        uint64_t bytesInUse = 0;
+        uint64_t peakBytesInUse = 0;
+        // bytes kept around for reuse, FramePool only
+        uint64_t bytesCached = 0;
+
+        uint64_t allocations = 0;
+        // allocations that had to go to the upstream resource
+        uint64_t upstreamAllocations = 0;
+    };
+
+    // Passes allocations on to `upstream` and counts them, so the memory used by a group of
+    // connections can be attributed and watched. Thread safe, stats() can be read from any thread.
+    //
+    //     static MemoryAccount feeds(myArenaResource);
+    //     client->setMemoryResource(&feeds);
+    //     // later: feeds.stats().bytesInUse
+    class MemoryAccount : public std::pmr::memory_resource {
+    public:
+        explicit MemoryAccount(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+        MemoryStats stats() const;
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    private:
+        std::pmr::memory_resource* upstream;
+
+        std::atomic<uint64_t> inUse = 0;
+        std::atomic<uint64_t> peak = 0;
+        std::atomic<uint64_t> allocations = 0;
+    };
+
+    struct FramePoolOptions {
+        // larger blocks are not pooled
+        size_t largestBlock = 64 * 1024;
+        // the most the free lists hold together; bounds what the pool keeps beyond what is in use
+        size_t maxCachedBytes = 4 * 1024 * 1024;
+    };
+
+    // Recycles frame buffers between messages. Requests are rounded up to a power of two from 64 bytes
+    // to FramePoolOptions::largestBlock, and freed blocks go on a free list for their size class instead of back
+    // to `upstream`. Larger requests, and anything past FramePoolOptions::maxCachedBytes, go straight through.
+    // Thread safe: frames are usually allocated by the sending thread and freed by whichever writes them.
+    class FramePool : public std::pmr::memory_resource {
+    public:
+        explicit FramePool(FramePoolOptions options = {}, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+        // every block must have been given back by now
+        ~FramePool() override;
+
+        FramePool(const FramePool&) = delete;
+        FramePool& operator=(const FramePool&) = delete;
+
+        MemoryStats stats() const;
+
+        // hands every cached block back to upstream
+        void trim();
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    private:
+        static constexpr size_t SmallestBlock = 64;
+
+        struct SizeClass {
+            std::mutex mutex;
+            std::vector<void*> blocks;
+        };
+
+        FramePoolOptions options;
+        std::pmr::memory_resource* upstream;
+        std::vector<std::unique_ptr<SizeClass>> classes;
+
+        std::atomic<uint64_t> inUse = 0;
+        std::atomic<uint64_t> peak = 0;
+        std::atomic<uint64_t> cached = 0;
+        std::atomic<uint64_t> allocations = 0;
+        std::atomic<uint64_t> upstreamAllocations = 0;
+
+        // index into `classes`, or classes.size() for requests that bypass the pool
+        size_t classOf(size_t bytes, size_t alignment) const;
+        void countInUse(int64_t delta);
+    };
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace ws {
+    // Counters of one connection (Client::metrics) or of every connection in the process (Metrics::global).
+    // Byte counts are WebSocket bytes as handed to and taken from the transport, before TLS
+    struct MetricsSnapshot {
+        // how many clients are summed up here, including destroyed ones for Metrics::global()
+        uint64_t connections = 0;
+
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        // transport read and write calls, each one (or, for TLS, at least one) syscall
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+
+        // frames on the wire, indexed by opcode
+        std::array<uint64_t, 16> framesIn{};
+        std::array<uint64_t, 16> framesOut{};
+        uint64_t largestFrameIn = 0;
+        uint64_t largestFrameOut = 0;
+
+        // frames waiting to be written right now, and the most there ever were at once
+        uint64_t queueDepth = 0;
+        uint64_t queueHighWater = 0;
+        // heap allocations made to queue outgoing frames
+        uint64_t frameAllocations = 0;
+
+        // completed opens and the total time they took, from open() to the server's 101 response
+        uint64_t handshakes = 0;
+        uint64_t handshakeMicros = 0;
+
+        // time spent in message and fragment callbacks
+        uint64_t callbacks = 0;
+        uint64_t callbackMicros = 0;
+        uint64_t callbackMaxMicros = 0;
+
+        uint64_t totalFramesIn() const;
+        uint64_t totalFramesOut() const;
+
+        // adds up counters and keeps the larger of the maximums
+        MetricsSnapshot& operator+=(const MetricsSnapshot& other);
+
+        // Prometheus text exposition format. `labels` (like `upstream="eu1"`) is added to every sample
+        std::string toPrometheus(std::string_view prefix = "miniws", std::string_view labels = {}) const;
+    };
+
+    class Metrics {
+    public:
+        // every client in the process, live ones read without stopping their I/O
+        static MetricsSnapshot global();
+
+        // Calls `exporter` with global() every `interval` on a background thread, for pushing into
+        // a monitoring system. Replaces the previous exporter; nullptr stops exporting
+        static void setExporter(std::chrono::milliseconds interval, std::function<void(const MetricsSnapshot&)> exporter);
+    };
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <Geode/Result.hpp>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ws {
+    class Client;
+    class Server;
+    class ServerConnection;
+    class Reactor;
+
+    // Anything a Reactor delivers socket readiness and timers to: clients, and the server's
+    // listening sockets and connections. All calls come from the reactor's thread.
+    class ReactorHandler {
+    protected:
+        friend class Reactor;
+
+        virtual ~ReactorHandler() = default;
+
+        // assigned by Reactor::add, 0 while not registered
+        std::atomic<uint64_t> reactorId = 0;
+
+        virtual void reactorReadable() = 0;
+        virtual void reactorWritable() = 0;
+        // a deadline passed to Reactor::scheduleTimer has passed
+        virtual void reactorTimer(std::chrono::steady_clock::time_point) {}
+    };
+
+    // Drives many Clients from a single thread with epoll (Linux only).
+    // A client opts in with Client::setReactor before open(); from then on the reactor does
+    // its WebSocket handshake, frame parsing and send flushing, and runs its callbacks.
+    // Each Server worker runs one for its share of the connections.
+    class Reactor {
+    public:
+        static geode::Result<std::unique_ptr<Reactor>> create();
+        ~Reactor();
+
+        Reactor(const Reactor&) = delete;
+        Reactor& operator=(const Reactor&) = delete;
+
+        // runs the loop on the calling thread until stop() is called
+        void run();
+        // waits up to `timeoutMs` for events and handles them (-1 waits forever).
+        // returns earlier when a client's keepalive timer is due
+        void runOnce(int timeoutMs);
+
+        // runs the loop on a background thread
+        void start();
+        void stop();
+
+        size_t connectionCount();
+
+        // Resumes `handle` on the loop's thread once the events at hand are handled. Thread safe;
+        // this is how a coroutine moves onto the reactor, see spawn()
+        void post(std::coroutine_handle<> handle);
+
+    private:
+        friend class Client;
+        friend class Server;
+        friend class ServerConnection;
+
+        Reactor(int epollFd, int wakeFd) : epollFd(epollFd), wakeFd(wakeFd) {}
+
+        int epollFd;
+        int wakeFd;
+
+        // held while events are handled, so a handler removed from another thread
+        // is never touched again once remove() returns
+        std::recursive_mutex loopMutex;
+        std::unordered_map<uint64_t, ReactorHandler*> handlers;
+        uint64_t nextId = 1;
+
+        std::mutex flushMutex;
+        std::vector<uint64_t> flushRequests;
+        std::vector<std::coroutine_handle<>> posted;
+
+        // keepalive and close wakeups, earliest first. entries of removed handlers are skipped when they come up
+        using TimePoint = std::chrono::steady_clock::time_point;
+        using Timer = std::pair<TimePoint, uint64_t>;
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+
+        std::atomic<bool> running = false;
+        std::thread thread;
+
+        // starts watching `fd` for `handler`, for writability too when `writable` is set
+        geode::Result<> add(ReactorHandler* handler, intptr_t fd, bool writable = true);
+        void remove(uint64_t id, intptr_t fd);
+        void setWriteInterest(uint64_t id, intptr_t fd, bool enabled);
+        // a handler that stops reading leaves the socket's data to TCP flow control
+        void setInterest(uint64_t id, intptr_t fd, bool readable, bool writable);
+        // thread safe, wakes the loop to write out the handlers' queued frames
+        void requestFlush(uint64_t id);
+        void requestFlush(std::span<const uint64_t> ids);
+        void wake();
+        // whether the calling thread is inside this reactor's loop, running one of its handlers
+        bool inLoop() const;
+
+        // reactor thread only; calls the handler's reactorTimer() once `deadline` has passed
+        void scheduleTimer(uint64_t id, TimePoint deadline);
+        void runTimers();
+        // `timeoutMs` shortened to the next timer
+        int timerTimeout(int timeoutMs);
+    };
+
+    // A fixed set of reactors, each on its own thread, handing out connections round robin
+    class ReactorPool {
+    public:
+        static geode::Result<std::unique_ptr<ReactorPool>> create(size_t threads);
+        ~ReactorPool();
+
+        Reactor& next();
+
+    private:
+        std::vector<std::unique_ptr<Reactor>> reactors;
+        std::atomic<size_t> counter = 0;
+    };
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Geode/Result.hpp>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ws {
+    struct Resolution {
+        // numeric IPv4/IPv6 addresses, in the order they should be tried
+        std::vector<std::string> addresses;
+        // how long the answer may be reused
+        std::chrono::seconds ttl{};
+    };
+
+    // Turns a hostname into addresses. Implement this to plug in a DNS client that sees
+    // real record TTLs, or a stub that answers from a table.
+    class Resolver {
+    public:
+        virtual ~Resolver() = default;
+        virtual geode::Result<Resolution> resolve(std::string_view host) = 0;
+    };
+
+    // getaddrinfo. It never sees record TTLs, so every answer is kept for `ttl`
+    class SystemResolver : public Resolver {
+    public:
+        explicit SystemResolver(std::chrono::seconds ttl = std::chrono::seconds(60)) : ttl(ttl) {}
+
+        geode::Result<Resolution> resolve(std::string_view host) override;
+
+    private:
+        std::chrono::seconds ttl;
+    };
+
+    using ResolveResult = geode::Result<std::vector<std::string>>;
+
+    // Caches answers for their TTL and shares them between every client using the same cache.
+    // Concurrent lookups of one host wait for a single query instead of each sending their own.
+    // Thread safe.
+    class ResolverCache {
+    public:
+        // failed lookups are remembered for `negativeTtl`, so a dead name is not retried by every reconnect
+        explicit ResolverCache(
+            std::shared_ptr<Resolver> resolver = std::make_shared<SystemResolver>(),
+            std::chrono::seconds negativeTtl = std::chrono::seconds(5)
+        );
+
+        // the cache clients use unless given their own
+        static std::shared_ptr<ResolverCache> shared();
+
+        // Starts a lookup on a background thread unless the answer is cached or already being looked up.
+        // IP literals resolve to themselves right away
+        std::shared_future<ResolveResult> resolveAsync(std::string_view host);
+
+        ResolveResult resolve(std::string_view host) {
+            return resolveAsync(host).get();
+        }
+
+        void clear();
+        size_t size();
+
+    private:
+        struct Entry {
+            std::shared_future<ResolveResult> result;
+            std::chrono::steady_clock::time_point expires;
+            uint64_t id;
+        };
+
+        // shared with lookup threads, which may finish after the cache is gone
+        struct State {
+            std::mutex mutex;
+            std::unordered_map<std::string, Entry> entries;
+            uint64_t nextId = 0;
+        };
+
+        std::shared_ptr<Resolver> resolver;
+        std::chrono::seconds negativeTtl;
+        std::shared_ptr<State> state;
+    };
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "miniws.hpp"
+
+namespace ws {
+    class HttpRequestParser;
+    class TlsTransport;
+    class Server;
+    // a worker thread's listening socket and event loop, internal
+    struct ServerWorker;
+
+    struct ServerOptions {
+        // address to listen on, IPv4 or IPv6. port 0 picks a free port, see Server::port()
+        std::string host = "0.0.0.0";
+        uint16_t port = 0;
+        // Worker threads, each with its own listening socket and event loop. The sockets share the
+        // port with SO_REUSEPORT, so the kernel spreads new connections over the workers and
+        // nothing is shared between them on the accept path. 0 means one per core
+        size_t workers = 0;
+        int backlog = 1024;
+        // serves wss:// when set, with a context from TlsContext::createServer
+        std::shared_ptr<TlsContext> tls;
+        // only the path of the upgrade request is checked, "" accepts any
+        std::string path;
+        size_t maxMessageSize = 16 * 1024 * 1024;
+        // how long a new connection has to finish the TLS handshake and the upgrade before it is dropped
+        std::chrono::milliseconds handshakeTimeout{10000};
+        // how long a connection we closed waits for the client's close frame before it is dropped
+        std::chrono::milliseconds closeTimeout{5000};
+        // frames, read buffers and broadcast copies are allocated from here, see Client::setMemoryResource.
+        // Must outlive the server
+        std::pmr::memory_resource* memory = std::pmr::get_default_resource();
+    };
+
+    // One accepted client. Any thread may send or close; everything else (reading, writing,
+    // callbacks) happens on the worker that accepted it. Handles stay usable after the connection
+    // is gone, sending then does nothing, but must not outlive the Server.
+    class ServerConnection : private ReactorHandler, public std::enable_shared_from_this<ServerConnection> {
+    public:
+        ~ServerConnection() override;
+
+        ServerConnection(const ServerConnection&) = delete;
+        ServerConnection& operator=(const ServerConnection&) = delete;
+
+        uint64_t id() const {
+            return connectionId;
+        }
+
+        // the client's address, "ip:port"
+        const std::string& remoteAddress() const {
+            return remote;
+        }
+
+        // target of the upgrade request, e.g. "/feed?symbol=BTC"
+        const std::string& path() const {
+            return requestPath;
+        }
+
+        bool isOpen() const {
+            return open.load(std::memory_order_acquire);
+        }
+
+        void send(std::string_view data);
+        void send(std::span<const std::byte> data, Opcode opcode = Opcode::Binary);
+
+        // starts the closing handshake; the connection is dropped once the client answers
+        // or ServerOptions::closeTimeout passes. `reason` is cut to 123 bytes, on a character boundary
+        void close(uint16_t code = 1000, std::string_view reason = {});
+
+        MetricsSnapshot metrics() const;
+
+    private:
+        friend class Server;
+
+        enum class Phase {
+            TlsHandshake,
+            Upgrade,
+            Open,
+            Closing,
+            Closed
+        };
+
+        ServerConnection(Server& server, ServerWorker& worker, uint64_t id, std::string remote);
+
+        // first, so everything that counts into it is destroyed before it
+        std::unique_ptr<ConnectionMetrics> counters;
+
+        Server& server;
+        ServerWorker& worker;
+        uint64_t connectionId;
+        std::string remote;
+        std::string requestPath;
+
+        std::shared_ptr<BaseTransport> stream;
+        // set until the TLS handshake is done
+        std::shared_ptr<TlsTransport> tlsPending;
+        std::chrono::steady_clock::time_point acceptedAt;
+        // when a close we sent stops waiting for the answer
+        std::chrono::steady_clock::time_point closeDeadline;
+
+        // worker thread only
+        Phase phase = Phase::Upgrade;
+        bool writeInterest = false;
+        std::atomic<bool> open = false;
+        bool closeSent = false;
+        bool closeReceived = false;
+        uint16_t closeCode = 1006;
+        std::string closeReason;
+
+        std::unique_ptr<HttpRequestParser> request;
+        std::unique_ptr<FrameReader> reader;
+
+        // frames from any thread, taken out by the worker
+        std::unique_ptr<SendQueue> sendQueue;
+        // encoded frames the worker is writing, the first one partly written up to pendingOffset
+        std::deque<std::shared_ptr<const std::pmr::vector<uint8_t>>> pending;
+        size_t pendingOffset = 0;
+        std::vector<ConstBuffer> gatherBuffers;
+        // frames taken from sendQueue, reused for every pass
+        std::vector<OutgoingFrame*> writeBatch;
+
+        // worker thread: registers with the worker's event loop and connection list
+        void attach();
+        // false until the TLS handshake is done, or when it failed and the connection was dropped
+        bool advanceTls();
+        // called with the upgrade request complete
+        void upgrade();
+        void reject(std::string_view status);
+        bool processIncoming();
+        void handleControl(Opcode opcode, std::span<const uint8_t> payload);
+        // queues an encoded frame, and asks the worker to write it unless `flush` is false.
+        // false once the connection is no longer open
+        bool queue(std::shared_ptr<const std::pmr::vector<uint8_t>> frame, Opcode opcode, bool flush = true);
+        // worker thread: writes as much as the socket takes
+        geode::Result<> flush();
+        // worker thread: unregisters, shuts the socket down and runs the close callback
+        void finish();
+
+        void reactorReadable() override;
+        void reactorWritable() override;
+        void reactorTimer(std::chrono::steady_clock::time_point now) override;
+
+        // see Log.hpp
+        bool logEnabled(LogSeverity severity) const;
+        void writeLog(LogSeverity severity, std::string_view source, std::string_view message);
+    };
+
+    // A WebSocket server on top of the same transports, frame parser and event loop as the client.
+    //
+    //     auto server = Server::create({.port = 8080, .workers = 4}).unwrap();
+    //     server->onMessage([&](ServerConnection& conn, Opcode opcode, std::span<const std::byte> data) {
+    //         server->broadcast(data, opcode);
+    //     });
+    //     server->start().unwrap();
+    //
+    // Linux only, like Reactor.
+    class Server {
+    public:
+        using OpenCallback = std::function<void(const std::shared_ptr<ServerConnection>&)>;
+        using MessageCallback = std::function<void(ServerConnection&, Opcode, std::span<const std::byte>)>;
+        using CloseCallback = std::function<void(ServerConnection&, uint16_t code, std::string_view reason)>;
+
+        // binds the listening sockets, so a taken port fails here rather than in start()
+        static geode::Result<std::unique_ptr<Server>> create(ServerOptions options);
+        ~Server();
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        // callbacks run on worker threads and must be set before start()
+        void onOpen(OpenCallback callback) {
+            openCallback = std::move(callback);
+        }
+
+        void onMessage(MessageCallback callback) {
+            messageCallback = std::move(callback);
+        }
+
+        void onClose(CloseCallback callback) {
+            closeCallback = std::move(callback);
+        }
+
+        void onLogRecord(std::function<void(const LogRecord&)> callback) {
+            logCallback = std::move(callback);
+        }
+
+        void setLogLevel(LogSeverity minimum) {
+            logLevel.store(minimum, std::memory_order_relaxed);
+        }
+
+        geode::Result<> start();
+        // drops every connection without a closing handshake and stops the workers
+        void stop();
+
+        uint16_t port() const {
+            return boundPort;
+        }
+
+        size_t workerCount() const {
+            return workers.size();
+        }
+
+        size_t connectionCount();
+
+        // Sends one message to every open connection. The frame is encoded once and the same
+        // bytes are queued on each connection, and each worker is woken once for all of its share
+        void broadcast(std::string_view data);
+        void broadcast(std::span<const std::byte> data, Opcode opcode = Opcode::Binary);
+        // the same, to a chosen set of connections (e.g. the subscribers of one topic)
+        void broadcast(std::span<const std::shared_ptr<ServerConnection>> targets, std::span<const std::byte> data, Opcode opcode = Opcode::Binary);
+
+    private:
+        friend class ServerConnection;
+        friend struct ServerWorker;
+
+        explicit Server(ServerOptions options);
+
+        ServerOptions options;
+        uint16_t boundPort = 0;
+        std::vector<std::unique_ptr<ServerWorker>> workers;
+        std::atomic<bool> running = false;
+
+        OpenCallback openCallback;
+        MessageCallback messageCallback;
+        CloseCallback closeCallback;
+        std::function<void(const LogRecord&)> logCallback;
+        std::atomic<LogSeverity> logLevel = LogSeverity::Debug;
+
+        bool logEnabled(LogSeverity severity) const {
+            return severity >= logLevel.load(std::memory_order_relaxed) && logCallback;
+        }
+
+        // connection 0 is the server itself
+        void writeLog(LogSeverity severity, std::string_view source, std::string_view message, uint64_t connectionId = 0);
+
+        // worker thread: accepts everything pending on the worker's listening socket
+        void acceptConnections(ServerWorker& worker);
+    };
+}
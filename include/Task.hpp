@@ -0,0 +1,133 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace ws {
+    class Reactor;
+
+    template <typename T = void>
+    class Task;
+
+    namespace detail {
+        struct TaskPromiseBase {
+            // whoever awaits the task, resumed straight from its final suspend point
+            std::coroutine_handle<> continuation;
+
+            struct FinalAwaiter {
+                bool await_ready() noexcept {
+                    return false;
+                }
+
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                    auto next = handle.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() noexcept {
+                return {};
+            }
+
+            // errors travel as geode::Result like everywhere else, so an exception is a bug
+            void unhandled_exception() noexcept {
+                std::terminate();
+            }
+        };
+
+        template <typename T>
+        struct TaskPromise : TaskPromiseBase {
+            std::optional<T> value;
+
+            Task<T> get_return_object();
+
+            void return_value(T result) {
+                value.emplace(std::move(result));
+            }
+        };
+
+        template <>
+        struct TaskPromise<void> : TaskPromiseBase {
+            Task<void> get_return_object();
+
+            void return_void() {}
+        };
+    }
+
+    // A coroutine that starts when it is awaited and hands its co_return value to the awaiting coroutine.
+    // Awaiting one task from another continues straight into it and back, without going through the
+    // reactor or growing the stack. Top-level tasks are started with spawn()
+    template <typename T>
+    class Task {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+
+        Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+        Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                if (handle) {
+                    handle.destroy();
+                }
+
+                handle = std::exchange(other.handle, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~Task() {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+        bool await_ready() const noexcept {
+            return !handle || handle.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+
+        T await_resume() {
+            if constexpr (!std::is_void_v<T>) {
+                return std::move(*handle.promise().value);
+            }
+        }
+
+    private:
+        friend promise_type;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    namespace detail {
+        template <typename T>
+        Task<T> TaskPromise<T>::get_return_object() {
+            return Task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() {
+            return Task<void>{std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+        }
+    }
+
+    // Runs `task` on `reactor`'s thread without anyone awaiting it; it is destroyed once it finishes.
+    // Client::connect(), receive() and send() are then awaited from inside it, see Client::connect.
+    // Thread safe, so it also starts tasks from outside the reactor
+    void spawn(Reactor& reactor, Task<> task);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Geode/Result.hpp>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct WOLFSSL_CTX;
+struct WOLFSSL;
+struct WOLFSSL_SESSION;
+
+namespace ws {
+    struct TlsOptions {
+        // verify the server certificate chain against `caFile`, or the system store if it is empty
+        bool verifyPeer = false;
+        std::string caFile;
+        // how many host:port entries keep a session for resumption, 0 disables resumption
+        size_t sessionCacheSize = 256;
+        // Linux: once the handshake is done, hand record encryption to the kernel (kTLS) so messages go out
+        // and come in with plain send()/recv(). Connections fall back to wolfSSL when the kernel lacks the
+        // tls module or the negotiated cipher. Session tickets that arrive after the handshake are then
+        // never seen by wolfSSL, so offloaded connections leave nothing behind to resume
+        bool kernelOffload = false;
+    };
+
+    struct TlsServerOptions {
+        // PEM files: the certificate chain (leaf first) and its private key
+        std::string certFile;
+        std::string keyFile;
+    };
+
+    // Trust store, TLS configuration and resumable sessions, shared by any number of connections.
+    // Loading the trust store is the expensive part of setting up TLS, so it is done once here
+    // instead of once per connection. Thread safe.
+    class TlsContext {
+    public:
+        static geode::Result<std::shared_ptr<TlsContext>> create(TlsOptions options = {});
+
+        // the context clients use unless given their own, created with default options on first use
+        static geode::Result<std::shared_ptr<TlsContext>> shared();
+
+        // a context for the accepting side, see ServerOptions::tls. Clients cannot use it
+        static geode::Result<std::shared_ptr<TlsContext>> createServer(TlsServerOptions options);
+
+        ~TlsContext();
+
+        TlsContext(const TlsContext&) = delete;
+        TlsContext& operator=(const TlsContext&) = delete;
+
+        const TlsOptions& options() const {
+            return opts;
+        }
+
+        // whether this came from createServer()
+        bool isServer() const {
+            return server;
+        }
+
+        // forgets every cached session, so the next connection to each host does a full handshake
+        void clearSessions();
+
+    private:
+        friend class TlsSession;
+
+        TlsContext(WOLFSSL_CTX* ctx, TlsOptions options, bool server = false)
+            : ctx(ctx), opts(std::move(options)), server(server) {}
+
+        WOLFSSL_CTX* ctx;
+        TlsOptions opts;
+        bool server;
+
+        std::mutex sessionMutex;
+        std::unordered_map<std::string, WOLFSSL_SESSION*> sessions;
+        // keys in insertion order, the oldest is evicted first
+        std::deque<std::string> sessionOrder;
+
+        // Offers the cached session for `key` to a connection that has not handshaken yet.
+        // Returns how many bytes of 0-RTT early data the session allows, 0 if none or nothing was cached
+        size_t resumeSession(WOLFSSL* ssl, const std::string& key);
+        // remembers the session (and any ticket received so far) of a finished handshake
+        void storeSession(WOLFSSL* ssl, const std::string& key);
+    };
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <Geode/Result.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+struct io_uring_sqe;
+
+namespace ws {
+    class IoUring;
+    class UringTransport;
+
+    struct UringOptions {
+        // submission queue size, the completion queue gets twice as many
+        unsigned entries = 256;
+        // receive buffers handed to the kernel up front and shared by every connection on the driver.
+        // bufferCount must be a power of two
+        unsigned bufferCount = 256;
+        uint32_t bufferSize = 16 * 1024;
+    };
+
+    struct UringStats {
+        // io_uring_enter calls; every other syscall a transport makes is a setup or teardown
+        uint64_t enters = 0;
+        uint64_t submissions = 0;
+        uint64_t completions = 0;
+        // times a receive stopped because every buffer was taken
+        uint64_t bufferShortages = 0;
+    };
+
+    // One io_uring shared by the plain ws:// connections of thread-mode clients (Linux 6.0+).
+    // Receives are multishot into a ring of provided buffers, so a busy connection is not re-armed
+    // per read, and sends are queued without a syscall while another thread is already reaping:
+    // whichever thread waits first submits everything queued by all connections and hands the
+    // completions out, the others sleep until theirs arrive.
+    //
+    //     if (auto uring = UringDriver::shared()) {
+    //         client->setUringDriver(uring);
+    //     }
+    class UringDriver {
+    public:
+        // fails when the kernel does not support io_uring, or is too old for multishot receives
+        static geode::Result<std::shared_ptr<UringDriver>> create(UringOptions options = {});
+        // process wide driver with the default options, nullptr if io_uring is unavailable
+        static std::shared_ptr<UringDriver> shared();
+        // every transport must be gone by now
+        ~UringDriver();
+
+        UringDriver(const UringDriver&) = delete;
+        UringDriver& operator=(const UringDriver&) = delete;
+
+        UringStats stats() const;
+
+    private:
+        friend class UringTransport;
+
+        UringDriver() = default;
+
+        std::unique_ptr<IoUring> ring;
+
+        // guards the ring, and the state of every transport using it
+        std::mutex mutex;
+        // signalled whenever completions have been handed out
+        std::condition_variable completed;
+        // some thread is reaping completions; inKernel while it is blocked in io_uring_enter
+        bool leader = false;
+        bool inKernel = false;
+        // submissions published but not passed to io_uring_enter yet
+        unsigned unsubmitted = 0;
+
+        std::atomic<uint64_t> enters = 0;
+        std::atomic<uint64_t> submissions = 0;
+        std::atomic<uint64_t> completions = 0;
+        std::atomic<uint64_t> bufferShortages = 0;
+
+        // reserves a submission slot, submitting what is queued if the ring is full. Called with `mutex` held.
+        // the returned entry goes to the kernel with the next submit()
+        ::io_uring_sqe* prepare(std::unique_lock<std::mutex>& lock);
+        // passes queued submissions to the kernel, unless the leader will take them along on its next wait
+        void submit(std::unique_lock<std::mutex>& lock);
+        // reaps completions until `done` holds or `deadline` passes, either leading or following; false on timeout
+        bool waitFor(
+            std::unique_lock<std::mutex>& lock,
+            const std::function<bool()>& done,
+            std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt
+        );
+        // hands out every completion already posted, without entering the kernel
+        void reap(std::unique_lock<std::mutex>& lock);
+        // submits what is queued and waits for `waitFor` completions; the lock is released meanwhile
+        int enter(std::unique_lock<std::mutex>& lock, unsigned waitFor, std::optional<std::chrono::steady_clock::time_point> deadline);
+        // arms a multishot receive on a socketpair to make sure the kernel has everything used here
+        geode::Result<> probe();
+    };
+}
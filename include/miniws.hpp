@@ -1,12 +1,28 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <thread>
 #include <optional>
+#include <span>
+#include <string_view>
 #include "BaseTransport.hpp"
+#include "TlsContext.hpp"
+#include "Resolver.hpp"
+#include "Metrics.hpp"
+#include "Reactor.hpp"
+#include "Memory.hpp"
+#include "Uring.hpp"
+#include "Task.hpp"
 
 // #include <qsox/TcpStream.hpp>
 
@@ -17,6 +33,14 @@ namespace qsox {
 }
 
 namespace ws {
+    class FrameReader;
+    class PerMessageDeflate;
+    class SendQueue;
+    struct OutgoingFrame;
+    class HttpResponseParser;
+    class LatencyHistogram;
+    class ConnectionMetrics;
+
     struct ServerAddress {
         std::string host;
         int port;
@@ -24,65 +48,559 @@ namespace ws {
         std::string path = "/";
     };
 
+    enum class Opcode : uint8_t {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xA
+    };
+
+    // permessage-deflate (RFC 7692) settings, see Client::enableCompression
+    struct CompressionOptions {
+        // LZ77 window for messages we send (9-15); the server may lower it further
+        int clientMaxWindowBits = 15;
+        // window we ask the server to stay within (9-15), which also bounds our inflate memory
+        int serverMaxWindowBits = 15;
+        // reset the compressor after every message instead of keeping history across messages.
+        // costs ratio, saves the window memory between messages
+        bool clientNoContextTakeover = false;
+        bool serverNoContextTakeover = false;
+        // zlib level, 1 (fast) to 9 (small)
+        int level = 6;
+        // messages smaller than this are sent uncompressed
+        size_t minSize = 64;
+    };
+
+    // how TCP connections are raced when a host has several addresses (RFC 8305)
+    struct ConnectOptions {
+        // head start each attempt gets before the next address is tried alongside it
+        std::chrono::milliseconds attemptDelay{250};
+        // give up if nothing has connected by then
+        std::chrono::milliseconds timeout{10000};
+    };
+
+    // how long each step of the last open() took
+    struct ConnectTimings {
+        std::chrono::microseconds resolve{};
+        std::chrono::microseconds tcpConnect{};
+        std::chrono::microseconds tlsHandshake{};
+        // a resumed handshake skips the certificate exchange and a round trip
+        bool tlsResumed = false;
+        // from open() until the server accepted the upgrade
+        std::chrono::microseconds total{};
+        // how much of the upgrade request (and pipelined messages) the server accepted as TLS 0-RTT data
+        size_t earlyDataBytes = 0;
+        // whether TLS records are handled by the kernel, see TlsOptions::kernelOffload
+        bool tlsKernelOffload = false;
+    };
+
+    // client-side pings, see Client::setKeepalive
+    struct KeepaliveOptions {
+        // how often to ping the server while connected, zero disables pinging.
+        // pings from the server are answered either way
+        std::chrono::milliseconds interval{0};
+        // a ping that is not answered within this closes the connection as dead
+        std::chrono::milliseconds timeout{10000};
+    };
+
+    // round trip times measured by keepalive pings on one connection
+    struct LatencyStats {
+        size_t samples = 0;
+        std::chrono::microseconds last{};
+        std::chrono::microseconds p50{};
+        std::chrono::microseconds p99{};
+        std::chrono::microseconds max{};
+    };
+
+    // from most to least verbose, see Client::setLogLevel
     enum class LogSeverity {
-        Info,
         Debug,
+        Info,
         Error
     };
 
-    class Client {
+    struct LogRecord {
+        LogSeverity severity;
+        // Client::id() of the connection that logged
+        uint64_t connectionId;
+        // the function that logged
+        std::string_view source;
+        // only valid for the duration of the callback
+        std::string_view message;
+    };
+
+    // caps on what one Client::poll or Client::pollAll call does for each client, so a burst of traffic
+    // is spread over several calls instead of overrunning the caller's frame
+    struct PollLimits {
+        // messages (or fragments, in streaming mode) dispatched; the rest stay buffered for the next call
+        size_t maxMessages = 64;
+        // bytes read from the socket
+        size_t maxReadBytes = 256 * 1024;
+    };
+
+    // what send() does with a message that would take Client::bufferedAmount() over the high water mark
+    enum class OverflowPolicy {
+        // waits until the writer has brought the amount down to the low water mark. Where nothing could
+        // free space meanwhile (before the handshake, on the reactor's thread, in poll mode) it refuses instead
+        Block,
+        // queues it and drops the oldest messages not yet handed to the socket until the rest fits. While a
+        // threaded writer is stuck in a write, that waits until it comes back for more. Before the handshake
+        // nothing is being written, so it refuses instead
+        DropOldest,
+        // refuses it, see Client::SendAwaiter::queued
+        FailFast,
+        // closes the connection, the peer is too slow to keep
+        Disconnect
+    };
+
+    // outgoing and incoming buffer limits, see Client::setBackpressure
+    struct BackpressureOptions {
+        // queued bytes past which `policy` applies, zero for no limit. A message larger than this on its
+        // own is still queued when nothing else is
+        size_t highWaterMark = 0;
+        // once over the high mark, Client::onWritable fires when the amount is back down to this
+        size_t lowWaterMark = 0;
+        OverflowPolicy policy = OverflowPolicy::Block;
+        // incoming bytes read but not yet delivered (messages poll() has not dispatched, or receive() has
+        // not asked for) past which the socket is no longer read until they are, zero for no limit. A message
+        // larger than this on its own is still read whole
+        size_t maxUndelivered = 0;
+    };
+
+    // a message handed out by co_await Client::receive()
+    struct ReceivedMessage {
+        Opcode opcode;
+        // points into the connection's receive buffer, valid until the next receive()
+        std::span<const std::byte> data;
+
+        std::string_view text() const {
+            return {reinterpret_cast<const char*>(data.data()), data.size()};
+        }
+    };
+
+    class Client : private ReactorHandler {
     private:
+        // first, so everything that counts into it is destroyed before it
+        std::unique_ptr<ConnectionMetrics> counters;
+
         std::shared_ptr<BaseTransport> stream;
-        bool connected = false;
+        std::atomic<bool> connected = false;
+        // threaded mode: connects, then reads. Reactor and poll mode: connects and hands the socket over
         std::thread watchThread;
+        // set by close(), the connecting thread gives up at its next step. Joined before the client goes away
+        std::atomic<bool> connectCancelled = false;
         ServerAddress address;
 
         std::string createHandshakeRequest(ServerAddress address);
-        std::vector<uint8_t> createMessageFrame(std::string message);
+        // waits for the last connection's thread, unless called on it
+        void joinWatchThread();
+        // returns the frame's place among the data frames, 0 for control frames
+        uint64_t sendFrame(Opcode opcode, std::span<const uint8_t> payload);
+
+        // frames from every sending thread, written out by one writer at a time.
+        // also holds messages sent before the handshake completed
+        std::unique_ptr<SendQueue> sendQueue;
+        // only touched by the current writer. the batch of frames taken out of sendQueue is kept between
+        // passes, so taking them does not allocate
+        std::vector<ConstBuffer> gatherBuffers;
+        std::vector<OutgoingFrame*> writeBatch;
+        bool closeSent = false;
+
+        // owns the receive buffer, which is reused for every message on this connection and only grows
+        std::unique_ptr<FrameReader> reader;
+        std::pmr::memory_resource* memory = std::pmr::get_default_resource();
+
+        std::shared_ptr<TlsContext> tlsContext;
+        std::shared_ptr<ResolverCache> resolverCache;
+        std::shared_ptr<UringDriver> uringDriver;
+        ConnectOptions connectOptions;
+
+        std::string handshakeKey;
+        std::unique_ptr<HttpResponseParser> handshakeResponse;
+        bool pipelineHandshake = false;
+        bool earlyDataEnabled = false;
+        ConnectTimings timings;
+        std::chrono::steady_clock::time_point openedAt;
+
+        std::optional<CompressionOptions> compressionOptions;
+        std::unique_ptr<PerMessageDeflate> deflate;
+
+        // keepalive state is only touched by the thread reading the connection
+        using TimePoint = std::chrono::steady_clock::time_point;
+        KeepaliveOptions keepalive;
+        TimePoint nextPingAt{};
+        TimePoint pingSentAt{};
+        bool pingOutstanding = false;
+        // payload of the outstanding ping, the pong has to echo it
+        uint64_t pingStamp = 0;
+        // reactor mode: the earliest keepalive wakeup already scheduled with the reactor
+        bool timerArmed = false;
+        TimePoint armedDeadline{};
+        std::unique_ptr<LatencyHistogram> rtt;
+
+        // holds the upgrade request until it is sent. after that only used in reactor mode,
+        // where the reactor thread is the only writer and encodes queued frames into the outbox
+        Reactor* reactor = nullptr;
+        std::vector<uint8_t> outbox;
+        size_t outboxOffset = 0;
+
+        // coroutine mode (see connect()) state, only touched on the reactor thread.
+        // data frames are counted as they are queued, taken into the outbox, dropped behind a close frame,
+        // and written, which is when the outbox they were encoded into has drained. an awaited send()
+        // finishes once the written count reaches its frame
+        bool awaitable = false;
+        std::atomic<uint64_t> dataQueued = 0;
+        uint64_t dataEncoded = 0;
+        uint64_t dataDropped = 0;
+        uint64_t dataWritten = 0;
+        // the message handed to receive(), kept in the receive buffer until the next receive(); nothing
+        // behind it is parsed meanwhile and reading stops once the socket has more, so a slow consumer
+        // holds back the server through TCP flow control instead of piling up messages
+        std::optional<ReceivedMessage> incoming;
+        bool incomingTaken = false;
+        bool readPaused = false;
+        std::coroutine_handle<> connectWaiter;
+        std::coroutine_handle<> receiveWaiter;
+        struct SendWaiter {
+            uint64_t sequence;
+            std::coroutine_handle<> handle;
+        };
+        std::vector<SendWaiter> sendWaiters;
+        // why the connection ended, what awaiting coroutines get as their error. empty while it is up.
+        // the first reason given sticks; senders, the connecting thread and the reader all set it
+        mutable std::mutex closeMutex;
+        std::string closeReason;
+        void setCloseReason(std::string_view reason);
+        bool hasCloseReason() const;
+        // the reason, or "not connected" when there is none
+        std::string closeError() const;
 
-        // queue to send messages upon connection
-        std::vector<std::string> queue;
+        // payload bytes sent but not yet written, including what sits in the outbox. the outbox's share
+        // is released once it drains, like dataWritten
+        BackpressureOptions backpressure;
+        std::atomic<size_t> bufferedBytes = 0;
+        size_t outboxPayloadBytes = 0;
+        // set once the high water mark is reached, cleared when the low one is and onWritable fires
+        std::atomic<bool> overHighWater = false;
+        std::mutex bufferMutex;
+        std::condition_variable bufferSpace;
+        std::function<void()> writableCallback;
+        // DropOldest: frames a sender took out of the queue to drop the oldest, ahead of everything still
+        // queued. only touched while holding the writer role
+        std::vector<OutgoingFrame*> heldFrames;
+        // data frames dropped that way, counted into dataEncoded by the next encoding
+        std::atomic<uint64_t> dataTrimmed = 0;
+
+        // poll mode (see setPollMode): the connecting thread hands the non-blocking socket over with pollReady,
+        // everything after that happens inside poll() on the caller's thread
+        bool pollMode = false;
+        std::atomic<bool> pollReady = false;
+        // set when the last poll() stopped at a limit with work left, so the next one does not wait
+        bool pollBacklog = false;
+        // what the current poll() may still do, unlimited outside of it
+        size_t dispatchBudget = SIZE_MAX;
+        size_t readBudget = SIZE_MAX;
 
         std::function<void(std::string)> msgCallback;
-        std::function<void(LogSeverity, std::string)> logCallback;
+        std::function<void(std::string_view)> msgViewCallback;
+        std::function<void(std::span<const std::byte>)> binaryCallback;
+        std::function<void(std::span<const std::byte>, bool)> fragmentCallback;
+        std::function<void(const LogRecord&)> logCallback;
+        std::atomic<LogSeverity> logLevel = LogSeverity::Debug;
+        uint64_t clientId;
 
-        void info(std::string message) {
-            logCallback(LogSeverity::Info, message);
-        }
-        void debug(std::string message) {
-            logCallback(LogSeverity::Debug, message);
-        }
-        void error(std::string message) {
-            logCallback(LogSeverity::Error, message);
+        // checked before anything is formatted, see Log.hpp
+        bool logEnabled(LogSeverity severity) const {
+            return severity >= logLevel.load(std::memory_order_relaxed) && logCallback;
         }
 
+        void writeLog(LogSeverity severity, std::string_view source, std::string_view message);
+
+        static constexpr size_t MaxHandshakeResponseSize = 16 * 1024;
+
+        geode::Result<> connectTransport(std::shared_future<ResolveResult> addresses);
         void watch();
+        geode::Result<> completeHandshake(const HttpResponseParser& response);
+        bool processIncoming();
+        bool readAvailable();
+        // whether the undelivered bytes in the reader are past BackpressureOptions::maxUndelivered
+        bool undeliveredFull() const;
+        void dispatchMessage(Opcode opcode, std::span<const uint8_t> payload);
+        bool handleControl(Opcode opcode, std::span<const uint8_t> payload);
+        bool waitReadable();
+
+        void startKeepalive(TimePoint now);
+        void keepaliveTick(TimePoint now);
+        TimePoint nextKeepaliveDeadline() const;
+        void sendPing(TimePoint now);
+        void handlePong(std::span<const uint8_t> payload);
+        void armKeepaliveTimer();
+
+        void reactorReadable() override;
+        void reactorWritable() override;
+        void reactorTimer(TimePoint now) override;
+        geode::Result<> flushOutbox();
+        void updateInterest();
+
+        bool wantsWrite() const;
+        size_t pollService(short events, PollLimits limits);
+
+        bool pollReceive();
+        void resumeSenders();
+        // hands `reason` to every awaiting coroutine, resumed from the reactor loop
+        void failWaiters(std::string_view reason);
+
+        // applies the overflow policy to a message of `size` bytes; false if it must not be queued
+        bool admit(size_t size);
+        void releaseBuffered(size_t bytes);
+        // under DropOldest, drops the oldest data frames until the buffer plus `incoming` bytes about to be queued fit
+        void dropOldest(std::vector<OutgoingFrame*>& frames, size_t incoming = 0);
+
+        void flushSendQueue();
+        geode::Result<> writeQueuedFrames();
+        void encodeQueuedFrames(std::vector<uint8_t>& out);
+        // fills writeBatch with the frames to write next
+        void takeQueuedFrames(size_t incoming = 0);
+        geode::Result<uint32_t> prepareFrame(OutgoingFrame& frame);
+        void sendClose(uint16_t code, std::string_view reason);
+        void fail(uint16_t code, std::string_view reason);
+        // sends a close frame and drops the connection without waiting for the server's answer
+        void closeWith(uint16_t code, std::string_view reason);
 
     public:
         Client();
-        ~Client() noexcept {
-            close();
-        }
+        ~Client() noexcept;
+
+        // what connect(), receive() and send() return; co_await them right away
+        class ConnectAwaiter {
+        public:
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle);
+            geode::Result<> await_resume();
+
+        private:
+            friend class Client;
+
+            ConnectAwaiter(Client* client, geode::Result<ServerAddress> address) : client(client), address(std::move(address)) {}
+
+            Client* client;
+            geode::Result<ServerAddress> address;
+            std::string error;
+        };
+
+        class ReceiveAwaiter {
+        public:
+            bool await_ready();
+            void await_suspend(std::coroutine_handle<> handle);
+            geode::Result<ReceivedMessage> await_resume();
+
+        private:
+            friend class Client;
+
+            explicit ReceiveAwaiter(Client* client) : client(client) {}
+
+            Client* client;
+        };
+
+        // send() queues the message right away, so it can also be dropped without awaiting
+        class SendAwaiter {
+        public:
+            bool await_ready() const;
+            void await_suspend(std::coroutine_handle<> handle);
+            geode::Result<> await_resume() const;
+
+            // false if the overflow policy refused the message, see setBackpressure
+            bool queued() const {
+                return !refused;
+            }
+
+        private:
+            friend class Client;
+
+            SendAwaiter(Client* client, uint64_t sequence, bool refused = false)
+                : client(client), sequence(sequence), refused(refused) {}
+
+            Client* client;
+            uint64_t sequence;
+            bool refused;
+        };
 
 
         bool isConnected() {
             return connected;
         }
 
+        // Hands this connection to `reactor` instead of giving it a thread of its own.
+        // Must be called before open(); callbacks then run on the reactor's thread
+        void setReactor(Reactor* reactor);
+
+        // Threadless mode, for programs with a loop of their own: once connected, nothing happens in the
+        // background. Sending only queues, and the connection is serviced by calling poll() or pollAll(),
+        // which run every callback inline. Only the lookup, TCP connect and TLS handshake still happen on a
+        // short-lived thread after open(). Call before open(); ignored when a reactor is set
+        void setPollMode(bool enabled);
+
+        // Poll mode: waits up to `timeout` for the socket, then writes what is queued, reads what has arrived
+        // and dispatches the complete messages, within `limits`. Returns how many messages were dispatched.
+        // Returns right away with 0 for clients still connecting or not in poll mode
+        size_t poll(std::chrono::milliseconds timeout = {}, PollLimits limits = {});
+
+        // poll() for several clients with a single wait on all their sockets; `limits` apply to each client
+        static size_t pollAll(std::span<Client* const> clients, std::chrono::milliseconds timeout = {}, PollLimits limits = {});
+
+        // Allocates outgoing frames, the read buffer, reassembled messages and compression state from
+        // `memory` instead of the global heap: a FramePool to recycle frame buffers, a MemoryAccount to
+        // see what this client uses, or any resource of your own. Must be called before open(), and
+        // `memory` must outlive the client
+        void setMemoryResource(std::pmr::memory_resource* memory);
+
+        // Runs plain ws:// connections on `driver`'s io_uring instead of send()/recv(); nullptr goes back
+        // to the sockets. wss:// and reactor mode always use the sockets. Must be called before open()
+        void setUringDriver(std::shared_ptr<UringDriver> driver);
+
+        // Sends messages queued before the handshake in the same flight as the upgrade request instead of
+        // after the 101 response, saving a round trip per connect. Those messages go out uncompressed, and
+        // a server that refuses the upgrade sees them as junk after the request, so only enable this for
+        // servers known to accept the connection. Call before open()
+        void setHandshakePipelining(bool enabled);
+
+        // On resumed TLS sessions whose ticket allows it, sends the upgrade request (and with pipelining,
+        // the queued messages) as TLS 1.3 0-RTT early data, so it is answered one round trip sooner.
+        // If the server rejects early data everything is simply sent again after the handshake.
+        // Early data can be replayed by an attacker, so only enable this when the pipelined messages are
+        // safe to deliver twice. Call before open()
+        void setEarlyData(bool enabled);
+
+        // Shares the DNS cache with every client given the same one. Without this, ResolverCache::shared() is used.
+        // Call before open()
+        void setResolver(std::shared_ptr<ResolverCache> cache);
+        void setConnectOptions(ConnectOptions options);
+
+        // Shares `context` (trust store and resumable sessions) with every client given the same one.
+        // Without this, wss:// connections use TlsContext::shared(). Call before open()
+        void setTlsContext(std::shared_ptr<TlsContext> context);
+
+        // Returns right away: the lookup, TCP connect, TLS and WebSocket handshakes run in the background.
+        // Messages sent meanwhile are queued, failures are reported through the log
         geode::Result<> open(ServerAddress address);
         geode::Result<> open(std::string_view url);
         void close();
 
-        void send(std::string data);
+        // Coroutine mode, for clients given a reactor with setReactor(). Awaited from a coroutine running on
+        // that reactor (see spawn()), this opens the connection and resumes once the handshake is done or
+        // failed. Messages are then taken with co_await receive() instead of the callbacks:
+        //
+        //     ws::spawn(*reactor, [](ws::Client& client) -> ws::Task<> {
+        //         if ((co_await client.connect("ws://localhost:8080")).isErr()) co_return;
+        //         while (true) {
+        //             auto message = co_await client.receive();
+        //             if (message.isErr()) co_return;
+        //             co_await client.send(message.unwrap().text());
+        //         }
+        //     }(client));
+        //
+        // Everything runs on the reactor's thread, so one thread serves as many of these as it has connections
+        ConnectAwaiter connect(ServerAddress address);
+        ConnectAwaiter connect(std::string_view url);
 
+        // The next message, once it has arrived, or the reason the connection ended. Until this is called
+        // again nothing further is parsed and the socket is no longer read once its data is buffered, so the
+        // server slows down to the pace of the coroutine. Fragments still go to onFragment when set
+        ReceiveAwaiter receive();
+
+        const ConnectTimings& connectTimings() const {
+            return timings;
+        }
+
+        // Pings the server every `options.interval` and closes the connection when a ping goes unanswered
+        // for `options.timeout`, so idle connections stay open through proxies and dead ones are noticed.
+        // Call before open()
+        void setKeepalive(KeepaliveOptions options);
+
+        // round trip times of the keepalive pings on the current connection, safe to call from any thread
+        LatencyStats latency() const;
+
+        // I/O, frame, queue and callback counters of this client over all its connections.
+        // Safe to call from any thread while the connection is busy
+        MetricsSnapshot metrics() const;
+
+        // Sends a text message. In coroutine mode, awaiting the result waits until the message was written
+        // to the socket, or returns why it never will be. Otherwise that is immediate. A message refused by
+        // the overflow policy (see setBackpressure) is not queued at all, and awaiting it returns the error
+        SendAwaiter send(std::string_view data);
+        SendAwaiter send(std::span<const std::byte> data, Opcode opcode = Opcode::Binary);
+
+        // Bounds what send() may queue while the socket cannot keep up: past `options.highWaterMark` bytes,
+        // `options.policy` decides. On the way in, `options.maxUndelivered` stops reading once that many bytes
+        // wait to be dispatched by poll() or taken by receive(). Call before open()
+        void setBackpressure(BackpressureOptions options);
+
+        // payload bytes sent but not yet written to the socket, like the browser's WebSocket.bufferedAmount.
+        // Safe to call from any thread
+        size_t bufferedAmount() const {
+            return bufferedBytes.load(std::memory_order_relaxed);
+        }
+
+        // Called when bufferedAmount() drops to the low water mark after having reached the high one,
+        // on the thread that freed the space. The place to resume a producer that backed off
+        void onWritable(std::function<void()> callback) {
+            writableCallback = std::move(callback);
+        }
+
+        // the string is a copy the callback owns; prefer onMessageView unless the text must outlive the callback
         void onMessage(std::function<void(std::string)> callback) {
             msgCallback = callback;
         }
 
-        void onLog(std::function<void(LogSeverity, std::string)> callback) {
+        // the view points into the connection's receive buffer and is only valid for the duration of the callback.
+        // takes priority over onMessage
+        void onMessageView(std::function<void(std::string_view)> callback) {
+            msgViewCallback = callback;
+        }
+
+        // the span is only valid for the duration of the callback.
+        // binary messages go to onMessage if this is not set
+        void onBinary(std::function<void(std::span<const std::byte>)> callback) {
+            binaryCallback = callback;
+        }
+
+        // Switches to streaming mode: data messages are no longer reassembled and instead
+        // arrive here piece by piece as they come off the wire, with `last` set on the final piece.
+        // Memory use then stays at the receive buffer size regardless of message size.
+        void onFragment(std::function<void(std::span<const std::byte> data, bool last)> callback);
+
+        // Offers permessage-deflate in the handshake. Whether it is used depends on the server,
+        // call before open()
+        void enableCompression(CompressionOptions options = {});
+
+        // Largest message that will be reassembled; bigger ones close the connection with 1009.
+        // Defaults to 64 MiB, does not apply in streaming mode
+        void setMaxMessageSize(size_t size);
+
+        // Receives every log record at or above the log level, with the connection and function it came from
+        void onLogRecord(std::function<void(const LogRecord&)> callback) {
             logCallback = callback;
         }
 
+        // plain text version of onLogRecord
+        void onLog(std::function<void(LogSeverity, std::string)> callback);
+
+        // Records below `minimum` are dropped before they are formatted. Defaults to Debug; note that
+        // release builds compile Debug records out entirely unless built with MINIWS_LOG_FLOOR=0
+        void setLogLevel(LogSeverity minimum) {
+            logLevel.store(minimum, std::memory_order_relaxed);
+        }
+
+        // unique within the process, tags this client's log records
+        uint64_t id() const {
+            return clientId;
+        }
+
         static std::string severityToString(LogSeverity);
     };
 }
\ No newline at end of file
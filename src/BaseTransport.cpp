@@ -1,10 +1,26 @@
 #include <BaseTransport.hpp>
 #include <stdint.h>
+#include <algorithm>
+#include <limits>
+#include "ConnectionMetrics.hpp"
+#include "SocketUtil.hpp"
 
 using namespace geode;
 
 namespace ws {
 
+void BaseTransport::countRead(size_t bytes) {
+    if (metrics) {
+        metrics->countRead(bytes);
+    }
+}
+
+void BaseTransport::countWrite(size_t bytes) {
+    if (metrics) {
+        metrics->countWrite(bytes);
+    }
+}
+
 Result<> BaseTransport::receiveExact(void* buffer, size_t size) {
     size_t totalReceived = 0;
     uint8_t* bufPtr = static_cast<uint8_t*>(buffer);
@@ -39,4 +55,84 @@ Result<size_t> BaseTransport::sendAll(const void* data, size_t size) {
     return Ok(totalSent);
 }
 
-}
\ No newline at end of file
+Result<size_t> BaseTransport::sendv(std::span<const ConstBuffer> buffers) {
+    for (auto& buffer : buffers) {
+        if (buffer.size > 0) {
+            return this->send(buffer.data, buffer.size);
+        }
+    }
+
+    return Ok(0);
+}
+
+Result<size_t> BaseTransport::sendAllv(std::span<const ConstBuffer> buffers) {
+    // one gathered write's worth, copied so partially sent entries can be advanced without touching
+    // the caller's list
+    ConstBuffer pending[MaxGatherBuffers];
+
+    size_t totalSent = 0;
+
+    while (!buffers.empty()) {
+        size_t count = std::min(buffers.size(), MaxGatherBuffers);
+        std::copy_n(buffers.begin(), count, pending);
+        buffers = buffers.subspan(count);
+
+        size_t first = 0;
+        while (first < count) {
+            if (pending[first].size == 0) {
+                ++first;
+                continue;
+            }
+
+            GEODE_UNWRAP_INTO(size_t sent, this->sendv({pending + first, count - first}));
+
+            if (sent == 0) {
+                return Err("Connection closed before sending all data");
+            }
+
+            totalSent += sent;
+
+            while (sent > 0) {
+                size_t step = std::min(sent, pending[first].size);
+                pending[first].data = static_cast<const uint8_t*>(pending[first].data) + step;
+                pending[first].size -= step;
+                sent -= step;
+
+                if (pending[first].size == 0) {
+                    ++first;
+                }
+            }
+        }
+    }
+
+    return Ok(totalSent);
+}
+
+Result<> BaseTransport::setNonBlocking(bool) {
+    // nothing to switch for transports without a socket
+    return Ok();
+}
+
+bool BaseTransport::waitReadable(std::chrono::milliseconds timeout) {
+    if (this->hasPendingInput()) {
+        return true;
+    }
+
+    pollfd fd{static_cast<qsox::SockFd>(this->nativeHandle()), POLLIN, 0};
+    int res = pollSockets(&fd, 1, static_cast<int>(std::clamp<int64_t>(timeout.count(), 0, std::numeric_limits<int>::max())));
+
+    // errors and hangups are left for the read to report
+    return res > 0 || (res < 0 && lastSocketErrorCode() != EINTR);
+}
+
+Result<std::optional<size_t>> BaseTransport::tryReceive(void* buffer, size_t size) {
+    GEODE_UNWRAP_INTO(size_t received, this->receive(buffer, size));
+    return Ok(std::optional<size_t>{received});
+}
+
+Result<std::optional<size_t>> BaseTransport::trySendv(std::span<const ConstBuffer> buffers) {
+    GEODE_UNWRAP_INTO(size_t sent, this->sendv(buffers));
+    return Ok(std::optional<size_t>{sent});
+}
+
+}
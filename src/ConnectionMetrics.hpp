@@ -0,0 +1,108 @@
+#pragma once
+
+#include <Metrics.hpp>
+#include <atomic>
+#include <chrono>
+
+namespace ws {
+
+// Live counters behind Client::metrics(), registered for Metrics::global() for as long as they exist.
+// Everything is a relaxed atomic, so any thread can take a snapshot in the middle of I/O. Counters with
+// a single writer at a time (the reading thread, or whoever holds the send queue's writer role) are
+// bumped with a plain load and store; only the ones any thread can touch pay for a read-modify-write.
+class ConnectionMetrics {
+public:
+    ConnectionMetrics();
+    // folds the counts into the process totals
+    ~ConnectionMetrics();
+
+    ConnectionMetrics(const ConnectionMetrics&) = delete;
+    ConnectionMetrics& operator=(const ConnectionMetrics&) = delete;
+
+    // transport, reading thread / writer role
+    void countRead(size_t bytes) {
+        bump(reads, 1);
+        bump(bytesIn, bytes);
+    }
+
+    void countWrite(size_t bytes) {
+        bump(writes, 1);
+        bump(bytesOut, bytes);
+    }
+
+    // frame parser, reading thread
+    void countFrameIn(uint8_t opcode, uint64_t size) {
+        bump(framesIn[opcode & 0xf], 1);
+        raise(largestFrameIn, size);
+    }
+
+    // writer role
+    void countFrameOut(uint8_t opcode, uint64_t size) {
+        bump(framesOut[opcode & 0xf], 1);
+        raise(largestFrameOut, size);
+    }
+
+    // any sending thread
+    void countAllocations(uint64_t count) {
+        frameAllocations.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void countQueued() {
+        uint64_t depth = queueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        uint64_t high = queueHighWater.load(std::memory_order_relaxed);
+        while (depth > high && !queueHighWater.compare_exchange_weak(high, depth, std::memory_order_relaxed)) {}
+    }
+
+    // writer role
+    void countDequeued(size_t count) {
+        queueDepth.fetch_sub(count, std::memory_order_relaxed);
+    }
+
+    // reading thread
+    void countHandshake(std::chrono::microseconds duration) {
+        bump(handshakes, 1);
+        bump(handshakeMicros, static_cast<uint64_t>(duration.count()));
+    }
+
+    void countCallback(std::chrono::microseconds duration) {
+        uint64_t micros = static_cast<uint64_t>(duration.count());
+        bump(callbacks, 1);
+        bump(callbackMicros, micros);
+        raise(callbackMaxMicros, micros);
+    }
+
+    MetricsSnapshot snapshot() const;
+
+private:
+    using Counter = std::atomic<uint64_t>;
+
+    Counter bytesIn = 0;
+    Counter bytesOut = 0;
+    Counter reads = 0;
+    Counter writes = 0;
+    std::array<Counter, 16> framesIn{};
+    std::array<Counter, 16> framesOut{};
+    Counter largestFrameIn = 0;
+    Counter largestFrameOut = 0;
+    Counter queueDepth = 0;
+    Counter queueHighWater = 0;
+    Counter frameAllocations = 0;
+    Counter handshakes = 0;
+    Counter handshakeMicros = 0;
+    Counter callbacks = 0;
+    Counter callbackMicros = 0;
+    Counter callbackMaxMicros = 0;
+
+    static void bump(Counter& counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    static void raise(Counter& counter, uint64_t value) {
+        if (value > counter.load(std::memory_order_relaxed)) {
+            counter.store(value, std::memory_order_relaxed);
+        }
+    }
+};
+
+}
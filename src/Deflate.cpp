@@ -0,0 +1,329 @@
+#include "Deflate.hpp"
+
+#include <zlib.h>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <new>
+
+using namespace geode;
+
+namespace ws {
+
+// a sync flush always ends in an empty stored block, which permessage-deflate leaves off the wire
+static constexpr uint8_t FlushTail[] = { 0x00, 0x00, 0xFF, 0xFF };
+
+static std::string_view trim(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+
+    return str;
+}
+
+static std::optional<int> parseWindowBits(std::string_view value) {
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+        value = value.substr(1, value.size() - 2);
+    }
+
+    int bits = 0;
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), bits);
+    // zlib cannot produce raw deflate streams with an 8 bit window, so 9 is our floor
+    if (ec != std::errc() || ptr != value.data() + value.size() || bits < 9 || bits > 15) {
+        return std::nullopt;
+    }
+
+    return bits;
+}
+
+std::string PerMessageDeflate::offer(const CompressionOptions& options) {
+    std::string value = "permessage-deflate";
+
+    if (options.clientMaxWindowBits < 15) {
+        value += "; client_max_window_bits=" + std::to_string(options.clientMaxWindowBits);
+    } else {
+        value += "; client_max_window_bits";
+    }
+
+    if (options.serverMaxWindowBits < 15) {
+        value += "; server_max_window_bits=" + std::to_string(options.serverMaxWindowBits);
+    }
+
+    if (options.clientNoContextTakeover) {
+        value += "; client_no_context_takeover";
+    }
+
+    if (options.serverNoContextTakeover) {
+        value += "; server_no_context_takeover";
+    }
+
+    return value;
+}
+
+std::optional<DeflateParams> PerMessageDeflate::accept(std::string_view response, const CompressionOptions& options) {
+    // we only ever offer one extension, so anything listing more is invalid
+    if (response.find(',') != std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    DeflateParams params{
+        .clientMaxWindowBits = options.clientMaxWindowBits,
+        .serverMaxWindowBits = options.serverMaxWindowBits,
+        .clientNoContextTakeover = options.clientNoContextTakeover,
+        .serverNoContextTakeover = options.serverNoContextTakeover
+    };
+
+    bool first = true;
+    while (!response.empty()) {
+        size_t end = response.find(';');
+        std::string_view param = trim(response.substr(0, end));
+        response = end == std::string_view::npos ? std::string_view{} : response.substr(end + 1);
+
+        if (first) {
+            if (param != "permessage-deflate") {
+                return std::nullopt;
+            }
+            first = false;
+            continue;
+        }
+
+        std::string_view name = param, value;
+        if (size_t eq = param.find('='); eq != std::string_view::npos) {
+            name = trim(param.substr(0, eq));
+            value = trim(param.substr(eq + 1));
+        }
+
+        if (name == "client_no_context_takeover") {
+            params.clientNoContextTakeover = true;
+        } else if (name == "server_no_context_takeover") {
+            params.serverNoContextTakeover = true;
+        } else if (name == "client_max_window_bits") {
+            auto bits = parseWindowBits(value);
+            if (!bits) {
+                return std::nullopt;
+            }
+            params.clientMaxWindowBits = std::min(*bits, options.clientMaxWindowBits);
+        } else if (name == "server_max_window_bits") {
+            auto bits = parseWindowBits(value);
+            if (!bits || *bits > options.serverMaxWindowBits) {
+                return std::nullopt;
+            }
+            params.serverMaxWindowBits = *bits;
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    if (first) {
+        return std::nullopt;
+    }
+
+    return params;
+}
+
+// zlib only hands back the pointer when freeing, so each block starts with its size
+static constexpr size_t ZlibBlockHeader = alignof(std::max_align_t);
+
+static voidpf zlibAlloc(voidpf opaque, uInt items, uInt size) {
+    auto memory = static_cast<std::pmr::memory_resource*>(opaque);
+    size_t bytes = ZlibBlockHeader + static_cast<size_t>(items) * size;
+
+    void* block;
+    try {
+        block = memory->allocate(bytes, alignof(std::max_align_t));
+    } catch (const std::bad_alloc&) {
+        return Z_NULL;
+    }
+
+    std::memcpy(block, &bytes, sizeof(bytes));
+    return static_cast<uint8_t*>(block) + ZlibBlockHeader;
+}
+
+static void zlibFree(voidpf opaque, voidpf address) {
+    auto memory = static_cast<std::pmr::memory_resource*>(opaque);
+    void* block = static_cast<uint8_t*>(address) - ZlibBlockHeader;
+
+    size_t bytes;
+    std::memcpy(&bytes, block, sizeof(bytes));
+    memory->deallocate(block, bytes, alignof(std::max_align_t));
+}
+
+PerMessageDeflate::PerMessageDeflate(const CompressionOptions& options, const DeflateParams& params, std::pmr::memory_resource* memory)
+    : options(options), params(params), deflateBuffer(memory), inflateBuffer(memory)
+{
+    deflater = new z_stream{};
+    deflater->zalloc = zlibAlloc;
+    deflater->zfree = zlibFree;
+    deflater->opaque = memory;
+
+    inflater = new z_stream{};
+    inflater->zalloc = zlibAlloc;
+    inflater->zfree = zlibFree;
+    inflater->opaque = memory;
+}
+
+Result<std::unique_ptr<PerMessageDeflate>> PerMessageDeflate::create(
+    const CompressionOptions& options, const DeflateParams& params, std::pmr::memory_resource* memory
+) {
+    std::unique_ptr<PerMessageDeflate> deflate{new PerMessageDeflate(options, params, memory)};
+
+    // negative window bits select raw deflate without the zlib header.
+    // with a custom memory resource, running out of memory here is a real possibility
+    int res = deflateInit2(deflate->deflater, options.level, Z_DEFLATED, -params.clientMaxWindowBits, 8, Z_DEFAULT_STRATEGY);
+    if (res != Z_OK) {
+        return Err(std::string("unable to set up deflate: ") + zError(res));
+    }
+    deflate->deflaterReady = true;
+
+    res = inflateInit2(deflate->inflater, -params.serverMaxWindowBits);
+    if (res != Z_OK) {
+        return Err(std::string("unable to set up inflate: ") + zError(res));
+    }
+    deflate->inflaterReady = true;
+
+    return Ok(std::move(deflate));
+}
+
+PerMessageDeflate::~PerMessageDeflate() {
+    if (deflaterReady) {
+        deflateEnd(deflater);
+    }
+    delete deflater;
+
+    if (inflaterReady) {
+        inflateEnd(inflater);
+    }
+    delete inflater;
+}
+
+Result<std::span<const uint8_t>> PerMessageDeflate::compress(std::span<const uint8_t> payload) {
+    deflater->next_in = const_cast<Bytef*>(payload.data());
+    deflater->avail_in = static_cast<uInt>(payload.size());
+
+    size_t total = 0;
+    size_t capacity = std::max<size_t>(deflateBuffer.size(), payload.size() / 2 + 64);
+
+    do {
+        if (deflateBuffer.size() < capacity) {
+            deflateBuffer.resize(capacity);
+        }
+
+        deflater->next_out = deflateBuffer.data() + total;
+        deflater->avail_out = static_cast<uInt>(deflateBuffer.size() - total);
+
+        int res = deflate(deflater, Z_SYNC_FLUSH);
+        if (res != Z_OK && res != Z_BUF_ERROR) {
+            return Err(std::string(deflater->msg ? deflater->msg : "deflate failed"));
+        }
+
+        total = deflateBuffer.size() - deflater->avail_out;
+        capacity = deflateBuffer.size() * 2;
+    } while (deflater->avail_out == 0);
+
+    if (total >= 4 && std::memcmp(deflateBuffer.data() + total - 4, FlushTail, 4) == 0) {
+        total -= 4;
+    }
+
+    if (params.clientNoContextTakeover) {
+        deflateReset(deflater);
+    }
+
+    return Ok(std::span<const uint8_t>{deflateBuffer.data(), total});
+}
+
+void PerMessageDeflate::beginMessage() {
+    if (streamEnded || params.serverNoContextTakeover) {
+        inflateReset(inflater);
+        streamEnded = false;
+    }
+}
+
+void PerMessageDeflate::setInput(std::span<const uint8_t> input, bool endOfMessage) {
+    inflater->next_in = const_cast<Bytef*>(input.data());
+    inflater->avail_in = static_cast<uInt>(input.size());
+    tailPending = endOfMessage;
+}
+
+Result<PerMessageDeflate::InflateStep, InflateError> PerMessageDeflate::inflateSome(std::span<uint8_t> out) {
+    inflater->next_out = out.data();
+    inflater->avail_out = static_cast<uInt>(out.size());
+
+    while (inflater->avail_out > 0 && !streamEnded) {
+        if (inflater->avail_in == 0) {
+            if (!tailPending) {
+                break;
+            }
+
+            inflater->next_in = const_cast<Bytef*>(FlushTail);
+            inflater->avail_in = sizeof(FlushTail);
+            tailPending = false;
+        }
+
+        int res = inflate(inflater, Z_SYNC_FLUSH);
+        if (res == Z_STREAM_END) {
+            // the peer finished the deflate stream; whatever follows is padding
+            streamEnded = true;
+        } else if (res == Z_BUF_ERROR) {
+            break;
+        } else if (res != Z_OK) {
+            return Err(InflateError::Corrupt);
+        }
+    }
+
+    if (streamEnded) {
+        inflater->avail_in = 0;
+        tailPending = false;
+    }
+
+    return Ok(InflateStep{
+        .produced = out.size() - inflater->avail_out,
+        .inputDone = inflater->avail_in == 0 && !tailPending && inflater->avail_out > 0
+    });
+}
+
+Result<std::span<uint8_t>, InflateError> PerMessageDeflate::decompress(std::span<const uint8_t> message, size_t maxSize) {
+    constexpr size_t Step = 16 * 1024;
+
+    this->beginMessage();
+    this->setInput(message, true);
+
+    size_t total = 0;
+    while (true) {
+        if (inflateBuffer.size() < total + Step) {
+            inflateBuffer.resize(std::max(inflateBuffer.size() * 2, total + Step));
+        }
+
+        // never hand zlib more room than the size limit allows, so a bomb is caught early. one byte past
+        // the limit tells it was crossed; SIZE_MAX (no limit) must not wrap to no room at all
+        size_t allowed = maxSize - std::min(maxSize, total);
+        if (allowed < SIZE_MAX) {
+            ++allowed;
+        }
+
+        size_t room = std::min(inflateBuffer.size() - total, allowed);
+
+        GEODE_UNWRAP_INTO(auto step, this->inflateSome({inflateBuffer.data() + total, room}));
+        total += step.produced;
+
+        if (total > maxSize) {
+            return Err(InflateError::TooBig);
+        }
+
+        if (step.inputDone) {
+            break;
+        }
+
+        // zlib made no progress with input left and room to write, so the data is broken
+        if (step.produced == 0) {
+            return Err(InflateError::Corrupt);
+        }
+    }
+
+    return Ok(std::span<uint8_t>{inflateBuffer.data(), total});
+}
+
+}
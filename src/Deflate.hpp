@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Geode/Result.hpp>
+#include <miniws.hpp>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct z_stream_s;
+
+namespace ws {
+
+// parameters agreed on in the handshake (RFC 7692 section 7.1)
+struct DeflateParams {
+    int clientMaxWindowBits = 15;
+    int serverMaxWindowBits = 15;
+    bool clientNoContextTakeover = false;
+    bool serverNoContextTakeover = false;
+};
+
+enum class InflateError {
+    Corrupt,
+    TooBig
+};
+
+// permessage-deflate state for one connection. Both zlib streams live as long as the
+// connection so context takeover works and no per-message setup is paid.
+class PerMessageDeflate {
+public:
+    // value for the Sec-WebSocket-Extensions request header
+    static std::string offer(const CompressionOptions& options);
+
+    // Parses the server's Sec-WebSocket-Extensions value.
+    // Returns std::nullopt if the response is not something we can accept, which fails the connection
+    static std::optional<DeflateParams> accept(std::string_view response, const CompressionOptions& options);
+
+    // zlib's window and hash tables and the output buffers are allocated from `memory`.
+    // Fails when zlib cannot set up its streams, which the connection then has to fail too
+    static geode::Result<std::unique_ptr<PerMessageDeflate>> create(
+        const CompressionOptions& options, const DeflateParams& params, std::pmr::memory_resource* memory = std::pmr::get_default_resource()
+    );
+    ~PerMessageDeflate();
+
+    PerMessageDeflate(const PerMessageDeflate&) = delete;
+    PerMessageDeflate& operator=(const PerMessageDeflate&) = delete;
+
+    // whether a message of this size is worth compressing
+    bool shouldCompress(size_t size) const {
+        return size >= options.minSize;
+    }
+
+    // Compresses one whole message. The result lives in a buffer reused by the next call
+    geode::Result<std::span<const uint8_t>> compress(std::span<const uint8_t> payload);
+
+    // Decompresses one whole message, failing once the output grows past `maxSize`.
+    // The result lives in a buffer reused by the next call
+    geode::Result<std::span<uint8_t>, InflateError> decompress(std::span<const uint8_t> message, size_t maxSize);
+
+    // Incremental decompression for streaming mode. Call beginMessage() once per message,
+    // then feed each piece with setInput() and drain it with inflateSome() until it reports inputDone.
+    struct InflateStep {
+        size_t produced;
+        bool inputDone;
+    };
+
+    void beginMessage();
+    void setInput(std::span<const uint8_t> input, bool endOfMessage);
+    geode::Result<InflateStep, InflateError> inflateSome(std::span<uint8_t> out);
+
+private:
+    PerMessageDeflate(const CompressionOptions& options, const DeflateParams& params, std::pmr::memory_resource* memory);
+
+    CompressionOptions options;
+    DeflateParams params;
+
+    z_stream_s* deflater = nullptr;
+    z_stream_s* inflater = nullptr;
+    // whether deflateInit2/inflateInit2 succeeded, so only those are ended
+    bool deflaterReady = false;
+    bool inflaterReady = false;
+
+    bool tailPending = false;
+    bool streamEnded = false;
+
+    std::pmr::vector<uint8_t> deflateBuffer;
+    std::pmr::vector<uint8_t> inflateBuffer;
+};
+
+}
@@ -0,0 +1,78 @@
+#include "Frame.hpp"
+
+#include <cstring>
+
+namespace ws {
+
+std::optional<FrameHeader> parseFrameHeader(std::span<const uint8_t> data) {
+    if (data.size() < 2) {
+        return std::nullopt;
+    }
+
+    FrameHeader header{};
+    header.fin = data[0] & 0x80;
+    header.rsv = (data[0] >> 4) & 0x07;
+    header.opcode = data[0] & 0x0F;
+    header.masked = data[1] & 0x80;
+    header.payloadSize = data[1] & 0x7F;
+    header.headerSize = 2;
+
+    size_t extendedSize = 0;
+    if (header.payloadSize == 126) {
+        extendedSize = 2;
+    } else if (header.payloadSize == 127) {
+        extendedSize = 8;
+    }
+
+    size_t needed = 2 + extendedSize + (header.masked ? 4 : 0);
+    if (data.size() < needed) {
+        return std::nullopt;
+    }
+
+    if (extendedSize > 0) {
+        header.payloadSize = 0;
+        for (size_t i = 0; i < extendedSize; ++i) {
+            header.payloadSize = (header.payloadSize << 8) | data[2 + i];
+        }
+    }
+
+    if (header.masked) {
+        std::memcpy(&header.maskingKey, data.data() + 2 + extendedSize, 4);
+    }
+
+    header.headerSize = needed;
+    return header;
+}
+
+size_t encodeFrameHeader(uint8_t* out, uint8_t opcode, uint64_t payloadSize, std::optional<uint32_t> maskingKey, bool fin, uint8_t rsv) {
+    size_t size = 0;
+    out[size++] = (fin ? 0x80 : 0x00) | ((rsv & 0x07) << 4) | (opcode & 0x0F);
+
+    uint8_t maskBit = maskingKey ? 0x80 : 0x00;
+
+    if (payloadSize < 126) {
+        out[size++] = maskBit | static_cast<uint8_t>(payloadSize);
+    } else if (payloadSize <= 0xFFFF) {
+        out[size++] = maskBit | 126;
+        out[size++] = static_cast<uint8_t>(payloadSize >> 8);
+        out[size++] = static_cast<uint8_t>(payloadSize);
+    } else {
+        out[size++] = maskBit | 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out[size++] = static_cast<uint8_t>(payloadSize >> shift);
+        }
+    }
+
+    if (maskingKey) {
+        std::memcpy(out + size, &*maskingKey, 4);
+        size += 4;
+    }
+
+    return size;
+}
+
+bool isValidCloseCode(uint16_t code) {
+    return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1014) || (code >= 3000 && code <= 4999);
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace ws {
+
+constexpr size_t MaxFrameHeaderSize = 14;
+// control frame payloads are capped at 125 bytes, two of which hold a close frame's code
+constexpr size_t MaxCloseReasonSize = 123;
+
+struct FrameHeader {
+    bool fin;
+    uint8_t rsv;
+    uint8_t opcode;
+    bool masked;
+    uint32_t maskingKey; // wire order, see Mask.hpp
+    uint64_t payloadSize;
+    size_t headerSize;
+};
+
+// Parses the frame header at the start of `data`.
+// Returns std::nullopt if `data` does not yet hold the whole header.
+std::optional<FrameHeader> parseFrameHeader(std::span<const uint8_t> data);
+
+// Writes a frame header into `out` (at least MaxFrameHeaderSize bytes) and returns its size.
+// A masking key is only written when `maskingKey` is set. `rsv` holds the 3 reserved bits (RSV1 = 0x4).
+size_t encodeFrameHeader(uint8_t* out, uint8_t opcode, uint64_t payloadSize, std::optional<uint32_t> maskingKey, bool fin = true, uint8_t rsv = 0);
+
+// whether a close frame may carry `code` (RFC 6455 section 7.4). 1005, 1006 and 1015 only stand for
+// "no code" and the like locally, and the rest below 3000 that is not listed is unassigned
+bool isValidCloseCode(uint16_t code);
+
+}
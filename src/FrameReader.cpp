@@ -0,0 +1,347 @@
+#include "FrameReader.hpp"
+#include "Mask.hpp"
+
+#include <algorithm>
+
+namespace ws {
+
+static bool isControl(uint8_t opcode) {
+    return opcode & 0x8;
+}
+
+static FrameEvent protocolError(uint16_t code, std::string_view reason) {
+    return FrameEvent{
+        .type = FrameEvent::Type::Error,
+        .opcode = Opcode::Close,
+        .closeCode = code,
+        .reason = reason
+    };
+}
+
+static FrameEvent invalidText() {
+    return protocolError(1007, "invalid UTF-8 in a text message");
+}
+
+static FrameEvent inflateError(InflateError error) {
+    if (error == InflateError::TooBig) {
+        return protocolError(1009, "message too big");
+    }
+
+    return protocolError(1007, "invalid compressed data");
+}
+
+void FrameReader::reset() {
+    readBuffer.clear();
+    messageBuffer.clear();
+    deflate = nullptr;
+
+    frame.reset();
+    frameRead = 0;
+    messageOpcode.reset();
+    messageSize = 0;
+    messageCompressed = false;
+    pendingConsume = 0;
+
+    utf8.reset();
+    checkingText = false;
+
+    inflating = false;
+    inflateLast = false;
+    inflateInputSize = 0;
+    inflateOpcode = Opcode::Continuation;
+    inflateOutput.clear();
+}
+
+std::optional<FrameEvent> FrameReader::validate(const FrameHeader& header) {
+    // RSV1 marks a compressed message, and is only allowed on its first frame
+    uint8_t allowedRsv = deflate && header.opcode != 0 && !isControl(header.opcode) ? 0x4 : 0;
+    if (header.rsv & ~allowedRsv) {
+        return protocolError(1002, "reserved bits set");
+    }
+
+    if (requireMasked && !header.masked) {
+        return protocolError(1002, "unmasked frame from a client");
+    }
+
+    switch (static_cast<Opcode>(header.opcode)) {
+        case Opcode::Continuation:
+            if (!messageOpcode) {
+                return protocolError(1002, "continuation frame without a message");
+            }
+            break;
+
+        case Opcode::Text:
+        case Opcode::Binary:
+            if (messageOpcode) {
+                return protocolError(1002, "new message before the previous one finished");
+            }
+            break;
+
+        case Opcode::Close:
+        case Opcode::Ping:
+        case Opcode::Pong:
+            if (!header.fin || header.payloadSize > 125) {
+                return protocolError(1002, "invalid control frame");
+            }
+            return std::nullopt;
+
+        default:
+            return protocolError(1002, "unknown opcode");
+    }
+
+    // compressed messages are checked again after inflating
+    if (!streaming) {
+        uint64_t total = (header.opcode == 0 ? messageSize : 0) + header.payloadSize;
+        if (total > maxMessageSize) {
+            return protocolError(1009, "message too big");
+        }
+    }
+
+    return std::nullopt;
+}
+
+FrameEvent FrameReader::completeMessage(Opcode opcode, std::span<uint8_t> payload, bool compressed) {
+    if (compressed) {
+        auto res = deflate->decompress(payload, maxMessageSize);
+        if (res.isErr()) {
+            return inflateError(res.unwrapErr());
+        }
+
+        payload = res.unwrap();
+
+        // inflated all at once, so it is checked all at once
+        if (opcode == Opcode::Text && !isValidUtf8(payload)) {
+            return invalidText();
+        }
+    }
+
+    return FrameEvent{
+        .type = FrameEvent::Type::Message,
+        .opcode = opcode,
+        .payload = payload
+    };
+}
+
+std::optional<FrameEvent> FrameReader::drainInflate() {
+    constexpr size_t OutputChunk = 16 * 1024;
+    if (inflateOutput.size() < OutputChunk) {
+        inflateOutput.resize(OutputChunk);
+    }
+
+    auto res = deflate->inflateSome(inflateOutput);
+    if (res.isErr()) {
+        inflating = false;
+        return inflateError(res.unwrapErr());
+    }
+
+    auto step = res.unwrap();
+    if (!step.inputDone && step.produced == 0) {
+        // no progress with input left and room to write
+        inflating = false;
+        return inflateError(InflateError::Corrupt);
+    }
+
+    if (inflateOpcode == Opcode::Text && !utf8.feed(std::span{inflateOutput}.first(step.produced))) {
+        inflating = false;
+        return invalidText();
+    }
+
+    if (step.inputDone) {
+        // zlib is done with the compressed bytes, release them on the next call
+        inflating = false;
+        pendingConsume = inflateInputSize;
+    }
+
+    bool last = step.inputDone && inflateLast;
+    if (last && inflateOpcode == Opcode::Text && !utf8.complete()) {
+        return invalidText();
+    }
+
+    if (step.produced == 0 && !last) {
+        return std::nullopt;
+    }
+
+    return FrameEvent{
+        .type = FrameEvent::Type::Fragment,
+        .opcode = inflateOpcode,
+        .payload = std::span{inflateOutput}.first(step.produced),
+        .last = last
+    };
+}
+
+bool FrameReader::unmaskChunk(std::span<uint8_t> chunk, uint64_t offset, bool text) {
+    if (text) {
+        return frame->masked
+            ? utf8.feedMasked(chunk, frame->maskingKey, static_cast<size_t>(offset))
+            : utf8.feed(chunk);
+    }
+
+    if (frame->masked) {
+        applyMask(chunk.data(), chunk.size(), frame->maskingKey, static_cast<size_t>(offset));
+    }
+
+    return true;
+}
+
+std::optional<FrameEvent> FrameReader::next() {
+    // zlib still points into the read buffer here, so nothing may be consumed until it is done
+    if (inflating) {
+        if (auto event = this->drainInflate()) {
+            return event;
+        }
+    }
+
+    readBuffer.consume(pendingConsume);
+    pendingConsume = 0;
+
+    while (true) {
+        if (!frame) {
+            auto header = parseFrameHeader(readBuffer.data());
+            if (!header) {
+                readBuffer.reserve(MaxFrameHeaderSize);
+                return std::nullopt;
+            }
+
+            if (metrics) {
+                metrics->countFrameIn(header->opcode, header->payloadSize);
+            }
+
+            if (auto error = this->validate(*header)) {
+                return error;
+            }
+
+            readBuffer.consume(header->headerSize);
+            frame = header;
+            frameRead = 0;
+
+            if (!isControl(header->opcode) && header->opcode != 0) {
+                messageOpcode = static_cast<Opcode>(header->opcode);
+                messageSize = 0;
+                messageCompressed = header->rsv & 0x4;
+                messageBuffer.clear();
+
+                checkingText = messageOpcode == Opcode::Text;
+                utf8.reset();
+
+                if (messageCompressed) {
+                    deflate->beginMessage();
+                }
+            }
+        }
+
+        size_t payloadSize = static_cast<size_t>(frame->payloadSize);
+
+        // control frames and unfragmented messages are handed out straight from the read buffer
+        bool control = isControl(frame->opcode);
+        if (control || (!streaming && frame->fin && frame->opcode != 0)) {
+            if (readBuffer.size() < payloadSize) {
+                readBuffer.reserve(payloadSize);
+                return std::nullopt;
+            }
+
+            auto payload = readBuffer.data().first(payloadSize);
+            auto opcode = static_cast<Opcode>(frame->opcode);
+            bool compressed = !control && messageCompressed;
+            bool text = !control && checkingText && !compressed;
+
+            if (!this->unmaskChunk(payload, 0, text) || (text && !utf8.complete())) {
+                return invalidText();
+            }
+
+            // the reason after the close code is text as well
+            if (opcode == Opcode::Close && payload.size() > 2 && !isValidUtf8(payload.subspan(2))) {
+                return protocolError(1007, "invalid UTF-8 in a close reason");
+            }
+
+            pendingConsume = payloadSize;
+            frame.reset();
+            if (!control) {
+                messageOpcode.reset();
+            }
+
+            return this->completeMessage(opcode, payload, compressed);
+        }
+
+        // everything else is taken in whatever pieces have arrived
+        size_t available = static_cast<size_t>(std::min<uint64_t>(readBuffer.size(), payloadSize - frameRead));
+        auto chunk = readBuffer.data().first(available);
+        bool text = checkingText && !messageCompressed;
+
+        if (!this->unmaskChunk(chunk, frameRead, text)) {
+            return invalidText();
+        }
+
+        frameRead += available;
+        messageSize += available;
+
+        bool frameDone = frameRead == payloadSize;
+        bool last = frameDone && frame->fin;
+        auto opcode = *messageOpcode;
+
+        if (frameDone) {
+            frame.reset();
+        }
+
+        if (last) {
+            messageOpcode.reset();
+
+            if (text && !utf8.complete()) {
+                return invalidText();
+            }
+        }
+
+        if (streaming && messageCompressed) {
+            if (available == 0 && !last) {
+                if (frameDone) {
+                    continue;
+                }
+                return std::nullopt;
+            }
+
+            // the compressed chunk stays in the read buffer until zlib has consumed all of it
+            deflate->setInput(chunk, last);
+            inflating = true;
+            inflateLast = last;
+            inflateInputSize = available;
+            inflateOpcode = opcode;
+
+            if (auto event = this->drainInflate()) {
+                return event;
+            }
+
+            readBuffer.consume(pendingConsume);
+            pendingConsume = 0;
+            continue;
+        }
+
+        if (streaming) {
+            if (available == 0 && !last) {
+                if (frameDone) {
+                    continue;
+                }
+                return std::nullopt;
+            }
+
+            pendingConsume = available;
+            return FrameEvent{
+                .type = FrameEvent::Type::Fragment,
+                .opcode = opcode,
+                .payload = chunk,
+                .last = last
+            };
+        }
+
+        messageBuffer.insert(messageBuffer.end(), chunk.begin(), chunk.end());
+        readBuffer.consume(available);
+
+        if (last) {
+            return this->completeMessage(opcode, messageBuffer, messageCompressed);
+        }
+
+        if (!frameDone) {
+            return std::nullopt;
+        }
+    }
+}
+
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <miniws.hpp>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "Frame.hpp"
+#include "ReadBuffer.hpp"
+#include "Deflate.hpp"
+#include "ConnectionMetrics.hpp"
+#include "Utf8.hpp"
+
+namespace ws {
+
+struct FrameEvent {
+    enum class Type {
+        // a whole message, or a whole control frame
+        Message,
+        // a piece of a data message, only produced in streaming mode
+        Fragment,
+        // the peer broke the protocol; the connection should be closed with `closeCode`
+        Error
+    };
+
+    Type type;
+    Opcode opcode; // for fragments, the opcode of the message they belong to
+    std::span<uint8_t> payload = {};
+    bool last = true;
+    uint16_t closeCode = 0;
+    std::string_view reason = {};
+};
+
+// Turns buffered bytes into messages, handling fragmentation and unmasking. Text messages and close
+// reasons that are not valid UTF-8 fail the connection with 1007; uncompressed text is checked while
+// it is unmasked, a piece at a time, so invalid text is caught before the rest of it arrives.
+// Events are pulled with next(); the payload of an event stays valid until the following call.
+class FrameReader {
+public:
+    static constexpr size_t DefaultMaxMessageSize = 64 * 1024 * 1024;
+
+    // the read buffer and reassembled messages are allocated from `memory`
+    explicit FrameReader(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : readBuffer(ReadBuffer::DefaultCapacity, memory), messageBuffer(memory), inflateOutput(memory) {}
+
+    // upper bound for a reassembled message, ignored in streaming mode
+    size_t maxMessageSize = DefaultMaxMessageSize;
+
+    // deliver data messages as Fragment events as bytes arrive instead of reassembling them,
+    // which keeps memory use at the read buffer size no matter how large a message is
+    bool streaming = false;
+
+    // the server side: clients must mask every frame (RFC 6455 section 5.1), unmasked ones are a protocol error
+    bool requireMasked = false;
+
+    // set once permessage-deflate was negotiated; messages with RSV1 are inflated before delivery
+    PerMessageDeflate* deflate = nullptr;
+
+    // counts every frame header parsed, when set
+    ConnectionMetrics* metrics = nullptr;
+
+    geode::Result<size_t> fill(BaseTransport& transport) {
+        return readBuffer.fill(transport);
+    }
+
+    geode::Result<std::optional<size_t>> tryFill(BaseTransport& transport, size_t maxBytes = SIZE_MAX) {
+        return readBuffer.tryFill(transport, maxBytes);
+    }
+
+    // hands over bytes that arrived together with the handshake response
+    void feed(std::span<const uint8_t> bytes) {
+        readBuffer.append(bytes);
+    }
+
+    std::optional<FrameEvent> next();
+
+    // forgets unread bytes and any frame or message in progress, for a new connection. The buffers keep their
+    // capacity, the settings above stay except `deflate`, which the new connection negotiates afresh
+    void reset();
+
+    // bytes read but not yet handed out: the read buffer and a message being reassembled
+    size_t buffered() const {
+        return readBuffer.size() + messageBuffer.size();
+    }
+
+private:
+    ReadBuffer readBuffer;
+    std::pmr::vector<uint8_t> messageBuffer;
+
+    std::optional<FrameHeader> frame;
+    uint64_t frameRead = 0;
+
+    // set while a data message is in progress
+    std::optional<Opcode> messageOpcode;
+    uint64_t messageSize = 0;
+    bool messageCompressed = false;
+
+    size_t pendingConsume = 0;
+
+    // follows the current text message, as it arrives or, for compressed ones, as it is inflated
+    Utf8Validator utf8;
+    bool checkingText = false;
+
+    // streaming decompression of the chunk currently sitting at the front of the read buffer
+    bool inflating = false;
+    bool inflateLast = false;
+    size_t inflateInputSize = 0;
+    Opcode inflateOpcode = Opcode::Continuation;
+    std::pmr::vector<uint8_t> inflateOutput;
+
+    std::optional<FrameEvent> validate(const FrameHeader& header);
+    FrameEvent completeMessage(Opcode opcode, std::span<uint8_t> payload, bool compressed);
+    std::optional<FrameEvent> drainInflate();
+    // unmasks a piece of the current frame, checking it on the same pass if it is uncompressed text
+    bool unmaskChunk(std::span<uint8_t> chunk, uint64_t offset, bool text);
+};
+
+}
@@ -0,0 +1,186 @@
+#include "Handshake.hpp"
+#include "Random.hpp"
+
+#include <algorithm>
+#include <base64.hpp>
+#include <cctype>
+#include <charconv>
+#include <fmt/format.h>
+
+#include <wolfssl/options.h>
+#include <wolfssl/wolfcrypt/sha.h>
+
+namespace ws {
+
+static std::string_view trimSpaces(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) str.remove_prefix(1);
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) str.remove_suffix(1);
+    return str;
+}
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+std::string generateHandshakeKey() {
+    uint8_t bytes[16];
+    fillRandom(bytes, sizeof(bytes));
+
+    return base64_encode({reinterpret_cast<const char*>(bytes), sizeof(bytes)});
+}
+
+std::string expectedAcceptKey(std::string_view key) {
+    static constexpr std::string_view Guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+    std::string input;
+    input.reserve(key.size() + Guid.size());
+    input.append(key);
+    input.append(Guid);
+
+    byte digest[WC_SHA_DIGEST_SIZE];
+    wc_ShaHash(reinterpret_cast<const byte*>(input.data()), static_cast<word32>(input.size()), digest);
+
+    return base64_encode({reinterpret_cast<const char*>(digest), sizeof(digest)});
+}
+
+HttpHeaderParser::State HttpHeaderParser::feed(std::span<const uint8_t> bytes) {
+    if (currentState != State::Incomplete) {
+        return currentState;
+    }
+
+    buffer.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+    // the terminator may straddle two reads, so back up a little
+    size_t from = scanned >= 3 ? scanned - 3 : 0;
+    size_t end = std::string_view(buffer).find("\r\n\r\n", from);
+
+    if (end == std::string_view::npos) {
+        scanned = buffer.size();
+
+        if (buffer.size() > maxSize) {
+            return setError("handshake too large");
+        }
+
+        return currentState;
+    }
+
+    headerSize = end + 4;
+    if (headerSize > maxSize) {
+        return setError("handshake too large");
+    }
+
+    return currentState = this->parse();
+}
+
+HttpHeaderParser::State HttpHeaderParser::parse() {
+    std::string_view block(buffer.data(), headerSize - 2);
+
+    size_t lineEnd = block.find("\r\n");
+    std::string_view startLine = block.substr(0, lineEnd);
+
+    if (!this->parseStartLine(startLine)) {
+        return setError(fmt::format("malformed start line: {}", startLine));
+    }
+
+    size_t pos = lineEnd + 2;
+    while (pos < block.size()) {
+        size_t next = block.find("\r\n", pos);
+        std::string_view line = block.substr(pos, next == std::string_view::npos ? std::string_view::npos : next - pos);
+        pos = next == std::string_view::npos ? block.size() : next + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0 || line.front() == ' ' || line.front() == '\t') {
+            return setError(fmt::format("malformed header line: {}", line));
+        }
+
+        headers.emplace_back(line.substr(0, colon), trimSpaces(line.substr(colon + 1)));
+    }
+
+    return State::Complete;
+}
+
+HttpHeaderParser::State HttpHeaderParser::setError(std::string message) {
+    errorMessage = std::move(message);
+    return currentState = State::Error;
+}
+
+void HttpHeaderParser::reset() {
+    currentState = State::Incomplete;
+    buffer.clear();
+    scanned = 0;
+    headerSize = 0;
+    headers.clear();
+    errorMessage.clear();
+}
+
+std::optional<std::string_view> HttpHeaderParser::header(std::string_view name) const {
+    for (auto& [key, value] : headers) {
+        if (equalsIgnoreCase(key, name)) {
+            return value;
+        }
+    }
+
+    return std::nullopt;
+}
+
+bool HttpHeaderParser::headerHasToken(std::string_view name, std::string_view token) const {
+    for (auto& [key, value] : headers) {
+        if (!equalsIgnoreCase(key, name)) {
+            continue;
+        }
+
+        std::string_view rest = value;
+        while (!rest.empty()) {
+            size_t comma = rest.find(',');
+            if (equalsIgnoreCase(trimSpaces(rest.substr(0, comma)), token)) {
+                return true;
+            }
+
+            rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+        }
+    }
+
+    return false;
+}
+
+std::span<const uint8_t> HttpHeaderParser::leftover() const {
+    if (currentState != State::Complete) {
+        return {};
+    }
+
+    return {reinterpret_cast<const uint8_t*>(buffer.data()) + headerSize, buffer.size() - headerSize};
+}
+
+bool HttpResponseParser::parseStartLine(std::string_view line) {
+    // HTTP/1.1 101 Switching Protocols
+    if (!line.starts_with("HTTP/1.1 ") || line.size() < 12) {
+        return false;
+    }
+
+    auto codeText = line.substr(9, 3);
+    auto [ptr, ec] = std::from_chars(codeText.data(), codeText.data() + codeText.size(), statusCode);
+    if (ec != std::errc() || ptr != codeText.data() + codeText.size()) {
+        return false;
+    }
+
+    statusReason = trimSpaces(line.substr(12));
+    return true;
+}
+
+bool HttpRequestParser::parseStartLine(std::string_view line) {
+    // GET /chat HTTP/1.1
+    size_t methodEnd = line.find(' ');
+    size_t targetEnd = methodEnd == std::string_view::npos ? methodEnd : line.find(' ', methodEnd + 1);
+
+    if (methodEnd == 0 || targetEnd == std::string_view::npos || targetEnd == methodEnd + 1 || line.substr(targetEnd + 1) != "HTTP/1.1") {
+        return false;
+    }
+
+    requestMethod = line.substr(0, methodEnd);
+    requestTarget = line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    return true;
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ws {
+
+// random Sec-WebSocket-Key for an upgrade request
+std::string generateHandshakeKey();
+
+// the Sec-WebSocket-Accept value a server must answer `key` with (RFC 6455 section 4.2.2)
+std::string expectedAcceptKey(std::string_view key);
+
+// Collects an HTTP/1.1 header block as it arrives, in however many pieces.
+// Only the start line and headers are consumed; whatever follows the blank line is the start
+// of the WebSocket stream and is left for the frame parser. Subclasses interpret the start line.
+class HttpHeaderParser {
+public:
+    enum class State {
+        Incomplete,
+        Complete,
+        Error
+    };
+
+    explicit HttpHeaderParser(size_t maxSize) : maxSize(maxSize) {}
+    virtual ~HttpHeaderParser() = default;
+
+    State feed(std::span<const uint8_t> bytes);
+    void reset();
+
+    State state() const {
+        return currentState;
+    }
+
+    // first header with this name, compared case-insensitively
+    std::optional<std::string_view> header(std::string_view name) const;
+
+    // whether a comma separated header (like Connection) lists `token`
+    bool headerHasToken(std::string_view name, std::string_view token) const;
+
+    // bytes that came after the header block
+    std::span<const uint8_t> leftover() const;
+
+    // set when the state is Error
+    std::string_view error() const {
+        return errorMessage;
+    }
+
+protected:
+    // returns false if the line is malformed. `line` points into the buffer and stays valid
+    virtual bool parseStartLine(std::string_view line) = 0;
+
+private:
+    size_t maxSize;
+
+    State currentState = State::Incomplete;
+    std::string buffer;
+    // how far the search for the end of the headers got, so every feed only scans new bytes
+    size_t scanned = 0;
+    size_t headerSize = 0;
+
+    // views into buffer, which is not touched again once the headers are complete
+    std::vector<std::pair<std::string_view, std::string_view>> headers;
+
+    std::string errorMessage;
+
+    State parse();
+    State setError(std::string message);
+};
+
+// The server's answer to the upgrade request
+class HttpResponseParser : public HttpHeaderParser {
+public:
+    using HttpHeaderParser::HttpHeaderParser;
+
+    // valid once Complete
+    int status() const {
+        return statusCode;
+    }
+
+    std::string_view reason() const {
+        return statusReason;
+    }
+
+protected:
+    bool parseStartLine(std::string_view line) override;
+
+private:
+    int statusCode = 0;
+    std::string_view statusReason;
+};
+
+// An upgrade request, on the server side
+class HttpRequestParser : public HttpHeaderParser {
+public:
+    using HttpHeaderParser::HttpHeaderParser;
+
+    // valid once Complete
+    std::string_view method() const {
+        return requestMethod;
+    }
+
+    std::string_view target() const {
+        return requestTarget;
+    }
+
+protected:
+    bool parseStartLine(std::string_view line) override;
+
+private:
+    std::string_view requestMethod;
+    std::string_view requestTarget;
+};
+
+}
@@ -0,0 +1,195 @@
+#include "HappyEyeballs.hpp"
+#include "SocketUtil.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <vector>
+
+#ifdef _WIN32
+# include <ws2tcpip.h>
+#else
+# include <netinet/in.h>
+#endif
+
+using namespace geode;
+
+namespace ws {
+
+#ifdef _WIN32
+static bool isConnectInProgress(int code) {
+    return code == WSAEWOULDBLOCK;
+}
+#else
+static bool isConnectInProgress(int code) {
+    return code == EINPROGRESS;
+}
+#endif
+
+static bool isIpv6(const std::string& address) {
+    return address.find(':') != std::string::npos;
+}
+
+// alternates families starting with whichever the resolver preferred, so a broken
+// IPv6 (or IPv4) path costs at most one attempt delay
+static std::vector<std::string> interleaveFamilies(std::span<const std::string> addresses) {
+    std::vector<std::string> first, second;
+    bool firstIs6 = isIpv6(addresses.front());
+
+    for (auto& address : addresses) {
+        (isIpv6(address) == firstIs6 ? first : second).push_back(address);
+    }
+
+    std::vector<std::string> ordered;
+    for (size_t i = 0; i < std::max(first.size(), second.size()); ++i) {
+        if (i < first.size()) ordered.push_back(std::move(first[i]));
+        if (i < second.size()) ordered.push_back(std::move(second[i]));
+    }
+
+    return ordered;
+}
+
+static bool makeSockaddr(const std::string& address, uint16_t port, sockaddr_storage& storage, socklen_t& length) {
+    std::memset(&storage, 0, sizeof(storage));
+
+    auto v4 = reinterpret_cast<sockaddr_in*>(&storage);
+    if (inet_pton(AF_INET, address.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        length = sizeof(sockaddr_in);
+        return true;
+    }
+
+    auto v6 = reinterpret_cast<sockaddr_in6*>(&storage);
+    if (inet_pton(AF_INET6, address.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        length = sizeof(sockaddr_in6);
+        return true;
+    }
+
+    return false;
+}
+
+static int pendingSocketError(qsox::SockFd fd) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) != 0) {
+        return lastSocketErrorCode();
+    }
+
+    return error;
+}
+
+Result<qsox::SockFd> happyEyeballsConnect(std::span<const std::string> addresses, uint16_t port, const ConnectOptions& options) {
+    using Clock = std::chrono::steady_clock;
+
+    if (addresses.empty()) {
+        return Err("no addresses to connect to");
+    }
+
+    auto ordered = interleaveFamilies(addresses);
+
+    std::vector<pollfd> attempts;
+    std::string lastError = "connection failed";
+
+    auto closeAttempts = [&](qsox::SockFd keep) {
+        for (auto& attempt : attempts) {
+            if (attempt.fd != keep) {
+                closeSocket(attempt.fd);
+            }
+        }
+    };
+
+    auto deadline = Clock::now() + options.timeout;
+    auto nextStart = Clock::now();
+    size_t next = 0;
+
+    while (true) {
+        auto now = Clock::now();
+
+        if (next < ordered.size() && (now >= nextStart || attempts.empty())) {
+            const auto& address = ordered[next++];
+            nextStart = now + options.attemptDelay;
+
+            sockaddr_storage storage;
+            socklen_t length;
+            if (!makeSockaddr(address, port, storage, length)) {
+                lastError = "invalid address " + address;
+                continue;
+            }
+
+            qsox::SockFd fd = ::socket(storage.ss_family, SOCK_STREAM, IPPROTO_TCP);
+            if (fd == qsox::BaseSocket::InvalidSockFd) {
+                lastError = lastSocketError();
+                continue;
+            }
+
+            setSocketNonBlocking(fd, true);
+
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&storage), length) == 0) {
+                closeAttempts(fd);
+                setSocketNonBlocking(fd, false);
+                return Ok(fd);
+            }
+
+            int code = lastSocketErrorCode();
+            if (!isConnectInProgress(code)) {
+                lastError = fmt::format("{}: {}", address, socketErrorMessage(code));
+                closeSocket(fd);
+                continue;
+            }
+
+            attempts.push_back({fd, POLLOUT, 0});
+            continue;
+        }
+
+        if (attempts.empty()) {
+            return Err(lastError);
+        }
+
+        if (now >= deadline) {
+            closeAttempts(qsox::BaseSocket::InvalidSockFd);
+            return Err("connection timed out");
+        }
+
+        auto wakeAt = next < ordered.size() ? std::min(nextStart, deadline) : deadline;
+        auto waitMs = std::chrono::ceil<std::chrono::milliseconds>(wakeAt - now).count();
+
+        if (pollSockets(attempts.data(), attempts.size(), static_cast<int>(waitMs)) < 0) {
+            // a signal cut the wait short; the next pass waits out whatever is left of it
+            if (lastSocketErrorCode() == EINTR) {
+                continue;
+            }
+
+            lastError = lastSocketError();
+            closeAttempts(qsox::BaseSocket::InvalidSockFd);
+            return Err(lastError);
+        }
+
+        for (size_t i = 0; i < attempts.size();) {
+            if (attempts[i].revents == 0) {
+                ++i;
+                continue;
+            }
+
+            qsox::SockFd fd = attempts[i].fd;
+            int error = pendingSocketError(fd);
+
+            if (error == 0) {
+                closeAttempts(fd);
+                setSocketNonBlocking(fd, false);
+                return Ok(fd);
+            }
+
+            lastError = socketErrorMessage(error);
+            closeSocket(fd);
+            attempts.erase(attempts.begin() + i);
+
+            // a refused attempt does not need to hold up the next one
+            nextStart = Clock::now();
+        }
+    }
+}
+
+}
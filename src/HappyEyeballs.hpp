@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Geode/Result.hpp>
+#include <miniws.hpp>
+#include <qsox/BaseSocket.hpp>
+#include <span>
+#include <string>
+
+namespace ws {
+
+// Races TCP connections to `addresses` (RFC 8305): attempts start `attemptDelay` apart, alternating
+// between IPv6 and IPv4, a failed attempt starts the next one right away, and the first socket to
+// connect wins while the rest are closed. Returns the connected socket in blocking mode.
+geode::Result<qsox::SockFd> happyEyeballsConnect(std::span<const std::string> addresses, uint16_t port, const ConnectOptions& options = {});
+
+}
@@ -0,0 +1,198 @@
+#include "IoUring.hpp"
+
+#if MINIWS_IO_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fmt/format.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace geode;
+
+namespace ws {
+
+static void* mapRing(int fd, size_t size, off_t offset) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    return memory == MAP_FAILED ? nullptr : memory;
+}
+
+Result<std::unique_ptr<IoUring>> IoUring::create(unsigned entries) {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 2;
+
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+        return Err(fmt::format("io_uring_setup failed: {}", std::strerror(errno)));
+    }
+
+    auto ring = std::unique_ptr<IoUring>(new IoUring());
+    ring->ringFd = fd;
+
+    // a single mapping for both rings (5.4) and deadlines on waits (5.11)
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        return Err("io_uring is too old, needs Linux 5.11 or newer");
+    }
+
+    ring->sqRingSize = std::max(
+        params.sq_off.array + params.sq_entries * sizeof(unsigned),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe)
+    );
+    ring->sqRing = mapRing(fd, ring->sqRingSize, IORING_OFF_SQ_RING);
+    if (!ring->sqRing) {
+        return Err(fmt::format("unable to map io_uring: {}", std::strerror(errno)));
+    }
+
+    // the completion ring shares the mapping, see IORING_FEAT_SINGLE_MMAP
+    ring->cqRing = ring->sqRing;
+
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe*>(mapRing(fd, ring->sqesSize, IORING_OFF_SQES));
+    if (!ring->sqes) {
+        return Err(fmt::format("unable to map io_uring: {}", std::strerror(errno)));
+    }
+
+    auto sq = static_cast<uint8_t*>(ring->sqRing);
+    ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sqEntries = params.sq_entries;
+    ring->sqLocalTail = *ring->sqTail;
+
+    // slots are used in order, so the indirection array is the identity
+    auto array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; ++i) {
+        array[i] = i;
+    }
+
+    auto cq = static_cast<uint8_t*>(ring->cqRing);
+    ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    return Ok(std::move(ring));
+}
+
+IoUring::~IoUring() {
+    if (bufferRing) {
+        io_uring_buf_reg reg{};
+        reg.bgid = 0;
+        syscall(__NR_io_uring_register, ringFd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(bufferRing, bufferRingSize);
+    }
+
+    if (bufferMemory) {
+        munmap(bufferMemory, bufferMemorySize);
+    }
+
+    if (sqes) {
+        munmap(sqes, sqesSize);
+    }
+
+    if (sqRing) {
+        munmap(sqRing, sqRingSize);
+    }
+
+    if (ringFd >= 0) {
+        close(ringFd);
+    }
+}
+
+io_uring_sqe* IoUring::nextSqe() {
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqLocalTail - head >= sqEntries) {
+        return nullptr;
+    }
+
+    io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sqLocalTail;
+
+    return sqe;
+}
+
+void IoUring::publish() {
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+}
+
+int IoUring::enter(unsigned submit, unsigned waitFor, std::optional<std::chrono::steady_clock::time_point> deadline) {
+    unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    __kernel_timespec timeout{};
+    io_uring_getevents_arg arg{};
+    void* argp = nullptr;
+    size_t argSize = 0;
+
+    if (deadline && waitFor > 0) {
+        auto left = std::max(*deadline - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero());
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+
+        timeout.tv_sec = ns / 1'000'000'000;
+        timeout.tv_nsec = ns % 1'000'000'000;
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argSize = sizeof(arg);
+    }
+
+    int res = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, submit, waitFor, flags, argp, argSize));
+    return res < 0 ? -errno : res;
+}
+
+Result<> IoUring::provideBuffers(uint16_t group, unsigned count, uint32_t size) {
+    bufferRingSize = count * sizeof(io_uring_buf);
+    void* ringMemory = mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ringMemory == MAP_FAILED) {
+        return Err(fmt::format("unable to allocate the buffer ring: {}", std::strerror(errno)));
+    }
+
+    bufferRing = static_cast<io_uring_buf*>(ringMemory);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ringMemory);
+    reg.ring_entries = count;
+    reg.bgid = group;
+
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        munmap(ringMemory, bufferRingSize);
+        bufferRing = nullptr;
+        return Err(fmt::format("unable to register receive buffers (needs Linux 5.19): {}", std::strerror(errno)));
+    }
+
+    bufferMemorySize = static_cast<size_t>(count) * size;
+    void* memory = mmap(nullptr, bufferMemorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return Err(fmt::format("unable to allocate receive buffers: {}", std::strerror(errno)));
+    }
+
+    bufferMemory = static_cast<uint8_t*>(memory);
+    bufferCount = count;
+    bufferSize = size;
+
+    for (unsigned id = 0; id < count; ++id) {
+        this->recycleBuffer(static_cast<uint16_t>(id));
+    }
+
+    return Ok();
+}
+
+void IoUring::recycleBuffer(uint16_t id) {
+    io_uring_buf& slot = bufferRing[bufferRingTail & (bufferCount - 1)];
+    slot.addr = reinterpret_cast<uint64_t>(this->buffer(id));
+    slot.len = bufferSize;
+    slot.bid = id;
+    ++bufferRingTail;
+
+    // the ring's tail overlays the `resv` field of the first entry
+    auto tail = reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(bufferRing) + offsetof(io_uring_buf, resv));
+    __atomic_store_n(tail, bufferRingTail, __ATOMIC_RELEASE);
+}
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+#pragma once
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+# define MINIWS_IO_URING 1
+#else
+# define MINIWS_IO_URING 0
+#endif
+
+#if MINIWS_IO_URING
+
+#include <Geode/Result.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <linux/io_uring.h>
+
+namespace ws {
+
+// The few parts of liburing miniws needs, on the raw syscalls: setting up and mapping the rings,
+// filling submissions, reading completions and a ring of provided receive buffers.
+// Not thread safe; UringDriver serializes access.
+class IoUring {
+public:
+    static geode::Result<std::unique_ptr<IoUring>> create(unsigned entries);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // A zeroed submission slot, or nullptr when the queue is full. The kernel sees it after publish()
+    io_uring_sqe* nextSqe();
+    void publish();
+
+    // Submits up to `submit` published entries and waits for `waitFor` completions, or until `deadline`.
+    // Returns the raw result: entries submitted, or -errno (-ETIME when the deadline passed)
+    int enter(unsigned submit, unsigned waitFor, std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt);
+
+    // calls `handler` with every completion posted so far and returns how many there were
+    template <class F>
+    unsigned drain(F&& handler) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+        for (unsigned i = head; i != tail; ++i) {
+            handler(cqes[i & cqMask]);
+        }
+
+        __atomic_store_n(cqHead, tail, __ATOMIC_RELEASE);
+        return tail - head;
+    }
+
+    // Hands `count` buffers of `size` bytes each to the kernel as buffer group `group`, for receives
+    // with IOSQE_BUFFER_SELECT. `count` must be a power of two
+    geode::Result<> provideBuffers(uint16_t group, unsigned count, uint32_t size);
+
+    uint8_t* buffer(uint16_t id) {
+        return bufferMemory + static_cast<size_t>(id) * bufferSize;
+    }
+
+    // gives a buffer back to the kernel once its data has been copied out
+    void recycleBuffer(uint16_t id);
+
+private:
+    IoUring() = default;
+
+    int ringFd = -1;
+
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    // next free slot, ahead of *sqTail until publish()
+    unsigned sqLocalTail = 0;
+
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    io_uring_buf* bufferRing = nullptr;
+    size_t bufferRingSize = 0;
+    uint16_t bufferRingTail = 0;
+    unsigned bufferCount = 0;
+    uint8_t* bufferMemory = nullptr;
+    size_t bufferMemorySize = 0;
+    uint32_t bufferSize = 0;
+};
+
+// a receive that keeps posting completions, one per chunk of data, each in a buffer picked from `group`
+inline void prepareMultishotReceive(io_uring_sqe* sqe, int fd, uint16_t group) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+}
+
+inline void prepareSend(io_uring_sqe* sqe, int fd, const void* data, size_t size, int flags) {
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = static_cast<uint32_t>(size);
+    sqe->msg_flags = static_cast<uint32_t>(flags);
+}
+
+// cancels the operation submitted with `userData`
+inline void prepareCancel(io_uring_sqe* sqe, uint64_t userData) {
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = userData;
+}
+
+}
+
+#else
+
+namespace ws {
+
+// UringDriver::create always fails without io_uring
+class IoUring {};
+
+}
+
+#endif
@@ -0,0 +1,385 @@
+#include "KernelTls.hpp"
+#include "SocketUtil.hpp"
+
+#include <wolfssl/options.h>
+#include <wolfssl/ssl.h>
+#include <fmt/format.h>
+
+#if MINIWS_KERNEL_TLS
+# include <wolfssl/wolfcrypt/hmac.h>
+# include <algorithm>
+# include <cstring>
+# include <string>
+# include <linux/tls.h>
+# include <netinet/tcp.h>
+# include <sys/socket.h>
+# include <sys/uio.h>
+#endif
+
+using namespace geode;
+
+namespace ws {
+
+#if MINIWS_KERNEL_TLS && defined(HAVE_SECRET_CALLBACK)
+
+// TLS record content types (RFC 8446 section 5.1) and the handshake messages that can follow the handshake
+constexpr uint8_t AlertRecord = 21;
+constexpr uint8_t HandshakeRecord = 22;
+constexpr uint8_t ApplicationDataRecord = 23;
+constexpr uint8_t CloseNotifyAlert = 0;
+constexpr uint8_t KeyUpdateMessage = 24;
+
+constexpr size_t RecordHeaderSize = 5;
+constexpr size_t IvSize = 12;
+
+Result<std::unique_ptr<KernelTls>> KernelTls::capture(WOLFSSL* ssl, qsox::SockFd fd) {
+    auto kernel = std::unique_ptr<KernelTls>(new KernelTls(fd));
+
+    if (wolfSSL_set_tls13_secret_cb(ssl, &KernelTls::catchSecret, kernel.get()) != WOLFSSL_SUCCESS) {
+        return Err("unable to get the TLS secrets from wolfSSL");
+    }
+
+    wolfSSL_SSLSetIORecv(ssl, &KernelTls::receiveRecord);
+    wolfSSL_SetIOReadCtx(ssl, kernel.get());
+
+    return Ok(std::move(kernel));
+}
+
+KernelTls::~KernelTls() {
+    explicit_bzero(clientSecret.data(), clientSecret.size());
+    explicit_bzero(serverSecret.data(), serverSecret.size());
+}
+
+int KernelTls::catchSecret(WOLFSSL*, int id, const unsigned char* secret, int size, void* ctx) {
+    auto self = static_cast<KernelTls*>(ctx);
+
+    if (id == CLIENT_TRAFFIC_SECRET) {
+        self->clientSecret.assign(secret, secret + size);
+    } else if (id == SERVER_TRAFFIC_SECRET) {
+        self->serverSecret.assign(secret, secret + size);
+    }
+
+    return 0;
+}
+
+int KernelTls::receiveRecord(WOLFSSL*, char* buffer, int size, void* ctx) {
+    auto self = static_cast<KernelTls*>(ctx);
+    size_t want = static_cast<size_t>(size);
+
+    // a header is read on its own, and tells how much of the body may be read after it
+    if (self->bounded) {
+        want = std::min(want, self->recordLeft > 0 ? self->recordLeft : RecordHeaderSize - self->headerRead);
+    }
+
+    auto received = ::recv(self->fd, buffer, want, 0);
+
+    if (received == 0) {
+        return WOLFSSL_CBIO_ERR_CONN_CLOSE;
+    }
+
+    if (received < 0) {
+        switch (errno) {
+            case EAGAIN: return WOLFSSL_CBIO_ERR_WANT_READ;
+            case EINTR: return WOLFSSL_CBIO_ERR_ISR;
+            case ECONNRESET: return WOLFSSL_CBIO_ERR_CONN_RST;
+            default: return WOLFSSL_CBIO_ERR_GENERAL;
+        }
+    }
+
+    if (self->bounded) {
+        size_t count = static_cast<size_t>(received);
+
+        if (self->recordLeft > 0) {
+            self->recordLeft -= count;
+        } else {
+            std::memcpy(self->header + self->headerRead, buffer, count);
+            self->headerRead += count;
+
+            if (self->headerRead == RecordHeaderSize) {
+                self->recordLeft = (size_t(self->header[3]) << 8) | self->header[4];
+                self->headerRead = 0;
+            }
+        }
+    }
+
+    return static_cast<int>(received);
+}
+
+// HKDF-Expand-Label from RFC 8446 section 7.1, with an empty context
+static Result<> expandLabel(int hash, std::span<const uint8_t> secret, std::string_view label, std::span<uint8_t> out) {
+    std::string fullLabel = fmt::format("tls13 {}", label);
+
+    std::vector<uint8_t> info;
+    info.push_back(static_cast<uint8_t>(out.size() >> 8));
+    info.push_back(static_cast<uint8_t>(out.size()));
+    info.push_back(static_cast<uint8_t>(fullLabel.size()));
+    info.insert(info.end(), fullLabel.begin(), fullLabel.end());
+    info.push_back(0);
+
+    int res = wc_HKDF_Expand(
+        hash, secret.data(), static_cast<word32>(secret.size()),
+        info.data(), static_cast<word32>(info.size()),
+        out.data(), static_cast<word32>(out.size())
+    );
+
+    if (res != 0) {
+        return Err(fmt::format("unable to derive the {} for kernel TLS", label));
+    }
+
+    return Ok();
+}
+
+// the kernel's key layout for each TLS 1.3 cipher suite it can take
+union CryptoInfo {
+    tls_crypto_info base;
+    tls12_crypto_info_aes_gcm_128 aes128;
+    tls12_crypto_info_aes_gcm_256 aes256;
+    tls12_crypto_info_chacha20_poly1305 chacha;
+};
+
+// fills in the keys for one direction, record sequence numbers start at zero after the handshake
+static Result<size_t> cryptoInfo(uint16_t suite, std::span<const uint8_t> secret, CryptoInfo& info) {
+    uint8_t key[32];
+    uint8_t iv[IvSize];
+    size_t size = 0;
+    int hash = WC_SHA256;
+
+    std::memset(&info, 0, sizeof(info));
+    info.base.version = TLS_1_3_VERSION;
+
+    // the record nonce is the salt followed by the explicit iv for GCM, and all of the iv for ChaCha20
+    switch (suite) {
+        case 0x1301: // TLS_AES_128_GCM_SHA256
+            GEODE_UNWRAP(expandLabel(hash, secret, "key", {key, TLS_CIPHER_AES_GCM_128_KEY_SIZE}));
+            GEODE_UNWRAP(expandLabel(hash, secret, "iv", iv));
+            info.base.cipher_type = TLS_CIPHER_AES_GCM_128;
+            std::memcpy(info.aes128.key, key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+            std::memcpy(info.aes128.salt, iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+            std::memcpy(info.aes128.iv, iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE, TLS_CIPHER_AES_GCM_128_IV_SIZE);
+            size = sizeof(info.aes128);
+            break;
+
+        case 0x1302: // TLS_AES_256_GCM_SHA384
+            hash = WC_SHA384;
+            GEODE_UNWRAP(expandLabel(hash, secret, "key", {key, TLS_CIPHER_AES_GCM_256_KEY_SIZE}));
+            GEODE_UNWRAP(expandLabel(hash, secret, "iv", iv));
+            info.base.cipher_type = TLS_CIPHER_AES_GCM_256;
+            std::memcpy(info.aes256.key, key, TLS_CIPHER_AES_GCM_256_KEY_SIZE);
+            std::memcpy(info.aes256.salt, iv, TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+            std::memcpy(info.aes256.iv, iv + TLS_CIPHER_AES_GCM_256_SALT_SIZE, TLS_CIPHER_AES_GCM_256_IV_SIZE);
+            size = sizeof(info.aes256);
+            break;
+
+        case 0x1303: // TLS_CHACHA20_POLY1305_SHA256
+            GEODE_UNWRAP(expandLabel(hash, secret, "key", {key, TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE}));
+            GEODE_UNWRAP(expandLabel(hash, secret, "iv", iv));
+            info.base.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+            std::memcpy(info.chacha.key, key, TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE);
+            std::memcpy(info.chacha.iv, iv, TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE);
+            size = sizeof(info.chacha);
+            break;
+
+        default:
+            return Err(fmt::format("cipher suite {:#06x} is not supported by kernel TLS", suite));
+    }
+
+    explicit_bzero(key, sizeof(key));
+    explicit_bzero(iv, sizeof(iv));
+
+    return Ok(size);
+}
+
+Result<> KernelTls::install(WOLFSSL* ssl) {
+    // wolfSSL keeps reading normally from here on, whichever way this goes
+    bounded = false;
+
+    if (clientSecret.empty() || serverSecret.empty()) {
+        return Err("no TLS 1.3 traffic secrets, kernel TLS needs TLS 1.3");
+    }
+
+    // the handshake must not have left part of a record behind in wolfSSL
+    if (recordLeft > 0 || headerRead > 0 || wolfSSL_pending(ssl) > 0) {
+        return Err("data arrived with the handshake, staying in wolfSSL");
+    }
+
+    auto suite = static_cast<uint16_t>(wolfSSL_get_current_cipher_suite(ssl));
+
+    CryptoInfo receiveInfo, sendInfo;
+    GEODE_UNWRAP_INTO(size_t receiveSize, cryptoInfo(suite, serverSecret, receiveInfo));
+    GEODE_UNWRAP_INTO(size_t sendSize, cryptoInfo(suite, clientSecret, sendInfo));
+
+    explicit_bzero(clientSecret.data(), clientSecret.size());
+    explicit_bzero(serverSecret.data(), serverSecret.size());
+
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+        explicit_bzero(&receiveInfo, sizeof(receiveInfo));
+        explicit_bzero(&sendInfo, sizeof(sendInfo));
+        return Err(fmt::format("kernel TLS is unavailable: {}", lastSocketError()));
+    }
+
+    // the receive side first: if only it works, wolfSSL can still write records with its own keys,
+    // while the other way around it would answer the peer's messages on a sequence number the kernel owns
+    rx = setsockopt(fd, SOL_TLS, TLS_RX, &receiveInfo, static_cast<socklen_t>(receiveSize)) == 0;
+    if (rx) {
+        tx = setsockopt(fd, SOL_TLS, TLS_TX, &sendInfo, static_cast<socklen_t>(sendSize)) == 0;
+    }
+
+    explicit_bzero(&receiveInfo, sizeof(receiveInfo));
+    explicit_bzero(&sendInfo, sizeof(sendInfo));
+
+    if (!rx) {
+        return Err(fmt::format("kernel TLS does not take this cipher: {}", lastSocketError()));
+    }
+
+    return Ok();
+}
+
+Result<std::optional<size_t>> KernelTls::send(std::span<const ConstBuffer> buffers) {
+    size_t count = std::min(buffers.size(), MaxGatherBuffers);
+
+    iovec iov[MaxGatherBuffers];
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<void*>(buffers[i].data);
+        iov[i].iov_len = buffers[i].size;
+    }
+
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = count;
+
+    auto sent = ::sendmsg(fd, &message, SendFlags);
+    if (sent < 0) {
+        int code = lastSocketErrorCode();
+        if (isWouldBlock(code)) {
+            return Ok(std::nullopt);
+        }
+
+        return Err(socketErrorMessage(code));
+    }
+
+    return Ok(std::optional<size_t>{static_cast<size_t>(sent)});
+}
+
+Result<std::optional<size_t>> KernelTls::receive(void* buffer, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(buffer);
+
+    while (true) {
+        // without room for the record type the kernel refuses anything but application data
+        char control[CMSG_SPACE(sizeof(uint8_t))];
+        iovec iov{buffer, size};
+
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        auto received = ::recvmsg(fd, &message, 0);
+        if (received < 0) {
+            int code = lastSocketErrorCode();
+            if (isWouldBlock(code)) {
+                return Ok(std::nullopt);
+            }
+
+            if (code == EINTR) {
+                continue;
+            }
+
+            // EBADMSG: a record failed to decrypt
+            return Err(socketErrorMessage(code));
+        }
+
+        uint8_t type = ApplicationDataRecord;
+        for (auto cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level == SOL_TLS && cmsg->cmsg_type == TLS_GET_RECORD_TYPE) {
+                type = *CMSG_DATA(cmsg);
+            }
+        }
+
+        if (type == ApplicationDataRecord || received == 0) {
+            return Ok(std::optional<size_t>{static_cast<size_t>(received)});
+        }
+
+        if (type == AlertRecord) {
+            if (received >= 2 && bytes[1] == CloseNotifyAlert) {
+                return Ok(std::optional<size_t>{0});
+            }
+
+            return Err(fmt::format("server sent TLS alert {}", received >= 2 ? bytes[1] : 0));
+        }
+
+        if (type == HandshakeRecord && received >= 1 && bytes[0] == KeyUpdateMessage) {
+            return Err("server updated its TLS keys, which kernel TLS cannot follow");
+        }
+
+        // session tickets, which wolfSSL would have stored; this connection does without
+        if (type != HandshakeRecord) {
+            return Err(fmt::format("unexpected TLS record type {}", type));
+        }
+    }
+}
+
+Result<> KernelTls::sendCloseNotify() {
+    uint8_t alert[] = {1, CloseNotifyAlert};
+    iovec iov{alert, sizeof(alert)};
+
+    char control[CMSG_SPACE(sizeof(uint8_t))] = {};
+
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    auto cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint8_t));
+    *CMSG_DATA(cmsg) = AlertRecord;
+
+    if (::sendmsg(fd, &message, SendFlags) < 0) {
+        return Err(lastSocketError());
+    }
+
+    return Ok();
+}
+
+#else
+
+Result<std::unique_ptr<KernelTls>> KernelTls::capture(WOLFSSL*, qsox::SockFd) {
+# if MINIWS_KERNEL_TLS
+    return Err("kernel TLS needs wolfSSL built with HAVE_SECRET_CALLBACK");
+# else
+    return Err("kernel TLS is only available on Linux");
+# endif
+}
+
+KernelTls::~KernelTls() = default;
+
+int KernelTls::catchSecret(WOLFSSL*, int, const unsigned char*, int, void*) {
+    return 0;
+}
+
+int KernelTls::receiveRecord(WOLFSSL*, char*, int, void*) {
+    return -1;
+}
+
+Result<> KernelTls::install(WOLFSSL*) {
+    return Err("kernel TLS is unavailable");
+}
+
+Result<std::optional<size_t>> KernelTls::send(std::span<const ConstBuffer>) {
+    return Err("kernel TLS is unavailable");
+}
+
+Result<std::optional<size_t>> KernelTls::receive(void*, size_t) {
+    return Err("kernel TLS is unavailable");
+}
+
+Result<> KernelTls::sendCloseNotify() {
+    return Err("kernel TLS is unavailable");
+}
+
+#endif
+
+}
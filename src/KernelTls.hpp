@@ -0,0 +1,77 @@
+#pragma once
+
+#include <BaseTransport.hpp>
+#include <Geode/Result.hpp>
+#include <qsox/BaseSocket.hpp>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/tls.h>)
+# define MINIWS_KERNEL_TLS 1
+#else
+# define MINIWS_KERNEL_TLS 0
+#endif
+
+struct WOLFSSL;
+
+namespace ws {
+
+// Linux kernel TLS for a client connection. While wolfSSL does the handshake, its TLS 1.3 application
+// traffic secrets are caught and its reads are kept to one record at a time, so nothing past the handshake
+// is taken off the socket. install() then turns the secrets into record keys and gives them to the socket,
+// which from there on encrypts and decrypts by itself.
+class KernelTls {
+public:
+    // Starts catching the secrets of `ssl`, whose socket is `fd`; before the handshake. Fails where kTLS
+    // cannot work at all: not Linux, or wolfSSL built without HAVE_SECRET_CALLBACK.
+    // wolfSSL reads through the returned object for as long as `ssl` lives
+    static geode::Result<std::unique_ptr<KernelTls>> capture(WOLFSSL* ssl, qsox::SockFd fd);
+    ~KernelTls();
+
+    KernelTls(const KernelTls&) = delete;
+    KernelTls& operator=(const KernelTls&) = delete;
+
+    // After the handshake. Either direction can be taken over on its own; fails if neither was,
+    // leaving wolfSSL in charge of the connection
+    geode::Result<> install(WOLFSSL* ssl);
+
+    bool sending() const {
+        return tx;
+    }
+
+    bool receiving() const {
+        return rx;
+    }
+
+    // std::nullopt when a non-blocking socket would block
+    geode::Result<std::optional<size_t>> send(std::span<const ConstBuffer> buffers);
+    // Application data only: session tickets are skipped and close_notify reads as the end of the stream.
+    // A key update cannot be followed and fails the connection
+    geode::Result<std::optional<size_t>> receive(void* buffer, size_t size);
+    geode::Result<> sendCloseNotify();
+
+private:
+    explicit KernelTls(qsox::SockFd fd) : fd(fd) {}
+
+    qsox::SockFd fd;
+    std::vector<uint8_t> clientSecret;
+    std::vector<uint8_t> serverSecret;
+
+    // wolfSSL's reads stop at record boundaries until install()
+    bool bounded = true;
+    // the header of the next record as it comes in, then the bytes of its body wolfSSL has not read yet
+    uint8_t header[5];
+    size_t headerRead = 0;
+    size_t recordLeft = 0;
+
+    bool tx = false;
+    bool rx = false;
+
+    static int catchSecret(WOLFSSL* ssl, int id, const unsigned char* secret, int size, void* ctx);
+    static int receiveRecord(WOLFSSL* ssl, char* buffer, int size, void* ctx);
+};
+
+}
@@ -0,0 +1,105 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace ws {
+
+size_t LatencyHistogram::bucketIndex(uint64_t micros) {
+    // small values get a bucket each
+    if (micros < SubBuckets) {
+        return static_cast<size_t>(micros);
+    }
+
+    size_t power = std::min<size_t>(std::bit_width(micros) - 1, MaxPower - 1);
+    micros = std::min<uint64_t>(micros, (uint64_t(2) << power) - 1);
+
+    // the bits right below the leading one pick the bucket within the power
+    size_t sub = static_cast<size_t>(micros >> (power - SubBucketBits)) & (SubBuckets - 1);
+    return (power - SubBucketBits + 1) * SubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketValue(size_t index) {
+    if (index < SubBuckets) {
+        return index;
+    }
+
+    size_t power = index / SubBuckets + SubBucketBits - 1;
+    size_t sub = index % SubBuckets;
+    size_t shift = power - SubBucketBits;
+
+    uint64_t lower = (SubBuckets + sub) << shift;
+    return lower + ((uint64_t(1) << shift) >> 1);
+}
+
+void LatencyHistogram::record(std::chrono::microseconds sample) {
+    uint64_t micros = static_cast<uint64_t>(std::max<int64_t>(sample.count(), 0));
+
+    buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+    last.store(micros, std::memory_order_relaxed);
+
+    // only one thread records, so a plain compare is enough
+    if (micros > max.load(std::memory_order_relaxed)) {
+        max.store(micros, std::memory_order_relaxed);
+    }
+
+    count.fetch_add(1, std::memory_order_release);
+}
+
+LatencyStats LatencyHistogram::snapshot() const {
+    using std::chrono::microseconds;
+
+    LatencyStats stats;
+    uint64_t total = count.load(std::memory_order_acquire);
+    if (total == 0) {
+        return stats;
+    }
+
+    // buckets may move on while they are read, so percentiles are taken from the buckets'
+    // own total rather than from `count`
+    std::array<uint32_t, BucketCount> copy;
+    uint64_t bucketTotal = 0;
+    for (size_t i = 0; i < BucketCount; ++i) {
+        copy[i] = buckets[i].load(std::memory_order_relaxed);
+        bucketTotal += copy[i];
+    }
+
+    uint64_t maxValue = max.load(std::memory_order_relaxed);
+
+    auto percentile = [&](double p) {
+        uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(bucketTotal - 1));
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < BucketCount; ++i) {
+            seen += copy[i];
+            if (seen > rank) {
+                return microseconds(std::min(bucketValue(i), maxValue));
+            }
+        }
+
+        return microseconds(maxValue);
+    };
+
+    stats.samples = static_cast<size_t>(total);
+    stats.last = microseconds(last.load(std::memory_order_relaxed));
+    stats.max = microseconds(maxValue);
+
+    if (bucketTotal > 0) {
+        stats.p50 = percentile(0.50);
+        stats.p99 = percentile(0.99);
+    }
+
+    return stats;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    last.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <miniws.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace ws {
+
+// Log-linear histogram of durations: every power of two microseconds is split into 8 buckets,
+// so a reported percentile is within 1/16 of the true value. record() may run on one thread
+// while snapshot() runs on others, neither takes a lock.
+class LatencyHistogram {
+public:
+    void record(std::chrono::microseconds sample);
+    LatencyStats snapshot() const;
+    void reset();
+
+private:
+    static constexpr size_t SubBucketBits = 3;
+    static constexpr size_t SubBuckets = 1 << SubBucketBits;
+    // anything past 2^40 us (about 12 days) lands in the last bucket
+    static constexpr size_t MaxPower = 40;
+    static constexpr size_t BucketCount = (MaxPower - SubBucketBits + 1) * SubBuckets;
+
+    std::array<std::atomic<uint32_t>, BucketCount> buckets{};
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> last = 0;
+    std::atomic<uint64_t> max = 0;
+
+    static size_t bucketIndex(uint64_t micros);
+    // midpoint of the values that land in `index`
+    static uint64_t bucketValue(size_t index);
+};
+
+}
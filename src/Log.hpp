@@ -0,0 +1,29 @@
+#pragma once
+
+#include <miniws.hpp>
+#include <fmt/format.h>
+
+// Records less severe than this are compiled out (0 = Debug, 1 = Info, 2 = Error).
+// Unless the build says otherwise, release builds drop Debug.
+#ifndef MINIWS_LOG_FLOOR
+# ifdef NDEBUG
+#  define MINIWS_LOG_FLOOR 1
+# else
+#  define MINIWS_LOG_FLOOR 0
+# endif
+#endif
+
+// Logs through `logger`, which provides logEnabled(severity) and writeLog(severity, source, message).
+// The arguments are only evaluated and formatted once the record has passed both the compile-time
+// floor and the logger's runtime level, and then into a stack buffer, so a filtered record costs
+// one comparison and one below the floor costs nothing.
+#define MINIWS_LOG(logger, severity, ...)                                                              \
+    do {                                                                                               \
+        if constexpr (static_cast<int>(severity) >= MINIWS_LOG_FLOOR) {                                \
+            if ((logger).logEnabled(severity)) {                                                       \
+                fmt::memory_buffer miniwsLogBuffer;                                                    \
+                fmt::format_to(fmt::appender(miniwsLogBuffer), __VA_ARGS__);                           \
+                (logger).writeLog(severity, __func__, {miniwsLogBuffer.data(), miniwsLogBuffer.size()}); \
+            }                                                                                          \
+        }                                                                                              \
+    } while (false)
@@ -0,0 +1,152 @@
+#include "Mask.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+# define MINIWS_MASK_X86 1
+# include <immintrin.h>
+#endif
+
+#if defined(MINIWS_MASK_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+# define MINIWS_MASK_SSE2 1
+#endif
+
+#if defined(MINIWS_MASK_X86) && (defined(__GNUC__) || defined(__clang__))
+# define MINIWS_MASK_AVX2 1
+# define MINIWS_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(MINIWS_MASK_X86) && defined(__AVX2__)
+# define MINIWS_MASK_AVX2 1
+# define MINIWS_TARGET_AVX2
+#endif
+
+namespace ws {
+
+using MaskFn = void(*)(uint8_t* dest, const uint8_t* src, size_t size, uint32_t key);
+
+// all kernels below work with dest == src, which is how applyMask masks in place
+
+static void maskTail(uint8_t* dest, const uint8_t* src, size_t size, uint32_t key) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &key, 4);
+
+    for (size_t i = 0; i < size; ++i) {
+        dest[i] = src[i] ^ bytes[i & 3];
+    }
+}
+
+static void maskScalar(uint8_t* dest, const uint8_t* src, size_t size, uint32_t key) {
+    uint64_t wide = (static_cast<uint64_t>(key) << 32) | key;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, src + i, 8);
+        word ^= wide;
+        std::memcpy(dest + i, &word, 8);
+    }
+
+    // 8 is a multiple of 4, so the key phase is unchanged here
+    maskTail(dest + i, src + i, size - i, key);
+}
+
+#ifdef MINIWS_MASK_SSE2
+static void maskSse2(uint8_t* dest, const uint8_t* src, size_t size, uint32_t key) {
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(key));
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_xor_si128(a, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 16), _mm_xor_si128(b, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 32), _mm_xor_si128(c, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 48), _mm_xor_si128(d, mask));
+    }
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_xor_si128(a, mask));
+    }
+
+    maskScalar(dest + i, src + i, size - i, key);
+}
+#endif
+
+#ifdef MINIWS_MASK_AVX2
+MINIWS_TARGET_AVX2
+static void maskAvx2(uint8_t* dest, const uint8_t* src, size_t size, uint32_t key) {
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(key));
+
+    size_t i = 0;
+    for (; i + 128 <= size; i += 128) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 64));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 96));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_xor_si256(a, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 32), _mm256_xor_si256(b, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 64), _mm256_xor_si256(c, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 96), _mm256_xor_si256(d, mask));
+    }
+
+    for (; i + 32 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_xor_si256(a, mask));
+    }
+
+    maskScalar(dest + i, src + i, size - i, key);
+}
+#endif
+
+static MaskFn selectKernel() {
+#if defined(MINIWS_MASK_AVX2) && defined(__AVX2__)
+    return &maskAvx2;
+#else
+# if defined(MINIWS_MASK_AVX2) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx2")) {
+        return &maskAvx2;
+    }
+# endif
+# ifdef MINIWS_MASK_SSE2
+    return &maskSse2;
+# else
+    return &maskScalar;
+# endif
+#endif
+}
+
+uint32_t rotateMaskKey(uint32_t key, size_t offset) {
+    offset &= 3;
+    if (offset == 0) {
+        return key;
+    }
+
+    uint8_t bytes[4], rotated[4];
+    std::memcpy(bytes, &key, 4);
+    for (size_t i = 0; i < 4; ++i) {
+        rotated[i] = bytes[(i + offset) & 3];
+    }
+
+    std::memcpy(&key, rotated, 4);
+    return key;
+}
+
+void applyMaskCopy(uint8_t* dest, const uint8_t* src, size_t size, uint32_t key, size_t offset) {
+    static const MaskFn kernel = selectKernel();
+
+    // tiny payloads (most control frames, short text) are not worth the dispatch
+    if (size < 16) {
+        maskTail(dest, src, size, rotateMaskKey(key, offset));
+        return;
+    }
+
+    kernel(dest, src, size, rotateMaskKey(key, offset));
+}
+
+void applyMask(uint8_t* data, size_t size, uint32_t key, size_t offset) {
+    applyMaskCopy(data, data, size, key, offset);
+}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ws {
+
+// The masking key is stored exactly as it appears on the wire, so `key` should be
+// filled with memcpy from the 4 key bytes rather than assembled with shifts.
+// `offset` is the position of the first byte within the payload, which lets a
+// payload be masked in several chunks.
+
+void applyMask(uint8_t* data, size_t size, uint32_t key, size_t offset = 0);
+void applyMaskCopy(uint8_t* dest, const uint8_t* src, size_t size, uint32_t key, size_t offset = 0);
+
+// the key as it applies to a chunk starting at `offset`, for kernels that mask whole words from there
+uint32_t rotateMaskKey(uint32_t key, size_t offset);
+
+}
@@ -0,0 +1,152 @@
+#include <Memory.hpp>
+
+#include <algorithm>
+#include <bit>
+
+namespace ws {
+
+static void raisePeak(std::atomic<uint64_t>& peak, uint64_t value) {
+    uint64_t high = peak.load(std::memory_order_relaxed);
+    while (value > high && !peak.compare_exchange_weak(high, value, std::memory_order_relaxed)) {}
+}
+
+MemoryAccount::MemoryAccount(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+
+void* MemoryAccount::do_allocate(size_t bytes, size_t alignment) {
+    void* pointer = upstream->allocate(bytes, alignment);
+
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    raisePeak(peak, inUse.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+
+    return pointer;
+}
+
+void MemoryAccount::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    upstream->deallocate(pointer, bytes, alignment);
+    inUse.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool MemoryAccount::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+MemoryStats MemoryAccount::stats() const {
+    return MemoryStats{
+        .bytesInUse = inUse.load(std::memory_order_relaxed),
+        .peakBytesInUse = peak.load(std::memory_order_relaxed),
+        .allocations = allocations.load(std::memory_order_relaxed),
+        .upstreamAllocations = allocations.load(std::memory_order_relaxed),
+    };
+}
+
+FramePool::FramePool(FramePoolOptions options, std::pmr::memory_resource* upstream)
+    : options(options), upstream(upstream)
+{
+    for (size_t size = SmallestBlock; size <= std::bit_ceil(options.largestBlock); size *= 2) {
+        classes.push_back(std::make_unique<SizeClass>());
+    }
+}
+
+FramePool::~FramePool() {
+    this->trim();
+}
+
+size_t FramePool::classOf(size_t bytes, size_t alignment) const {
+    if (bytes > options.largestBlock || alignment > alignof(std::max_align_t)) {
+        return classes.size();
+    }
+
+    size_t size = std::bit_ceil(std::max(bytes, SmallestBlock));
+    return static_cast<size_t>(std::countr_zero(size) - std::countr_zero(SmallestBlock));
+}
+
+void FramePool::countInUse(int64_t delta) {
+    uint64_t now = inUse.fetch_add(static_cast<uint64_t>(delta), std::memory_order_relaxed) + static_cast<uint64_t>(delta);
+    raisePeak(peak, now);
+}
+
+void* FramePool::do_allocate(size_t bytes, size_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    size_t index = this->classOf(bytes, alignment);
+    if (index == classes.size()) {
+        upstreamAllocations.fetch_add(1, std::memory_order_relaxed);
+        void* pointer = upstream->allocate(bytes, alignment);
+        this->countInUse(static_cast<int64_t>(bytes));
+        return pointer;
+    }
+
+    size_t size = SmallestBlock << index;
+    this->countInUse(static_cast<int64_t>(size));
+
+    auto& sizeClass = *classes[index];
+    {
+        std::lock_guard lock(sizeClass.mutex);
+        if (!sizeClass.blocks.empty()) {
+            void* pointer = sizeClass.blocks.back();
+            sizeClass.blocks.pop_back();
+            cached.fetch_sub(size, std::memory_order_relaxed);
+            return pointer;
+        }
+    }
+
+    upstreamAllocations.fetch_add(1, std::memory_order_relaxed);
+    return upstream->allocate(size, alignof(std::max_align_t));
+}
+
+void FramePool::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    size_t index = this->classOf(bytes, alignment);
+    if (index == classes.size()) {
+        upstream->deallocate(pointer, bytes, alignment);
+        this->countInUse(-static_cast<int64_t>(bytes));
+        return;
+    }
+
+    size_t size = SmallestBlock << index;
+    this->countInUse(-static_cast<int64_t>(size));
+
+    // reserve the room first, so two threads cannot both squeeze in under the cap
+    if (cached.fetch_add(size, std::memory_order_relaxed) + size <= options.maxCachedBytes) {
+        auto& sizeClass = *classes[index];
+        std::lock_guard lock(sizeClass.mutex);
+        sizeClass.blocks.push_back(pointer);
+        return;
+    }
+
+    cached.fetch_sub(size, std::memory_order_relaxed);
+    upstream->deallocate(pointer, size, alignof(std::max_align_t));
+}
+
+bool FramePool::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+void FramePool::trim() {
+    for (size_t index = 0; index < classes.size(); ++index) {
+        size_t size = SmallestBlock << index;
+
+        std::vector<void*> blocks;
+        {
+            std::lock_guard lock(classes[index]->mutex);
+            blocks.swap(classes[index]->blocks);
+        }
+
+        for (void* block : blocks) {
+            upstream->deallocate(block, size, alignof(std::max_align_t));
+        }
+
+        cached.fetch_sub(blocks.size() * size, std::memory_order_relaxed);
+    }
+}
+
+MemoryStats FramePool::stats() const {
+    return MemoryStats{
+        .bytesInUse = inUse.load(std::memory_order_relaxed),
+        .peakBytesInUse = peak.load(std::memory_order_relaxed),
+        .bytesCached = cached.load(std::memory_order_relaxed),
+        .allocations = allocations.load(std::memory_order_relaxed),
+        .upstreamAllocations = upstreamAllocations.load(std::memory_order_relaxed),
+    };
+}
+
+}
@@ -0,0 +1,235 @@
+#include <Metrics.hpp>
+#include "ConnectionMetrics.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fmt/format.h>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace ws {
+
+namespace {
+    struct Registry {
+        std::mutex mutex;
+        std::unordered_set<const ConnectionMetrics*> live;
+        // everything counted by connections that no longer exist
+        MetricsSnapshot retired;
+    };
+
+    // never destroyed, clients in static storage may outlive any other static
+    Registry& registry() {
+        static Registry* instance = new Registry();
+        return *instance;
+    }
+
+    class Exporter {
+    public:
+        ~Exporter() {
+            this->set({}, nullptr);
+        }
+
+        void set(std::chrono::milliseconds interval, std::function<void(const MetricsSnapshot&)> callback) {
+            std::lock_guard setLock(setMutex);
+
+            if (thread.joinable()) {
+                {
+                    std::lock_guard lock(mutex);
+                    stopping = true;
+                }
+
+                cv.notify_all();
+                thread.join();
+            }
+
+            if (!callback) {
+                return;
+            }
+
+            stopping = false;
+            thread = std::thread([this, interval, callback = std::move(callback)] {
+                std::unique_lock lock(mutex);
+
+                while (!cv.wait_for(lock, interval, [this] { return stopping; })) {
+                    lock.unlock();
+                    callback(Metrics::global());
+                    lock.lock();
+                }
+            });
+        }
+
+    private:
+        std::mutex setMutex;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stopping = false;
+        std::thread thread;
+    };
+
+    const char* opcodeName(size_t opcode) {
+        switch (opcode) {
+            case 0x0: return "continuation";
+            case 0x1: return "text";
+            case 0x2: return "binary";
+            case 0x8: return "close";
+            case 0x9: return "ping";
+            case 0xA: return "pong";
+            default: return nullptr;
+        }
+    }
+}
+
+ConnectionMetrics::ConnectionMetrics() {
+    auto& reg = registry();
+    std::lock_guard lock(reg.mutex);
+    reg.live.insert(this);
+}
+
+ConnectionMetrics::~ConnectionMetrics() {
+    auto& reg = registry();
+    std::lock_guard lock(reg.mutex);
+
+    auto last = this->snapshot();
+    last.queueDepth = 0;
+
+    reg.retired += last;
+    reg.live.erase(this);
+}
+
+MetricsSnapshot ConnectionMetrics::snapshot() const {
+    auto read = [](const Counter& counter) {
+        return counter.load(std::memory_order_relaxed);
+    };
+
+    MetricsSnapshot snap;
+    snap.connections = 1;
+    snap.bytesIn = read(bytesIn);
+    snap.bytesOut = read(bytesOut);
+    snap.reads = read(reads);
+    snap.writes = read(writes);
+
+    for (size_t i = 0; i < 16; ++i) {
+        snap.framesIn[i] = read(framesIn[i]);
+        snap.framesOut[i] = read(framesOut[i]);
+    }
+
+    snap.largestFrameIn = read(largestFrameIn);
+    snap.largestFrameOut = read(largestFrameOut);
+    snap.queueDepth = read(queueDepth);
+    snap.queueHighWater = read(queueHighWater);
+    snap.frameAllocations = read(frameAllocations);
+    snap.handshakes = read(handshakes);
+    snap.handshakeMicros = read(handshakeMicros);
+    snap.callbacks = read(callbacks);
+    snap.callbackMicros = read(callbackMicros);
+    snap.callbackMaxMicros = read(callbackMaxMicros);
+
+    return snap;
+}
+
+uint64_t MetricsSnapshot::totalFramesIn() const {
+    uint64_t total = 0;
+    for (auto count : framesIn) total += count;
+    return total;
+}
+
+uint64_t MetricsSnapshot::totalFramesOut() const {
+    uint64_t total = 0;
+    for (auto count : framesOut) total += count;
+    return total;
+}
+
+MetricsSnapshot& MetricsSnapshot::operator+=(const MetricsSnapshot& other) {
+    connections += other.connections;
+    bytesIn += other.bytesIn;
+    bytesOut += other.bytesOut;
+    reads += other.reads;
+    writes += other.writes;
+
+    for (size_t i = 0; i < 16; ++i) {
+        framesIn[i] += other.framesIn[i];
+        framesOut[i] += other.framesOut[i];
+    }
+
+    largestFrameIn = std::max(largestFrameIn, other.largestFrameIn);
+    largestFrameOut = std::max(largestFrameOut, other.largestFrameOut);
+    queueDepth += other.queueDepth;
+    queueHighWater = std::max(queueHighWater, other.queueHighWater);
+    frameAllocations += other.frameAllocations;
+    handshakes += other.handshakes;
+    handshakeMicros += other.handshakeMicros;
+    callbacks += other.callbacks;
+    callbackMicros += other.callbackMicros;
+    callbackMaxMicros = std::max(callbackMaxMicros, other.callbackMaxMicros);
+
+    return *this;
+}
+
+std::string MetricsSnapshot::toPrometheus(std::string_view prefix, std::string_view labels) const {
+    std::string out;
+    auto it = std::back_inserter(out);
+
+    auto metric = [&](std::string_view name, std::string_view type, uint64_t value) {
+        fmt::format_to(it, "# TYPE {}_{} {}\n", prefix, name, type);
+
+        if (labels.empty()) {
+            fmt::format_to(it, "{}_{} {}\n", prefix, name, value);
+        } else {
+            fmt::format_to(it, "{}_{}{{{}}} {}\n", prefix, name, labels, value);
+        }
+    };
+
+    auto perOpcode = [&](std::string_view name, const std::array<uint64_t, 16>& counts) {
+        fmt::format_to(it, "# TYPE {}_{} counter\n", prefix, name);
+
+        for (size_t i = 0; i < counts.size(); ++i) {
+            auto opcode = opcodeName(i);
+            if (!opcode) {
+                continue;
+            }
+
+            fmt::format_to(it, "{}_{}{{opcode=\"{}\"{}{}}} {}\n", prefix, name, opcode, labels.empty() ? "" : ",", labels, counts[i]);
+        }
+    };
+
+    metric("connections_total", "counter", connections);
+    metric("bytes_in_total", "counter", bytesIn);
+    metric("bytes_out_total", "counter", bytesOut);
+    metric("transport_reads_total", "counter", reads);
+    metric("transport_writes_total", "counter", writes);
+    perOpcode("frames_in_total", framesIn);
+    perOpcode("frames_out_total", framesOut);
+    metric("largest_frame_in_bytes", "gauge", largestFrameIn);
+    metric("largest_frame_out_bytes", "gauge", largestFrameOut);
+    metric("send_queue_depth", "gauge", queueDepth);
+    metric("send_queue_high_water", "gauge", queueHighWater);
+    metric("frame_allocations_total", "counter", frameAllocations);
+    metric("handshakes_total", "counter", handshakes);
+    metric("handshake_microseconds_total", "counter", handshakeMicros);
+    metric("callbacks_total", "counter", callbacks);
+    metric("callback_microseconds_total", "counter", callbackMicros);
+    metric("callback_max_microseconds", "gauge", callbackMaxMicros);
+
+    return out;
+}
+
+MetricsSnapshot Metrics::global() {
+    auto& reg = registry();
+    std::lock_guard lock(reg.mutex);
+
+    MetricsSnapshot total = reg.retired;
+    for (auto connection : reg.live) {
+        total += connection->snapshot();
+    }
+
+    return total;
+}
+
+void Metrics::setExporter(std::chrono::milliseconds interval, std::function<void(const MetricsSnapshot&)> exporter) {
+    static Exporter instance;
+    instance.set(interval, std::move(exporter));
+}
+
+}
@@ -0,0 +1,110 @@
+#include "Random.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+
+namespace ws {
+
+static inline uint32_t rotl(uint32_t value, int shift) {
+    return (value << shift) | (value >> (32 - shift));
+}
+
+static inline void quarterRound(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d) {
+    a += b; d ^= a; d = rotl(d, 16);
+    c += d; b ^= c; b = rotl(b, 12);
+    a += b; d ^= a; d = rotl(d, 8);
+    c += d; b ^= c; b = rotl(b, 7);
+}
+
+// ChaCha20 (RFC 8439) used as a keystream generator; the key and nonce come from the OS once per thread
+class ChaChaRng {
+public:
+    ChaChaRng() {
+        std::random_device rd;
+
+        state[0] = 0x61707865;
+        state[1] = 0x3320646e;
+        state[2] = 0x79622d32;
+        state[3] = 0x6b206574;
+
+        // 8 key words, then a 32-bit counter and 3 nonce words
+        for (size_t i = 4; i < 12; ++i) {
+            state[i] = rd();
+        }
+        state[12] = 0;
+        for (size_t i = 13; i < 16; ++i) {
+            state[i] = rd();
+        }
+    }
+
+    void fill(uint8_t* dest, size_t len) {
+        while (len > 0) {
+            if (position == block.size()) {
+                refill();
+            }
+
+            size_t chunk = std::min(len, block.size() - position);
+            std::memcpy(dest, block.data() + position, chunk);
+            // never hand out the same keystream bytes twice
+            std::memset(block.data() + position, 0, chunk);
+
+            position += chunk;
+            dest += chunk;
+            len -= chunk;
+        }
+    }
+
+private:
+    std::array<uint32_t, 16> state;
+    std::array<uint8_t, 64> block{};
+    size_t position = block.size();
+
+    void refill() {
+        std::array<uint32_t, 16> x = state;
+
+        for (int i = 0; i < 10; ++i) {
+            quarterRound(x[0], x[4], x[8], x[12]);
+            quarterRound(x[1], x[5], x[9], x[13]);
+            quarterRound(x[2], x[6], x[10], x[14]);
+            quarterRound(x[3], x[7], x[11], x[15]);
+            quarterRound(x[0], x[5], x[10], x[15]);
+            quarterRound(x[1], x[6], x[11], x[12]);
+            quarterRound(x[2], x[7], x[8], x[13]);
+            quarterRound(x[3], x[4], x[9], x[14]);
+        }
+
+        for (size_t i = 0; i < 16; ++i) {
+            uint32_t word = x[i] + state[i];
+            block[i * 4 + 0] = static_cast<uint8_t>(word);
+            block[i * 4 + 1] = static_cast<uint8_t>(word >> 8);
+            block[i * 4 + 2] = static_cast<uint8_t>(word >> 16);
+            block[i * 4 + 3] = static_cast<uint8_t>(word >> 24);
+        }
+
+        // 2^32 blocks is 256 GiB of output; carry into the first nonce word rather than repeating
+        if (++state[12] == 0) {
+            ++state[13];
+        }
+
+        position = 0;
+    }
+};
+
+static ChaChaRng& threadRng() {
+    static thread_local ChaChaRng rng;
+    return rng;
+}
+
+void fillRandom(uint8_t* dest, size_t len) {
+    threadRng().fill(dest, len);
+}
+
+uint32_t randomMaskKey() {
+    uint32_t key;
+    threadRng().fill(reinterpret_cast<uint8_t*>(&key), sizeof(key));
+    return key;
+}
+
+}
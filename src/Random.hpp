@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ws {
+
+// Fills `dest` from a per-thread ChaCha20 keystream seeded from std::random_device.
+// Safe to call from any thread without locking.
+void fillRandom(uint8_t* dest, size_t len);
+
+// 4 random bytes in wire order, ready to be used as a frame masking key
+uint32_t randomMaskKey();
+
+}
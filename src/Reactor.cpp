@@ -0,0 +1,323 @@
+#include <Reactor.hpp>
+#include <miniws.hpp>
+
+#include <algorithm>
+#include <limits>
+
+#ifdef __linux__
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# include <unistd.h>
+# include <cerrno>
+# include <cstring>
+#endif
+
+using namespace geode;
+
+namespace ws {
+
+#ifdef __linux__
+
+// epoll user data for the wakeup eventfd; handler ids start at 1
+static constexpr uint64_t WakeId = 0;
+
+Result<std::unique_ptr<Reactor>> Reactor::create() {
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        return Err(std::string("epoll_create1 failed: ") + std::strerror(errno));
+    }
+
+    int wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        ::close(epollFd);
+        return Err(std::string("eventfd failed: ") + std::strerror(errno));
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WakeId;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    return Ok(std::unique_ptr<Reactor>(new Reactor(epollFd, wakeFd)));
+}
+
+Reactor::~Reactor() {
+    this->stop();
+
+    ::close(wakeFd);
+    ::close(epollFd);
+}
+
+void Reactor::run() {
+    running = true;
+
+    while (running) {
+        this->runOnce(-1);
+    }
+}
+
+// the reactor whose events the current thread is handling, if any
+static thread_local Reactor* handlingReactor = nullptr;
+
+namespace {
+    struct LoopScope {
+        Reactor* previous;
+
+        explicit LoopScope(Reactor* reactor) : previous(std::exchange(handlingReactor, reactor)) {}
+
+        ~LoopScope() {
+            handlingReactor = previous;
+        }
+    };
+}
+
+bool Reactor::inLoop() const {
+    return handlingReactor == this;
+}
+
+void Reactor::runOnce(int timeoutMs) {
+    constexpr int MaxEvents = 64;
+    epoll_event events[MaxEvents];
+
+    int count = epoll_wait(epollFd, events, MaxEvents, this->timerTimeout(timeoutMs));
+
+    std::lock_guard lock(loopMutex);
+    LoopScope scope(this);
+
+    for (int i = 0; i < count; ++i) {
+        uint64_t id = events[i].data.u64;
+
+        if (id == WakeId) {
+            uint64_t value;
+            (void) ::read(wakeFd, &value, sizeof(value));
+            continue;
+        }
+
+        // a callback earlier in this batch may have removed the handler
+        auto it = handlers.find(id);
+        if (it == handlers.end()) {
+            continue;
+        }
+
+        if (events[i].events & EPOLLOUT) {
+            it->second->reactorWritable();
+        }
+
+        it = handlers.find(id);
+        if (it != handlers.end() && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+            it->second->reactorReadable();
+        }
+    }
+
+    std::vector<uint64_t> requests;
+    std::vector<std::coroutine_handle<>> resumable;
+    {
+        std::lock_guard flushLock(flushMutex);
+        requests.swap(flushRequests);
+        resumable.swap(posted);
+    }
+
+    for (uint64_t id : requests) {
+        auto it = handlers.find(id);
+        if (it != handlers.end()) {
+            it->second->reactorWritable();
+        }
+    }
+
+    // handles posted while these run wait for the next round, which the post itself wakes up
+    for (auto handle : resumable) {
+        handle.resume();
+    }
+
+    this->runTimers();
+}
+
+void Reactor::scheduleTimer(uint64_t id, TimePoint deadline) {
+    std::lock_guard lock(loopMutex);
+    timers.emplace(deadline, id);
+}
+
+void Reactor::runTimers() {
+    auto now = std::chrono::steady_clock::now();
+
+    // handlers only schedule deadlines in the future, so this ends
+    while (!timers.empty() && timers.top().first <= now) {
+        uint64_t id = timers.top().second;
+        timers.pop();
+
+        auto it = handlers.find(id);
+        if (it != handlers.end()) {
+            it->second->reactorTimer(now);
+        }
+    }
+}
+
+int Reactor::timerTimeout(int timeoutMs) {
+    std::lock_guard lock(loopMutex);
+
+    if (timers.empty()) {
+        return timeoutMs;
+    }
+
+    auto untilNext = std::chrono::ceil<std::chrono::milliseconds>(timers.top().first - std::chrono::steady_clock::now()).count();
+    int timerMs = static_cast<int>(std::clamp<int64_t>(untilNext, 0, std::numeric_limits<int>::max()));
+
+    return timeoutMs < 0 ? timerMs : std::min(timeoutMs, timerMs);
+}
+
+void Reactor::start() {
+    if (thread.joinable()) {
+        return;
+    }
+
+    running = true;
+    thread = std::thread([this] {
+        while (running) {
+            this->runOnce(-1);
+        }
+    });
+}
+
+void Reactor::stop() {
+    running = false;
+    this->wake();
+
+    if (thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+        thread.join();
+    }
+}
+
+size_t Reactor::connectionCount() {
+    std::lock_guard lock(loopMutex);
+    return handlers.size();
+}
+
+Result<> Reactor::add(ReactorHandler* handler, intptr_t fd, bool writable) {
+    std::lock_guard lock(loopMutex);
+
+    // assigned under the loop lock, so the loop never sees the handler without its id
+    uint64_t id = nextId++;
+    handler->reactorId = id;
+
+    // clients start with write interest so the upgrade request goes out as soon as the socket allows
+    epoll_event event{};
+    event.events = EPOLLIN | (writable ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = id;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, static_cast<int>(fd), &event) != 0) {
+        handler->reactorId = 0;
+        return Err(std::string("epoll_ctl failed: ") + std::strerror(errno));
+    }
+
+    handlers[id] = handler;
+    return Ok();
+}
+
+void Reactor::remove(uint64_t id, intptr_t fd) {
+    std::lock_guard lock(loopMutex);
+
+    if (handlers.erase(id) > 0) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, static_cast<int>(fd), nullptr);
+    }
+}
+
+void Reactor::setWriteInterest(uint64_t id, intptr_t fd, bool enabled) {
+    this->setInterest(id, fd, true, enabled);
+}
+
+void Reactor::setInterest(uint64_t id, intptr_t fd, bool readable, bool writable) {
+    // hangups are reported even without EPOLLIN; edge triggered, a handler that stopped reading hears of one once
+    epoll_event event{};
+    event.events = (readable ? static_cast<uint32_t>(EPOLLIN) : static_cast<uint32_t>(EPOLLET)) | (writable ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = id;
+
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, static_cast<int>(fd), &event);
+}
+
+void Reactor::requestFlush(uint64_t id) {
+    {
+        std::lock_guard lock(flushMutex);
+        flushRequests.push_back(id);
+    }
+
+    this->wake();
+}
+
+void Reactor::requestFlush(std::span<const uint64_t> ids) {
+    if (ids.empty()) {
+        return;
+    }
+
+    // one wakeup for the whole batch, which is what makes broadcasting to many connections cheap
+    {
+        std::lock_guard lock(flushMutex);
+        flushRequests.insert(flushRequests.end(), ids.begin(), ids.end());
+    }
+
+    this->wake();
+}
+
+void Reactor::post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard lock(flushMutex);
+        posted.push_back(handle);
+    }
+
+    this->wake();
+}
+
+void Reactor::wake() {
+    uint64_t value = 1;
+    (void) ::write(wakeFd, &value, sizeof(value));
+}
+
+#else
+
+Result<std::unique_ptr<Reactor>> Reactor::create() {
+    return Err("Reactor is only available on Linux");
+}
+
+Reactor::~Reactor() {}
+void Reactor::run() {}
+void Reactor::runOnce(int) {}
+void Reactor::start() {}
+void Reactor::stop() {}
+size_t Reactor::connectionCount() { return 0; }
+Result<> Reactor::add(ReactorHandler*, intptr_t, bool) { return Err("Reactor is only available on Linux"); }
+void Reactor::remove(uint64_t, intptr_t) {}
+void Reactor::setWriteInterest(uint64_t, intptr_t, bool) {}
+void Reactor::setInterest(uint64_t, intptr_t, bool, bool) {}
+void Reactor::post(std::coroutine_handle<>) {}
+bool Reactor::inLoop() const { return false; }
+void Reactor::requestFlush(uint64_t) {}
+void Reactor::requestFlush(std::span<const uint64_t>) {}
+void Reactor::wake() {}
+void Reactor::scheduleTimer(uint64_t, TimePoint) {}
+void Reactor::runTimers() {}
+int Reactor::timerTimeout(int timeoutMs) { return timeoutMs; }
+
+#endif
+
+Result<std::unique_ptr<ReactorPool>> ReactorPool::create(size_t threads) {
+    auto pool = std::unique_ptr<ReactorPool>(new ReactorPool());
+
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+        GEODE_UNWRAP_INTO(auto reactor, Reactor::create());
+        reactor->start();
+        pool->reactors.push_back(std::move(reactor));
+    }
+
+    return Ok(std::move(pool));
+}
+
+ReactorPool::~ReactorPool() {
+    for (auto& reactor : reactors) {
+        reactor->stop();
+    }
+}
+
+Reactor& ReactorPool::next() {
+    return *reactors[counter++ % reactors.size()];
+}
+
+}
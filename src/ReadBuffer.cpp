@@ -0,0 +1,82 @@
+#include "ReadBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace geode;
+
+namespace ws {
+
+void ReadBuffer::prepareFill() {
+    // only move bytes down when it buys a meaningful amount of space
+    if (tail == buffer.size() || buffer.size() - tail < buffer.size() / 4) {
+        compact();
+    }
+
+    if (tail == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+    }
+}
+
+Result<size_t> ReadBuffer::fill(BaseTransport& transport) {
+    this->prepareFill();
+
+    GEODE_UNWRAP_INTO(size_t received, transport.receive(buffer.data() + tail, buffer.size() - tail));
+    tail += received;
+
+    return Ok(received);
+}
+
+Result<std::optional<size_t>> ReadBuffer::tryFill(BaseTransport& transport, size_t maxBytes) {
+    this->prepareFill();
+
+    size_t room = std::min(buffer.size() - tail, std::max<size_t>(maxBytes, 1));
+    GEODE_UNWRAP_INTO(auto received, transport.tryReceive(buffer.data() + tail, room));
+    if (received) {
+        tail += *received;
+    }
+
+    return Ok(received);
+}
+
+void ReadBuffer::append(std::span<const uint8_t> bytes) {
+    this->reserve(this->size() + bytes.size());
+    if (buffer.size() - tail < bytes.size()) {
+        compact();
+    }
+
+    std::memcpy(buffer.data() + tail, bytes.data(), bytes.size());
+    tail += bytes.size();
+}
+
+void ReadBuffer::consume(size_t count) {
+    head += count;
+
+    if (head == tail) {
+        head = tail = 0;
+    }
+}
+
+void ReadBuffer::reserve(size_t count) {
+    if (count <= buffer.size() - head) {
+        return;
+    }
+
+    compact();
+
+    if (count > buffer.size()) {
+        buffer.resize(count);
+    }
+}
+
+void ReadBuffer::compact() {
+    if (head == 0) {
+        return;
+    }
+
+    std::memmove(buffer.data(), buffer.data() + head, tail - head);
+    tail -= head;
+    head = 0;
+}
+
+}
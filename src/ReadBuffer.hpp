@@ -0,0 +1,57 @@
+#pragma once
+
+#include <BaseTransport.hpp>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+namespace ws {
+
+// Read-ahead buffer that sits between a transport and the frame parser.
+// Each fill() is a single transport read that takes as much as is ready, so a burst of
+// small frames costs one read instead of one read per header field.
+class ReadBuffer {
+public:
+    static constexpr size_t DefaultCapacity = 16 * 1024;
+
+    explicit ReadBuffer(size_t capacity = DefaultCapacity, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : buffer(capacity, memory) {}
+
+    geode::Result<size_t> fill(BaseTransport& transport);
+    // non-blocking fill of at most `maxBytes`, std::nullopt if nothing was ready
+    geode::Result<std::optional<size_t>> tryFill(BaseTransport& transport, size_t maxBytes = SIZE_MAX);
+
+    // appends bytes that were read elsewhere (e.g. trailing the handshake response)
+    void append(std::span<const uint8_t> bytes);
+
+    // unread bytes, in order
+    std::span<uint8_t> data() {
+        return {buffer.data() + head, tail - head};
+    }
+
+    size_t size() const {
+        return tail - head;
+    }
+
+    void consume(size_t count);
+
+    // drops everything unread, keeping the allocation
+    void clear() {
+        head = tail = 0;
+    }
+
+    // makes sure `count` unread bytes can be held contiguously
+    void reserve(size_t count);
+
+private:
+    std::pmr::vector<uint8_t> buffer;
+    size_t head = 0;
+    size_t tail = 0;
+
+    void compact();
+    // compacts or grows so that some space is free at the end
+    void prepareFill();
+};
+
+}
@@ -0,0 +1,132 @@
+#include <Resolver.hpp>
+#include "SocketUtil.hpp"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <thread>
+
+#ifdef _WIN32
+# include <ws2tcpip.h>
+#else
+# include <netdb.h>
+#endif
+
+using namespace geode;
+
+namespace ws {
+
+Result<Resolution> SystemResolver::resolve(std::string_view host) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* info = nullptr;
+    std::string name(host);
+
+    int res = getaddrinfo(name.c_str(), nullptr, &hints, &info);
+    if (res != 0) {
+        return Err(std::string(gai_strerror(res)));
+    }
+
+    Resolution resolution;
+    resolution.ttl = ttl;
+
+    // getaddrinfo already orders the list by preference (RFC 6724), keep that order
+    for (auto it = info; it; it = it->ai_next) {
+        char buffer[INET6_ADDRSTRLEN];
+        const void* addr = it->ai_family == AF_INET6
+            ? static_cast<const void*>(&reinterpret_cast<sockaddr_in6*>(it->ai_addr)->sin6_addr)
+            : static_cast<const void*>(&reinterpret_cast<sockaddr_in*>(it->ai_addr)->sin_addr);
+
+        if (!inet_ntop(it->ai_family, addr, buffer, sizeof(buffer))) {
+            continue;
+        }
+
+        if (std::find(resolution.addresses.begin(), resolution.addresses.end(), buffer) == resolution.addresses.end()) {
+            resolution.addresses.emplace_back(buffer);
+        }
+    }
+
+    freeaddrinfo(info);
+
+    if (resolution.addresses.empty()) {
+        return Err("no addresses found");
+    }
+
+    return Ok(std::move(resolution));
+}
+
+ResolverCache::ResolverCache(std::shared_ptr<Resolver> resolver, std::chrono::seconds negativeTtl)
+    : resolver(std::move(resolver)), negativeTtl(negativeTtl), state(std::make_shared<State>()) {}
+
+std::shared_ptr<ResolverCache> ResolverCache::shared() {
+    static auto cache = std::make_shared<ResolverCache>();
+    return cache;
+}
+
+std::shared_future<ResolveResult> ResolverCache::resolveAsync(std::string_view host) {
+    if (isIpLiteral(host)) {
+        std::promise<ResolveResult> literal;
+        literal.set_value(Ok(std::vector<std::string>{std::string(host)}));
+        return literal.get_future().share();
+    }
+
+    std::string key(host);
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard lock(state->mutex);
+
+    auto it = state->entries.find(key);
+    if (it != state->entries.end() && it->second.expires > now) {
+        return it->second.result;
+    }
+
+    // also drop whatever else expired, so the map does not keep every host ever seen
+    std::erase_if(state->entries, [&](const auto& entry) {
+        return entry.second.expires <= now;
+    });
+
+    std::promise<ResolveResult> promise;
+    auto future = promise.get_future().share();
+
+    // in flight until the lookup finishes and sets the real expiry
+    uint64_t id = ++state->nextId;
+    state->entries[key] = Entry{future, std::chrono::steady_clock::time_point::max(), id};
+
+    std::thread([resolver = resolver, state = state, negativeTtl = negativeTtl, key, id, promise = std::move(promise)]() mutable {
+        auto res = resolver->resolve(key);
+        auto ttl = res.isOk() ? res.unwrap().ttl : negativeTtl;
+
+        {
+            std::lock_guard lock(state->mutex);
+
+            // the entry may have been cleared and replaced by a newer lookup meanwhile
+            auto it = state->entries.find(key);
+            if (it != state->entries.end() && it->second.id == id) {
+                it->second.expires = std::chrono::steady_clock::now() + ttl;
+            }
+        }
+
+        if (res.isOk()) {
+            promise.set_value(Ok(std::move(res).unwrap().addresses));
+        } else {
+            promise.set_value(Err(fmt::format("failed to resolve {}: {}", key, res.unwrapErr())));
+        }
+    }).detach();
+
+    return future;
+}
+
+void ResolverCache::clear() {
+    std::lock_guard lock(state->mutex);
+
+    // lookups in flight keep running, they just are not cached anymore
+    state->entries.clear();
+}
+
+size_t ResolverCache::size() {
+    std::lock_guard lock(state->mutex);
+    return state->entries.size();
+}
+
+}
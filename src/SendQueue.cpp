@@ -0,0 +1,67 @@
+#include "SendQueue.hpp"
+
+#include <algorithm>
+
+namespace ws {
+
+static bool isControl(Opcode opcode) {
+    return static_cast<uint8_t>(opcode) & 0x8;
+}
+
+SendQueue::~SendQueue() {
+    std::vector<OutgoingFrame*> frames;
+    this->takeAll(frames);
+    release(frames);
+}
+
+OutgoingFrame* SendQueue::newFrame(Opcode opcode) {
+    return std::pmr::polymorphic_allocator<>(memory).new_object<OutgoingFrame>(opcode, memory);
+}
+
+void SendQueue::push(OutgoingFrame* frame) {
+    auto& head = isControl(frame->opcode) ? control : data;
+
+    if (metrics) {
+        metrics->countQueued();
+    }
+
+    frame->next = head.load(std::memory_order_relaxed);
+
+    // the writer only ever swaps the whole stack out, so there is no ABA to worry about
+    while (!head.compare_exchange_weak(frame->next, frame, std::memory_order_seq_cst, std::memory_order_relaxed)) {}
+}
+
+void SendQueue::appendReversed(OutgoingFrame* head, std::vector<OutgoingFrame*>& out) {
+    // the stacks are newest first
+    size_t start = out.size();
+    for (; head; head = head->next) {
+        out.push_back(head);
+    }
+
+    std::reverse(out.begin() + start, out.end());
+}
+
+void SendQueue::takeAll(std::vector<OutgoingFrame*>& out) {
+    size_t start = out.size();
+
+    appendReversed(control.exchange(nullptr, std::memory_order_seq_cst), out);
+    appendReversed(data.exchange(nullptr, std::memory_order_seq_cst), out);
+
+    if (metrics && out.size() > start) {
+        metrics->countDequeued(out.size() - start);
+    }
+}
+
+void SendQueue::release(std::vector<OutgoingFrame*>& frames) {
+    for (auto frame : frames) {
+        std::pmr::polymorphic_allocator<>(frame->payload.get_allocator()).delete_object(frame);
+    }
+
+    frames.clear();
+}
+
+bool SendQueue::empty() const {
+    return control.load(std::memory_order_seq_cst) == nullptr && data.load(std::memory_order_seq_cst) == nullptr;
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <miniws.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+#include "Frame.hpp"
+#include "ConnectionMetrics.hpp"
+
+namespace ws {
+
+// a complete server frame, see OutgoingFrame::encoded
+using EncodedFrame = std::shared_ptr<const std::pmr::vector<uint8_t>>;
+
+// A message waiting to be written, still unmasked and uncompressed.
+// Allocated from the same memory resource as its payload, see SendQueue::newFrame
+struct OutgoingFrame {
+    explicit OutgoingFrame(Opcode opcode, std::pmr::memory_resource* memory) : opcode(opcode), payload(memory) {}
+
+    Opcode opcode;
+    std::pmr::vector<uint8_t> payload;
+
+    // Server side: the complete frame, header included, ready to be written as is. Server frames are
+    // not masked, so a broadcast encodes once and every connection queues the same bytes
+    EncodedFrame encoded;
+
+    // filled in by the writer right before the frame goes out
+    uint8_t header[MaxFrameHeaderSize];
+    size_t headerSize = 0;
+
+    OutgoingFrame* next = nullptr;
+};
+
+// Outgoing frames of one connection. Any number of threads may push, but only one
+// writer at a time may take frames out; Client elects it with tryBeginWrite().
+//
+// Each push is a single compare-and-swap on a stack head and the writer empties a
+// stack with a single exchange, so producers never block each other or the writer.
+// Control frames have their own stack, which is always drained ahead of data.
+class SendQueue {
+public:
+    SendQueue() = default;
+    ~SendQueue();
+
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+
+    // a frame for push(), allocated from `memory`
+    OutgoingFrame* newFrame(Opcode opcode);
+    // takes ownership of a frame from newFrame()
+    void push(OutgoingFrame* frame);
+
+    // Appends everything pending to `out`, control frames first and each kind in the order it was pushed.
+    // The frames are owned by the caller until handed to release(), which keeps `out`'s capacity for the next pass
+    void takeAll(std::vector<OutgoingFrame*>& out);
+    static void release(std::vector<OutgoingFrame*>& frames);
+
+    bool empty() const;
+
+    // tracks queue depth when set
+    ConnectionMetrics* metrics = nullptr;
+
+    // where frames and their payloads are allocated; frames already queued keep their own
+    std::pmr::memory_resource* memory = std::pmr::get_default_resource();
+
+    // At most one thread holds the writer role at a time. Both sides are seq_cst like push() and empty():
+    // a writer that gives the role up and then finds the queue empty must not miss a push whose sender
+    // still saw the role taken, or that frame would sit in the queue with nobody to write it
+    bool tryBeginWrite() {
+        return !writing.exchange(true, std::memory_order_seq_cst);
+    }
+
+    void endWrite() {
+        writing.store(false, std::memory_order_seq_cst);
+    }
+
+private:
+    std::atomic<OutgoingFrame*> control = nullptr;
+    std::atomic<OutgoingFrame*> data = nullptr;
+    std::atomic<bool> writing = false;
+
+    static void appendReversed(OutgoingFrame* head, std::vector<OutgoingFrame*>& out);
+};
+
+}
@@ -0,0 +1,813 @@
+#include <Server.hpp>
+#include <Reactor.hpp>
+#include "TlsTransport.hpp"
+#include "TcpTransport.hpp"
+#include "Frame.hpp"
+#include "FrameReader.hpp"
+#include "Handshake.hpp"
+#include "SendQueue.hpp"
+#include "ConnectionMetrics.hpp"
+#include "Log.hpp"
+#include "SocketUtil.hpp"
+#include "Utf8.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+#include <fmt/base.h>
+#include <fmt/format.h>
+
+#ifdef __linux__
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+#endif
+
+using namespace geode;
+
+#define LOG_DEBUG(...) MINIWS_LOG(*this, LogSeverity::Debug, __VA_ARGS__)
+#define LOG_INFO(...) MINIWS_LOG(*this, LogSeverity::Info, __VA_ARGS__)
+#define LOG_ERROR(...) MINIWS_LOG(*this, LogSeverity::Error, __VA_ARGS__)
+
+namespace ws {
+    using Clock = std::chrono::steady_clock;
+
+    // an upgrade request is a few hundred bytes; anything this large is not one
+    static constexpr size_t MaxUpgradeRequestSize = 16 * 1024;
+
+    static std::atomic<uint64_t> nextConnectionId = 1;
+
+    static bool isControlOpcode(Opcode opcode) {
+        return static_cast<uint8_t>(opcode) & 0x8;
+    }
+
+    // Server frames are not masked, so the whole frame can be built once and shared by every connection it goes to
+    static EncodedFrame encodeFrame(std::pmr::memory_resource* memory, Opcode opcode, std::span<const uint8_t> payload) {
+        uint8_t header[MaxFrameHeaderSize];
+        size_t headerSize = encodeFrameHeader(header, static_cast<uint8_t>(opcode), payload.size(), std::nullopt);
+
+        // the control block and the bytes both come from `memory`
+        auto frame = std::allocate_shared<std::pmr::vector<uint8_t>>(std::pmr::polymorphic_allocator<>(memory));
+        frame->reserve(headerSize + payload.size());
+        frame->insert(frame->end(), header, header + headerSize);
+        frame->insert(frame->end(), payload.begin(), payload.end());
+        return frame;
+    }
+
+    static EncodedFrame encodeClose(std::pmr::memory_resource* memory, uint16_t code, std::string_view reason) {
+        reason = truncateUtf8(reason, MaxCloseReasonSize);
+
+        std::vector<uint8_t> payload;
+        payload.reserve(2 + reason.size());
+        payload.push_back(static_cast<uint8_t>(code >> 8));
+        payload.push_back(static_cast<uint8_t>(code & 0xff));
+        payload.insert(payload.end(), reason.begin(), reason.end());
+
+        return encodeFrame(memory, Opcode::Close, payload);
+    }
+
+    struct ServerWorker : ReactorHandler {
+        Server& server;
+        std::unique_ptr<Reactor> reactor;
+        qsox::SockFd listener;
+
+        // added and removed by the worker thread, walked by whoever broadcasts
+        std::mutex mutex;
+        std::unordered_map<uint64_t, std::shared_ptr<ServerConnection>> connections;
+
+        ServerWorker(Server& server, std::unique_ptr<Reactor> reactor, qsox::SockFd listener)
+            : server(server), reactor(std::move(reactor)), listener(listener) {}
+
+        ~ServerWorker() override {
+            closeSocket(listener);
+        }
+
+        void reactorReadable() override {
+            server.acceptConnections(*this);
+        }
+
+        void reactorWritable() override {}
+    };
+
+    ServerConnection::ServerConnection(Server& server, ServerWorker& worker, uint64_t id, std::string remote)
+        : counters(std::make_unique<ConnectionMetrics>()),
+          server(server),
+          worker(worker),
+          connectionId(id),
+          remote(std::move(remote)),
+          acceptedAt(Clock::now()),
+          request(std::make_unique<HttpRequestParser>(MaxUpgradeRequestSize)),
+          reader(std::make_unique<FrameReader>(server.options.memory)),
+          sendQueue(std::make_unique<SendQueue>()) {
+        reader->metrics = counters.get();
+        reader->requireMasked = true;
+        reader->maxMessageSize = server.options.maxMessageSize;
+        sendQueue->metrics = counters.get();
+        sendQueue->memory = server.options.memory;
+    }
+
+    ServerConnection::~ServerConnection() = default;
+
+    void ServerConnection::attach() {
+        {
+            std::lock_guard lock(worker.mutex);
+            worker.connections[connectionId] = shared_from_this();
+        }
+
+        if (auto res = worker.reactor->add(this, stream->nativeHandle(), false); res.isErr()) {
+            LOG_ERROR("unable to watch connection from {}: {}", remote, res.unwrapErr());
+
+            std::lock_guard lock(worker.mutex);
+            worker.connections.erase(connectionId);
+            return;
+        }
+
+        // a peer that never finishes the handshake would otherwise hold the connection forever
+        worker.reactor->scheduleTimer(reactorId, acceptedAt + server.options.handshakeTimeout);
+    }
+
+    bool ServerConnection::advanceTls() {
+        auto res = tlsPending->tryAccept();
+        if (res.isErr()) {
+            LOG_DEBUG("TLS handshake with {} failed: {}", remote, res.unwrapErr());
+            finish();
+            return false;
+        }
+
+        if (!res.unwrap()) {
+            return false;
+        }
+
+        tlsPending.reset();
+        phase = Phase::Upgrade;
+        return true;
+    }
+
+    void ServerConnection::upgrade() {
+        if (request->method() != "GET") {
+            reject("405 Method Not Allowed");
+            return;
+        }
+
+        if (!request->headerHasToken("Upgrade", "websocket") || !request->headerHasToken("Connection", "Upgrade")) {
+            reject("400 Bad Request");
+            return;
+        }
+
+        if (request->header("Sec-WebSocket-Version") != "13") {
+            reject("426 Upgrade Required");
+            return;
+        }
+
+        auto key = request->header("Sec-WebSocket-Key");
+        if (!key || key->empty()) {
+            reject("400 Bad Request");
+            return;
+        }
+
+        std::string_view target = request->target();
+        if (!server.options.path.empty() && target.substr(0, target.find('?')) != server.options.path) {
+            reject("404 Not Found");
+            return;
+        }
+
+        requestPath = target;
+
+        auto response = fmt::format(
+            "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: {}\r\n"
+            "\r\n",
+            expectedAcceptKey(*key)
+        );
+        pending.push_back(std::allocate_shared<std::pmr::vector<uint8_t>>(
+            std::pmr::polymorphic_allocator<>(server.options.memory), response.begin(), response.end()
+        ));
+
+        // frames the client sent right behind the request
+        reader->feed(request->leftover());
+        request.reset();
+
+        phase = Phase::Open;
+        open.store(true, std::memory_order_release);
+        counters->countHandshake(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - acceptedAt));
+
+        LOG_DEBUG("accepted {} from {}", requestPath, remote);
+
+        if (auto res = flush(); res.isErr()) {
+            LOG_DEBUG("unable to send handshake response: {}", res.unwrapErr());
+            finish();
+            return;
+        }
+
+        if (server.openCallback) {
+            server.openCallback(shared_from_this());
+        }
+    }
+
+    void ServerConnection::reject(std::string_view status) {
+        LOG_DEBUG("rejected upgrade request from {}: {}", remote, status);
+
+        auto response = fmt::format(
+            "HTTP/1.1 {}\r\n"
+            "Connection: close\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n",
+            status
+        );
+
+        // best effort, the answer is small enough for any socket buffer
+        (void) stream->sendAll(response.data(), response.size());
+        finish();
+    }
+
+    bool ServerConnection::processIncoming() {
+        while (auto event = reader->next()) {
+            switch (event->type) {
+                case FrameEvent::Type::Message:
+                    if (isControlOpcode(event->opcode)) {
+                        handleControl(event->opcode, event->payload);
+                    } else if (phase == Phase::Open && server.messageCallback) {
+                        auto start = Clock::now();
+                        server.messageCallback(*this, event->opcode, std::as_bytes(event->payload));
+                        counters->countCallback(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start));
+                    }
+                    break;
+
+                // the reader only produces these in streaming mode, which the server does not use
+                case FrameEvent::Type::Fragment:
+                    break;
+
+                case FrameEvent::Type::Error:
+                    LOG_DEBUG("closing connection ({}): {}", event->closeCode, event->reason);
+                    closeCode = event->closeCode;
+                    closeReason = event->reason;
+                    // nothing more will be read, so do not wait for an answer
+                    closeReceived = true;
+                    queue(encodeClose(server.options.memory, event->closeCode, event->reason), Opcode::Close, false);
+                    break;
+            }
+
+            if (phase == Phase::Closed || closeReceived) {
+                break;
+            }
+        }
+
+        if (closeReceived && phase != Phase::Closed) {
+            if (auto res = flush(); res.isErr()) {
+                finish();
+            }
+        }
+
+        return phase != Phase::Closed && !closeReceived;
+    }
+
+    void ServerConnection::handleControl(Opcode opcode, std::span<const uint8_t> payload) {
+        switch (opcode) {
+            case Opcode::Ping:
+                queue(encodeFrame(server.options.memory, Opcode::Pong, payload), Opcode::Pong, false);
+                (void) flush();
+                return;
+
+            case Opcode::Pong:
+                return;
+
+            default:
+                break;
+        }
+
+        uint16_t code = 1005;
+        std::string_view reason;
+        if (payload.size() >= 2) {
+            code = static_cast<uint16_t>((payload[0] << 8) | payload[1]);
+            reason = {reinterpret_cast<const char*>(payload.data()) + 2, payload.size() - 2};
+        }
+
+        // a lone byte is half a code, and codes that must not be sent are not echoed back either
+        if (payload.size() == 1 || (payload.size() >= 2 && !isValidCloseCode(code))) {
+            LOG_DEBUG("invalid close frame from {}", remote);
+            closeReceived = true;
+            closeCode = 1002;
+            closeReason = "invalid close frame";
+            queue(encodeClose(server.options.memory, closeCode, closeReason), Opcode::Close, false);
+            return;
+        }
+
+        LOG_DEBUG("client closed the connection ({}): {}", code, reason);
+
+        closeReceived = true;
+        closeCode = code;
+        closeReason = reason;
+
+        // echo the code back (RFC 6455 section 5.5.1); if we already sent a close, flush() drops this one
+        queue(encodeClose(server.options.memory, code == 1005 ? 1000 : code, {}), Opcode::Close, false);
+    }
+
+    bool ServerConnection::queue(EncodedFrame frame, Opcode opcode, bool flush) {
+        if (!open.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        auto out = sendQueue->newFrame(opcode);
+        out->encoded = std::move(frame);
+        counters->countAllocations(1);
+        sendQueue->push(out);
+
+        if (flush) {
+            worker.reactor->requestFlush(reactorId);
+        }
+
+        return true;
+    }
+
+    Result<> ServerConnection::flush() {
+        if (phase == Phase::Closed) {
+            return Ok();
+        }
+
+        while (true) {
+            if (pending.empty()) {
+                sendQueue->takeAll(writeBatch);
+
+                for (OutgoingFrame* frame : writeBatch) {
+                    // nothing may follow a close frame
+                    if (closeSent) {
+                        continue;
+                    }
+
+                    auto header = parseFrameHeader(*frame->encoded);
+                    counters->countFrameOut(static_cast<uint8_t>(frame->opcode), header ? header->payloadSize : 0);
+                    pending.push_back(std::move(frame->encoded));
+
+                    if (frame->opcode == Opcode::Close) {
+                        closeSent = true;
+                        phase = Phase::Closing;
+
+                        if (!closeReceived) {
+                            closeDeadline = Clock::now() + server.options.closeTimeout;
+                            worker.reactor->scheduleTimer(reactorId, closeDeadline);
+                        }
+                    }
+                }
+
+                SendQueue::release(writeBatch);
+
+                if (pending.empty()) {
+                    break;
+                }
+            }
+
+            gatherBuffers.clear();
+            size_t offset = pendingOffset;
+            for (auto& chunk : pending) {
+                gatherBuffers.push_back({chunk->data() + offset, chunk->size() - offset});
+                offset = 0;
+
+                if (gatherBuffers.size() == MaxGatherBuffers) {
+                    break;
+                }
+            }
+
+            GEODE_UNWRAP_INTO(auto sent, stream->trySendv(gatherBuffers));
+            if (!sent || *sent == 0) {
+                break;
+            }
+
+            size_t left = *sent;
+            while (left > 0) {
+                size_t chunkLeft = pending.front()->size() - pendingOffset;
+                if (left < chunkLeft) {
+                    pendingOffset += left;
+                    break;
+                }
+
+                left -= chunkLeft;
+                pending.pop_front();
+                pendingOffset = 0;
+            }
+        }
+
+        // only touch epoll when the interest actually changes
+        bool waiting = !pending.empty() || stream->hasPendingOutput();
+        if (waiting != writeInterest) {
+            worker.reactor->setWriteInterest(reactorId, stream->nativeHandle(), waiting);
+            writeInterest = waiting;
+        }
+
+        if (!waiting && closeSent && closeReceived) {
+            finish();
+        }
+
+        return Ok();
+    }
+
+    void ServerConnection::finish() {
+        if (phase == Phase::Closed) {
+            return;
+        }
+
+        // the worker's list may hold the last reference
+        auto self = shared_from_this();
+
+        bool wasOpen = open.exchange(false, std::memory_order_acq_rel);
+        phase = Phase::Closed;
+
+        worker.reactor->remove(reactorId, stream->nativeHandle());
+        (void) stream->shutdown();
+        pending.clear();
+
+        if (wasOpen && server.closeCallback) {
+            server.closeCallback(*this, closeCode, closeReason);
+        }
+
+        std::lock_guard lock(worker.mutex);
+        worker.connections.erase(connectionId);
+    }
+
+    void ServerConnection::reactorReadable() {
+        // finish() can drop the worker's reference while we are still in here
+        auto self = shared_from_this();
+
+        if (phase == Phase::TlsHandshake && !advanceTls()) {
+            return;
+        }
+
+        while (phase == Phase::Upgrade) {
+            uint8_t buffer[4096];
+            auto res = stream->tryReceive(buffer, sizeof(buffer));
+            if (res.isErr() || (res.unwrap() && *res.unwrap() == 0)) {
+                finish();
+                return;
+            }
+
+            if (!res.unwrap()) {
+                return;
+            }
+
+            auto state = request->feed({buffer, *res.unwrap()});
+            if (state == HttpRequestParser::State::Error) {
+                LOG_DEBUG("invalid upgrade request from {}: {}", remote, request->error());
+                reject("400 Bad Request");
+                return;
+            }
+
+            if (state == HttpRequestParser::State::Complete) {
+                upgrade();
+            }
+        }
+
+        // level triggered, but TLS may hold decrypted bytes the socket no longer signals, so read until it would block
+        while (phase == Phase::Open || phase == Phase::Closing) {
+            if (!processIncoming()) {
+                return;
+            }
+
+            auto res = reader->tryFill(*stream);
+            if (res.isErr()) {
+                LOG_DEBUG("unable to receive from {}: {}", remote, res.unwrapErr());
+                finish();
+                return;
+            }
+
+            if (!res.unwrap()) {
+                return;
+            }
+
+            if (*res.unwrap() == 0) {
+                LOG_DEBUG("connection from {} dropped", remote);
+                finish();
+                return;
+            }
+        }
+    }
+
+    void ServerConnection::reactorWritable() {
+        if (phase == Phase::TlsHandshake || phase == Phase::Upgrade) {
+            return;
+        }
+
+        auto self = shared_from_this();
+
+        if (auto res = flush(); res.isErr()) {
+            LOG_DEBUG("unable to send to {}: {}", remote, res.unwrapErr());
+            finish();
+        }
+    }
+
+    void ServerConnection::reactorTimer(Clock::time_point now) {
+        if (phase == Phase::TlsHandshake || phase == Phase::Upgrade) {
+            LOG_DEBUG("{} did not finish the handshake in time", remote);
+
+            auto self = shared_from_this();
+            finish();
+            return;
+        }
+
+        // the handshake deadline can also land here, before the close timeout is up
+        if (phase != Phase::Closing || closeReceived || now < closeDeadline) {
+            return;
+        }
+
+        LOG_DEBUG("{} did not answer the close frame", remote);
+
+        auto self = shared_from_this();
+        finish();
+    }
+
+    void ServerConnection::send(std::string_view data) {
+        queue(encodeFrame(server.options.memory, Opcode::Text, {reinterpret_cast<const uint8_t*>(data.data()), data.size()}), Opcode::Text);
+    }
+
+    void ServerConnection::send(std::span<const std::byte> data, Opcode opcode) {
+        queue(encodeFrame(server.options.memory, opcode, {reinterpret_cast<const uint8_t*>(data.data()), data.size()}), opcode);
+    }
+
+    void ServerConnection::close(uint16_t code, std::string_view reason) {
+        queue(encodeClose(server.options.memory, code, reason), Opcode::Close);
+    }
+
+    MetricsSnapshot ServerConnection::metrics() const {
+        return counters->snapshot();
+    }
+
+    bool ServerConnection::logEnabled(LogSeverity severity) const {
+        return server.logEnabled(severity);
+    }
+
+    void ServerConnection::writeLog(LogSeverity severity, std::string_view source, std::string_view message) {
+        server.writeLog(severity, source, message, connectionId);
+    }
+
+    Server::Server(ServerOptions options) : options(std::move(options)) {
+        // set default logging function
+        onLogRecord([](const LogRecord& record) {
+            fmt::println("[{}] {}", Client::severityToString(record.severity), record.message);
+        });
+    }
+
+    Server::~Server() {
+        this->stop();
+    }
+
+#ifdef __linux__
+
+    static std::string formatAddress(const sockaddr_storage& address) {
+        char host[INET6_ADDRSTRLEN] = {};
+
+        if (address.ss_family == AF_INET6) {
+            auto& v6 = reinterpret_cast<const sockaddr_in6&>(address);
+            inet_ntop(AF_INET6, &v6.sin6_addr, host, sizeof(host));
+            return fmt::format("[{}]:{}", host, ntohs(v6.sin6_port));
+        }
+
+        auto& v4 = reinterpret_cast<const sockaddr_in&>(address);
+        inet_ntop(AF_INET, &v4.sin_addr, host, sizeof(host));
+        return fmt::format("{}:{}", host, ntohs(v4.sin_port));
+    }
+
+    // a non-blocking socket listening on `address`, sharing its port with the other workers
+    static Result<qsox::SockFd> openListener(const sockaddr_storage& address, socklen_t size, int backlog) {
+        int fd = ::socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return Err(fmt::format("socket failed: {}", std::strerror(errno)));
+        }
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+            ::close(fd);
+            return Err(fmt::format("SO_REUSEPORT failed: {}", std::strerror(errno)));
+        }
+
+        if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), size) != 0) {
+            int code = errno;
+            ::close(fd);
+            return Err(fmt::format("bind failed: {}", std::strerror(code)));
+        }
+
+        if (::listen(fd, backlog) != 0) {
+            int code = errno;
+            ::close(fd);
+            return Err(fmt::format("listen failed: {}", std::strerror(code)));
+        }
+
+        return Ok(fd);
+    }
+
+    Result<std::unique_ptr<Server>> Server::create(ServerOptions options) {
+        if (options.tls && !options.tls->isServer()) {
+            return Err("ServerOptions::tls needs a context from TlsContext::createServer");
+        }
+
+        sockaddr_storage address{};
+        socklen_t addressSize = 0;
+
+        auto& v4 = reinterpret_cast<sockaddr_in&>(address);
+        auto& v6 = reinterpret_cast<sockaddr_in6&>(address);
+
+        if (inet_pton(AF_INET, options.host.c_str(), &v4.sin_addr) == 1) {
+            v4.sin_family = AF_INET;
+            addressSize = sizeof(sockaddr_in);
+        } else if (inet_pton(AF_INET6, options.host.c_str(), &v6.sin6_addr) == 1) {
+            v6.sin6_family = AF_INET6;
+            addressSize = sizeof(sockaddr_in6);
+        } else {
+            return Err(fmt::format("not an IP address: {}", options.host));
+        }
+
+        size_t count = options.workers;
+        if (count == 0) {
+            count = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        auto server = std::unique_ptr<Server>(new Server(std::move(options)));
+        uint16_t port = server->options.port;
+
+        for (size_t i = 0; i < count; ++i) {
+            // the first socket picks the port when asked for any, the others join it
+            if (address.ss_family == AF_INET) {
+                v4.sin_port = htons(port);
+            } else {
+                v6.sin6_port = htons(port);
+            }
+
+            GEODE_UNWRAP_INTO(auto reactor, Reactor::create());
+            GEODE_UNWRAP_INTO(auto listener, openListener(address, addressSize, server->options.backlog));
+
+            // owned from here on, so an error below closes it
+            server->workers.push_back(std::make_unique<ServerWorker>(*server, std::move(reactor), listener));
+
+            if (port == 0) {
+                sockaddr_storage bound{};
+                socklen_t boundSize = sizeof(bound);
+                getsockname(listener, reinterpret_cast<sockaddr*>(&bound), &boundSize);
+
+                port = ntohs(bound.ss_family == AF_INET6
+                    ? reinterpret_cast<sockaddr_in6&>(bound).sin6_port
+                    : reinterpret_cast<sockaddr_in&>(bound).sin_port);
+            }
+        }
+
+        server->boundPort = port;
+        return Ok(std::move(server));
+    }
+
+    void Server::acceptConnections(ServerWorker& worker) {
+        while (running.load(std::memory_order_relaxed)) {
+            sockaddr_storage address{};
+            socklen_t addressSize = sizeof(address);
+
+            int fd = ::accept4(worker.listener, reinterpret_cast<sockaddr*>(&address), &addressSize, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                int code = errno;
+                if (code == EINTR || code == ECONNABORTED) {
+                    continue;
+                }
+
+                // out of descriptors and the like; the listener stays readable, so this is tried again
+                if (!isWouldBlock(code)) {
+                    LOG_ERROR("accept failed: {}", std::strerror(code));
+                }
+
+                return;
+            }
+
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            auto connection = std::shared_ptr<ServerConnection>(new ServerConnection(
+                *this, worker, nextConnectionId.fetch_add(1, std::memory_order_relaxed), formatAddress(address)
+            ));
+
+            if (options.tls) {
+                auto tls = TlsTransport::accept(fd, options.tls);
+                if (tls.isErr()) {
+                    LOG_ERROR("unable to set up TLS for {}: {}", connection->remote, tls.unwrapErr());
+                    continue;
+                }
+
+                connection->tlsPending = tls.unwrap();
+                connection->stream = connection->tlsPending;
+                connection->phase = ServerConnection::Phase::TlsHandshake;
+            } else {
+                connection->stream = std::make_shared<TcpTransport>(fd);
+            }
+
+            connection->stream->setMetrics(connection->counters.get());
+            connection->attach();
+        }
+    }
+
+#else
+
+    Result<std::unique_ptr<Server>> Server::create(ServerOptions) {
+        return Err("Server is only available on Linux");
+    }
+
+    void Server::acceptConnections(ServerWorker&) {}
+
+#endif
+
+    Result<> Server::start() {
+        if (running.exchange(true)) {
+            return Ok();
+        }
+
+        for (auto& worker : workers) {
+            GEODE_UNWRAP(worker->reactor->add(worker.get(), worker->listener, false));
+            worker->reactor->start();
+        }
+
+        return Ok();
+    }
+
+    void Server::stop() {
+        if (!running.exchange(false)) {
+            return;
+        }
+
+        for (auto& worker : workers) {
+            worker->reactor->stop();
+        }
+
+        // the workers are gone, so nothing else touches the connections now
+        for (auto& worker : workers) {
+            std::unordered_map<uint64_t, std::shared_ptr<ServerConnection>> connections;
+            {
+                std::lock_guard lock(worker->mutex);
+                connections.swap(worker->connections);
+            }
+
+            for (auto& [id, connection] : connections) {
+                connection->finish();
+            }
+        }
+    }
+
+    size_t Server::connectionCount() {
+        size_t total = 0;
+
+        for (auto& worker : workers) {
+            std::lock_guard lock(worker->mutex);
+            total += worker->connections.size();
+        }
+
+        return total;
+    }
+
+    void Server::broadcast(std::string_view data) {
+        this->broadcast(std::as_bytes(std::span(data)), Opcode::Text);
+    }
+
+    void Server::broadcast(std::span<const std::byte> data, Opcode opcode) {
+        auto frame = encodeFrame(options.memory, opcode, {reinterpret_cast<const uint8_t*>(data.data()), data.size()});
+        std::vector<uint64_t> ids;
+
+        for (auto& worker : workers) {
+            ids.clear();
+
+            {
+                std::lock_guard lock(worker->mutex);
+                ids.reserve(worker->connections.size());
+
+                for (auto& [id, connection] : worker->connections) {
+                    if (connection->queue(frame, opcode, false)) {
+                        ids.push_back(connection->reactorId);
+                    }
+                }
+            }
+
+            worker->reactor->requestFlush(ids);
+        }
+    }
+
+    void Server::broadcast(std::span<const std::shared_ptr<ServerConnection>> targets, std::span<const std::byte> data, Opcode opcode) {
+        auto frame = encodeFrame(options.memory, opcode, {reinterpret_cast<const uint8_t*>(data.data()), data.size()});
+        std::vector<uint64_t> ids;
+
+        // one wakeup per worker, however many of its connections are targeted
+        for (auto& worker : workers) {
+            ids.clear();
+
+            for (auto& connection : targets) {
+                if (&connection->worker == worker.get() && connection->queue(frame, opcode, false)) {
+                    ids.push_back(connection->reactorId);
+                }
+            }
+
+            worker->reactor->requestFlush(ids);
+        }
+    }
+
+    void Server::writeLog(LogSeverity severity, std::string_view source, std::string_view message, uint64_t connectionId) {
+        logCallback(LogRecord{
+            .severity = severity,
+            .connectionId = connectionId,
+            .source = source,
+            .message = message
+        });
+    }
+}
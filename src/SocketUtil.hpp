@@ -0,0 +1,137 @@
+#pragma once
+
+#include <qsox/BaseSocket.hpp>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+# include <winsock2.h>
+# include <ws2tcpip.h>
+#else
+# include <arpa/inet.h>
+# include <cerrno>
+# include <climits>
+# include <cstring>
+# include <fcntl.h>
+# include <poll.h>
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+namespace ws {
+
+#ifdef MSG_NOSIGNAL
+constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+constexpr int SendFlags = 0;
+#endif
+
+// buffers handed to one gathered write; a frame takes two (header and payload), so a batch of
+// more than half this many frames is split across writes
+#ifdef IOV_MAX
+constexpr size_t MaxGatherBuffers = IOV_MAX;
+#else
+constexpr size_t MaxGatherBuffers = 1024;
+#endif
+
+// length type taken by send()/recv() on this platform
+#ifdef _WIN32
+using IoSize = int;
+#else
+using IoSize = size_t;
+#endif
+
+inline void closeSocket(qsox::SockFd socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+inline int lastSocketErrorCode() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+inline bool isWouldBlock(int code) {
+#ifdef _WIN32
+    return code == WSAEWOULDBLOCK;
+#else
+    return code == EAGAIN || code == EWOULDBLOCK;
+#endif
+}
+
+inline int pollSockets(pollfd* fds, size_t count, int timeoutMs) {
+#ifdef _WIN32
+    return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+#else
+    return ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+#endif
+}
+
+inline bool setSocketNonBlocking(qsox::SockFd socket, bool enabled) {
+#ifdef _WIN32
+    u_long mode = enabled ? 1 : 0;
+    return ioctlsocket(socket, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags < 0) {
+        return false;
+    }
+
+    flags = enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(socket, F_SETFL, flags) == 0;
+#endif
+}
+
+// both directions; a thread blocked reading or waiting on the socket wakes up
+inline bool shutdownSocket(qsox::SockFd socket) {
+#ifdef _WIN32
+    return ::shutdown(socket, SD_BOTH) == 0;
+#else
+    return ::shutdown(socket, SHUT_RDWR) == 0;
+#endif
+}
+
+// blocking reads and writes give up after `timeout`, zero waits forever
+inline bool setSocketTimeout(qsox::SockFd socket, std::chrono::milliseconds timeout) {
+#ifdef _WIN32
+    DWORD value = static_cast<DWORD>(timeout.count());
+    auto data = reinterpret_cast<const char*>(&value);
+#else
+    timeval value{};
+    value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    value.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+    auto data = &value;
+#endif
+
+    return setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, data, sizeof(value)) == 0
+        && setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, data, sizeof(value)) == 0;
+}
+
+inline std::string socketErrorMessage(int code) {
+#ifdef _WIN32
+    char buffer[256];
+    FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, code, 0, buffer, sizeof(buffer), nullptr);
+    return buffer;
+#else
+    return std::strerror(code);
+#endif
+}
+
+inline std::string lastSocketError() {
+    return socketErrorMessage(lastSocketErrorCode());
+}
+
+inline bool isIpLiteral(std::string_view host) {
+    std::string str(host);
+    in6_addr addr;
+    return inet_pton(AF_INET, str.c_str(), &addr) == 1 || inet_pton(AF_INET6, str.c_str(), &addr) == 1;
+}
+
+}
@@ -0,0 +1,42 @@
+#include <Task.hpp>
+#include <Reactor.hpp>
+
+namespace ws {
+
+namespace {
+    // owns the task it runs and frees itself when done, so nobody has to hold on to it
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() {
+                return {std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+
+            // held until the reactor resumes it on its own thread
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            std::suspend_never final_suspend() noexcept {
+                return {};
+            }
+
+            void return_void() {}
+
+            void unhandled_exception() noexcept {
+                std::terminate();
+            }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    Detached runDetached(Task<> task) {
+        co_await std::move(task);
+    }
+}
+
+void spawn(Reactor& reactor, Task<> task) {
+    reactor.post(runDetached(std::move(task)).handle);
+}
+
+}
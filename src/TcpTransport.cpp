@@ -1,29 +1,137 @@
 #include "TcpTransport.hpp"
+#include "SocketUtil.hpp"
+
+#include <algorithm>
+
+#ifdef _WIN32
+# include <winsock2.h>
+#else
+# include <sys/socket.h>
+# include <sys/uio.h>
+#endif
 
 using namespace geode;
 
 namespace ws {
 
-template <typename T>
-auto mapResult(T&& res) {
-    return std::forward<T>(res).mapErr([](const auto& err) { return std::string{err.message()}; });
-}
-
-Result<std::shared_ptr<BaseTransport>> TcpTransport::connect(const qsox::SocketAddress& address) {
-    GEODE_UNWRAP_INTO(auto stream, mapResult(qsox::TcpStream::connect(address)));
-    return Ok(std::make_shared<TcpTransport>(std::move(stream)));
+TcpTransport::~TcpTransport() {
+    if (fd != qsox::BaseSocket::InvalidSockFd) {
+        closeSocket(fd);
+    }
 }
 
 Result<size_t> TcpTransport::send(const void* data, size_t size) {
-    return mapResult(stream.send(data, size));
+    auto sent = ::send(fd, static_cast<const char*>(data), static_cast<IoSize>(size), SendFlags);
+    this->countWrite(sent > 0 ? static_cast<size_t>(sent) : 0);
+
+    if (sent < 0) {
+        return Err(lastSocketError());
+    }
+
+    return Ok(static_cast<size_t>(sent));
 }
 
 Result<size_t> TcpTransport::receive(void* buffer, size_t size) {
-    return mapResult(stream.receive(buffer, size));
+    auto received = ::recv(fd, static_cast<char*>(buffer), static_cast<IoSize>(size), 0);
+    this->countRead(received > 0 ? static_cast<size_t>(received) : 0);
+
+    if (received < 0) {
+        return Err(lastSocketError());
+    }
+
+    return Ok(static_cast<size_t>(received));
+}
+
+// returns the raw result of the gathered write, negative on error
+static int64_t gatherSend(qsox::SockFd fd, std::span<const ConstBuffer> buffers) {
+    size_t count = std::min(buffers.size(), MaxGatherBuffers);
+
+#ifdef _WIN32
+    WSABUF wsaBuffers[MaxGatherBuffers];
+    for (size_t i = 0; i < count; ++i) {
+        wsaBuffers[i].buf = static_cast<CHAR*>(const_cast<void*>(buffers[i].data));
+        wsaBuffers[i].len = static_cast<ULONG>(buffers[i].size);
+    }
+
+    DWORD sent = 0;
+    if (WSASend(fd, wsaBuffers, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr) != 0) {
+        return -1;
+    }
+
+    return static_cast<int64_t>(sent);
+#else
+    iovec iov[MaxGatherBuffers];
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<void*>(buffers[i].data);
+        iov[i].iov_len = buffers[i].size;
+    }
+
+    // sendmsg rather than writev so SIGPIPE can be suppressed per call
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = count;
+
+    return ::sendmsg(fd, &message, SendFlags);
+#endif
+}
+
+Result<size_t> TcpTransport::sendv(std::span<const ConstBuffer> buffers) {
+    auto sent = gatherSend(fd, buffers);
+    this->countWrite(sent > 0 ? static_cast<size_t>(sent) : 0);
+
+    if (sent < 0) {
+        return Err(lastSocketError());
+    }
+
+    return Ok(static_cast<size_t>(sent));
+}
+
+Result<> TcpTransport::setNonBlocking(bool enabled) {
+    if (!setSocketNonBlocking(fd, enabled)) {
+        return Err(lastSocketError());
+    }
+
+    return Ok();
+}
+
+Result<std::optional<size_t>> TcpTransport::tryReceive(void* buffer, size_t size) {
+    auto received = ::recv(fd, static_cast<char*>(buffer), static_cast<IoSize>(size), 0);
+    this->countRead(received > 0 ? static_cast<size_t>(received) : 0);
+
+    if (received < 0) {
+        int code = lastSocketErrorCode();
+        if (isWouldBlock(code)) {
+            return Ok(std::nullopt);
+        }
+
+        return Err(socketErrorMessage(code));
+    }
+
+    return Ok(std::optional<size_t>{static_cast<size_t>(received)});
+}
+
+Result<std::optional<size_t>> TcpTransport::trySendv(std::span<const ConstBuffer> buffers) {
+    auto sent = gatherSend(fd, buffers);
+    this->countWrite(sent > 0 ? static_cast<size_t>(sent) : 0);
+
+    if (sent < 0) {
+        int code = lastSocketErrorCode();
+        if (isWouldBlock(code)) {
+            return Ok(std::nullopt);
+        }
+
+        return Err(socketErrorMessage(code));
+    }
+
+    return Ok(std::optional<size_t>{static_cast<size_t>(sent)});
 }
 
 Result<> TcpTransport::shutdown() {
-    return mapResult(stream.shutdown(qsox::ShutdownMode::Both));
+    if (!shutdownSocket(fd)) {
+        return Err(lastSocketError());
+    }
+
+    return Ok();
 }
 
-}
\ No newline at end of file
+}
@@ -1,23 +1,37 @@
 #pragma once
 
 #include <BaseTransport.hpp>
-#include <qsox/TcpStream.hpp>
+#include <qsox/BaseSocket.hpp>
 #include <memory>
 
 namespace ws {
 
+// Owns the socket directly (like TlsSession does) so it can use gathered writes.
 class TcpTransport : public BaseTransport {
 public:
-    static geode::Result<std::shared_ptr<BaseTransport>> connect(const qsox::SocketAddress& address);
-
     geode::Result<size_t> send(const void* data, size_t size) override;
     geode::Result<size_t> receive(void* buffer, size_t size) override;
     geode::Result<> shutdown() override;
 
-    TcpTransport(qsox::TcpStream&& stream) : stream(std::move(stream)) {}
+    geode::Result<size_t> sendv(std::span<const ConstBuffer> buffers) override;
+
+    intptr_t nativeHandle() const override {
+        return static_cast<intptr_t>(fd);
+    }
+
+    geode::Result<> setNonBlocking(bool enabled) override;
+    geode::Result<std::optional<size_t>> tryReceive(void* buffer, size_t size) override;
+    geode::Result<std::optional<size_t>> trySendv(std::span<const ConstBuffer> buffers) override;
+
+    // takes ownership of a connected socket
+    explicit TcpTransport(qsox::SockFd fd) : fd(fd) {}
+    ~TcpTransport() override;
+
+    TcpTransport(const TcpTransport&) = delete;
+    TcpTransport& operator=(const TcpTransport&) = delete;
 
 private:
-    qsox::TcpStream stream;
+    qsox::SockFd fd;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,145 @@
+#include <TlsContext.hpp>
+
+#include <wolfssl/options.h>
+#include <wolfssl/ssl.h>
+
+using namespace geode;
+
+namespace ws {
+
+static std::string errorString(unsigned long code) {
+    char buffer[WOLFSSL_MAX_ERROR_SZ];
+    return wolfSSL_ERR_error_string(code, buffer);
+}
+
+Result<std::shared_ptr<TlsContext>> TlsContext::create(TlsOptions options) {
+    auto ctx = wolfSSL_CTX_new(wolfTLSv1_3_client_method());
+
+    if (!ctx) {
+        return Err(errorString(wolfSSL_ERR_get_error()));
+    }
+
+    if (options.verifyPeer) {
+        int res = options.caFile.empty()
+            ? wolfSSL_CTX_set_default_verify_paths(ctx)
+            : wolfSSL_CTX_load_verify_locations(ctx, options.caFile.c_str(), nullptr);
+
+        if (res != WOLFSSL_SUCCESS) {
+            wolfSSL_CTX_free(ctx);
+            return Err(errorString(wolfSSL_ERR_get_error()));
+        }
+
+        wolfSSL_CTX_set_verify(ctx, WOLFSSL_VERIFY_PEER, nullptr);
+    } else {
+        wolfSSL_CTX_set_verify(ctx, WOLFSSL_VERIFY_NONE, nullptr);
+    }
+
+    return Ok(std::shared_ptr<TlsContext>(new TlsContext(ctx, std::move(options))));
+}
+
+Result<std::shared_ptr<TlsContext>> TlsContext::createServer(TlsServerOptions options) {
+    auto ctx = wolfSSL_CTX_new(wolfTLSv1_3_server_method());
+
+    if (!ctx) {
+        return Err(errorString(wolfSSL_ERR_get_error()));
+    }
+
+    if (wolfSSL_CTX_use_certificate_chain_file(ctx, options.certFile.c_str()) != WOLFSSL_SUCCESS
+        || wolfSSL_CTX_use_PrivateKey_file(ctx, options.keyFile.c_str(), WOLFSSL_FILETYPE_PEM) != WOLFSSL_SUCCESS
+    ) {
+        wolfSSL_CTX_free(ctx);
+        return Err(errorString(wolfSSL_ERR_get_error()));
+    }
+
+    // no client certificates, and the server keeps no client session cache
+    wolfSSL_CTX_set_verify(ctx, WOLFSSL_VERIFY_NONE, nullptr);
+
+    TlsOptions serverOptions;
+    serverOptions.sessionCacheSize = 0;
+
+    return Ok(std::shared_ptr<TlsContext>(new TlsContext(ctx, std::move(serverOptions), true)));
+}
+
+Result<std::shared_ptr<TlsContext>> TlsContext::shared() {
+    static std::mutex mutex;
+    static std::shared_ptr<TlsContext> context;
+
+    std::lock_guard lock(mutex);
+
+    if (!context) {
+        GEODE_UNWRAP_INTO(context, TlsContext::create());
+    }
+
+    return Ok(context);
+}
+
+TlsContext::~TlsContext() {
+    this->clearSessions();
+    wolfSSL_CTX_free(ctx);
+}
+
+void TlsContext::clearSessions() {
+    std::lock_guard lock(sessionMutex);
+
+    for (auto& [key, session] : sessions) {
+        wolfSSL_SESSION_free(session);
+    }
+
+    sessions.clear();
+    sessionOrder.clear();
+}
+
+size_t TlsContext::resumeSession(WOLFSSL* ssl, const std::string& key) {
+    std::lock_guard lock(sessionMutex);
+
+    auto it = sessions.find(key);
+    if (it == sessions.end()) {
+        return 0;
+    }
+
+    // copies the session into ssl; if the server declines it we just get a full handshake
+    if (wolfSSL_set_session(ssl, it->second) != WOLFSSL_SUCCESS) {
+        return 0;
+    }
+
+#ifdef WOLFSSL_EARLY_DATA
+    return static_cast<size_t>(wolfSSL_SESSION_get_max_early_data(it->second));
+#else
+    return 0;
+#endif
+}
+
+void TlsContext::storeSession(WOLFSSL* ssl, const std::string& key) {
+    if (opts.sessionCacheSize == 0) {
+        return;
+    }
+
+    WOLFSSL_SESSION* session = wolfSSL_get1_session(ssl);
+    if (!session) {
+        return;
+    }
+
+    std::lock_guard lock(sessionMutex);
+
+    auto it = sessions.find(key);
+    if (it != sessions.end()) {
+        wolfSSL_SESSION_free(it->second);
+        it->second = session;
+        return;
+    }
+
+    while (sessions.size() >= opts.sessionCacheSize && !sessionOrder.empty()) {
+        auto oldest = sessions.find(sessionOrder.front());
+        if (oldest != sessions.end()) {
+            wolfSSL_SESSION_free(oldest->second);
+            sessions.erase(oldest);
+        }
+
+        sessionOrder.pop_front();
+    }
+
+    sessions.emplace(key, session);
+    sessionOrder.push_back(key);
+}
+
+}
@@ -1,7 +1,10 @@
 #include "TlsSession.hpp"
+#include "SocketUtil.hpp"
 
 #include <wolfssl/options.h>
 #include <wolfssl/ssl.h>
+#include <fmt/format.h>
+#include <algorithm>
 
 using namespace geode;
 
@@ -12,21 +15,14 @@ std::string_view TlsError::message() const {
     return wolfSSL_ERR_error_string(code, buffer);
 }
 
-inline void closeSocket(auto socket) {
-#ifdef _WIN32
-    closesocket(socket);
-#else
-    close(socket);
-#endif
-}
-
 TlsSession::~TlsSession() {
     if (ssl) {
-        wolfSSL_free(ssl);
-    }
+        // TLS 1.3 tickets arrive after the handshake, so the session is saved again on the way out
+        if (established) {
+            context->storeSession(ssl, sessionKey);
+        }
 
-    if (ctx) {
-        wolfSSL_CTX_free(ctx);
+        wolfSSL_free(ssl);
     }
 
     if (fd != qsox::BaseSocket::InvalidSockFd) {
@@ -40,11 +36,13 @@ TlsSession::TlsSession(TlsSession&& other) {
 
 TlsSession& TlsSession::operator=(TlsSession&& other) {
     if (this != &other) {
-        ctx = other.ctx;
+        context = std::move(other.context);
         ssl = other.ssl;
         fd = other.fd;
+        sessionKey = std::move(other.sessionKey);
+        established = other.established;
+        maxEarlyData = other.maxEarlyData;
 
-        other.ctx = nullptr;
         other.ssl = nullptr;
         other.fd = qsox::BaseSocket::InvalidSockFd;
     }
@@ -52,49 +50,108 @@ TlsSession& TlsSession::operator=(TlsSession&& other) {
     return *this;
 }
 
-TlsResult<TlsSession> TlsSession::create(qsox::TcpStream&& stream, bool insecure) {
-    auto ctx = wolfSSL_CTX_new(wolfTLSv1_3_client_method());
-
-    if (!ctx) {
+TlsResult<TlsSession> TlsSession::create(qsox::SockFd fd, std::shared_ptr<TlsContext> context, std::string_view host, uint16_t port) {
+    auto ssl = wolfSSL_new(context->ctx);
+    if (!ssl) {
+        closeSocket(fd);
         return Err(wolfSSL_ERR_get_error());
     }
 
-    if (insecure) {
-        wolfSSL_CTX_set_verify(ctx, WOLFSSL_VERIFY_NONE, nullptr);
-    } else {
-        // TODO: proper cert handling
-        if (wolfSSL_CTX_set_default_verify_paths(ctx) != WOLFSSL_SUCCESS) {
-            wolfSSL_CTX_free(ctx);
-            return Err(wolfSSL_ERR_get_error());
-        }
+    TlsSession session{std::move(context), ssl};
+
+    session.fd = fd;
+    wolfSSL_set_fd(session.ssl, static_cast<int>(fd));
 
-        wolfSSL_CTX_set_verify(ctx, WOLFSSL_VERIFY_PEER, nullptr);
+    // servers hosting several names pick the certificate (and ticket keys) by SNI, which must not be an IP
+    if (!isIpLiteral(host)) {
+        wolfSSL_UseSNI(session.ssl, WOLFSSL_SNI_HOST_NAME, host.data(), static_cast<unsigned short>(host.size()));
     }
 
-    // Create session
-    auto ssl = wolfSSL_new(ctx);
+    session.sessionKey = fmt::format("{}:{}", host, port);
+    session.maxEarlyData = session.context->resumeSession(session.ssl, session.sessionKey);
+
+    return Ok(std::move(session));
+}
+
+static bool wouldBlock(int error) {
+    return error == WOLFSSL_ERROR_WANT_READ || error == WOLFSSL_ERROR_WANT_WRITE;
+}
+
+TlsResult<TlsSession> TlsSession::accept(qsox::SockFd fd, std::shared_ptr<TlsContext> context) {
+    auto ssl = wolfSSL_new(context->ctx);
     if (!ssl) {
-        wolfSSL_CTX_free(ctx);
+        closeSocket(fd);
         return Err(wolfSSL_ERR_get_error());
     }
 
-    TlsSession session{ctx, ssl};
+    TlsSession session{std::move(context), ssl};
 
-    auto fd = stream.releaseHandle();
+    session.fd = fd;
     wolfSSL_set_fd(session.ssl, static_cast<int>(fd));
 
-    // TODO: sni
-
     return Ok(std::move(session));
 }
 
-TlsResult<> TlsSession::handshake() {
+TlsResult<size_t> TlsSession::handshake([[maybe_unused]] std::span<const uint8_t> earlyData) {
+    size_t earlySent = 0;
+
+#ifdef WOLFSSL_EARLY_DATA
+    if (!earlyData.empty() && maxEarlyData > 0) {
+        // sends the ClientHello followed by as much early data as the ticket allows
+        int written = 0;
+        int size = static_cast<int>(std::min(earlyData.size(), maxEarlyData));
+
+        if (wolfSSL_write_early_data(ssl, earlyData.data(), size, &written) < 0) {
+            return Err(wolfSSL_ERR_get_error());
+        }
+
+        earlySent = static_cast<size_t>(written);
+    }
+#endif
+
     int res = wolfSSL_connect(ssl);
     if (res != WOLFSSL_SUCCESS) {
         return Err(wolfSSL_ERR_get_error());
     }
 
-    return Ok();
+    established = true;
+    context->storeSession(ssl, sessionKey);
+
+#ifdef WOLFSSL_EARLY_DATA
+    // a rejected attempt is not an error, the data just has to go out again as normal application data
+    if (earlySent > 0 && wolfSSL_get_early_data_status(ssl) != WOLFSSL_EARLY_DATA_ACCEPTED) {
+        earlySent = 0;
+    }
+#endif
+
+    return Ok(earlySent);
+}
+
+TlsResult<bool> TlsSession::tryAccept() {
+    int res = wolfSSL_accept(ssl);
+    if (res == WOLFSSL_SUCCESS) {
+        return Ok(true);
+    }
+
+    int error = wolfSSL_get_error(ssl, res);
+    if (wouldBlock(error)) {
+        return Ok(false);
+    }
+
+    return Err(static_cast<unsigned long>(error));
+}
+
+bool TlsSession::resumed() const {
+    return ssl && wolfSSL_session_reused(ssl) == 1;
+}
+
+size_t TlsSession::bufferedInput() const {
+    if (!ssl) {
+        return 0;
+    }
+
+    int pending = wolfSSL_pending(ssl);
+    return pending > 0 ? static_cast<size_t>(pending) : 0;
 }
 
 TlsResult<size_t> TlsSession::send(const void* data, size_t size) {
@@ -115,6 +172,39 @@ TlsResult<size_t> TlsSession::receive(void* buffer, size_t size) {
     return Ok(static_cast<size_t>(res));
 }
 
+TlsResult<std::optional<size_t>> TlsSession::trySend(const void* data, size_t size) {
+    int res = wolfSSL_write(ssl, data, static_cast<int>(size));
+    if (res < 0) {
+        int error = wolfSSL_get_error(ssl, res);
+        if (wouldBlock(error)) {
+            return Ok(std::nullopt);
+        }
+
+        return Err(static_cast<unsigned long>(error));
+    }
+
+    return Ok(std::optional<size_t>{static_cast<size_t>(res)});
+}
+
+TlsResult<std::optional<size_t>> TlsSession::tryReceive(void* buffer, size_t size) {
+    int res = wolfSSL_read(ssl, buffer, static_cast<int>(size));
+    if (res <= 0) {
+        int error = wolfSSL_get_error(ssl, res);
+        if (wouldBlock(error)) {
+            return Ok(std::nullopt);
+        }
+
+        // clean close_notify from the peer
+        if (res == 0 || error == WOLFSSL_ERROR_ZERO_RETURN) {
+            return Ok(std::optional<size_t>{0});
+        }
+
+        return Err(static_cast<unsigned long>(error));
+    }
+
+    return Ok(std::optional<size_t>{static_cast<size_t>(res)});
+}
+
 TlsResult<> TlsSession::shutdown() {
     int res = wolfSSL_shutdown(ssl);
     if (res != WOLFSSL_SUCCESS) {
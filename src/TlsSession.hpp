@@ -1,8 +1,11 @@
 #pragma once
 
 #include <Geode/Result.hpp>
+#include <TlsContext.hpp>
+#include <memory>
+#include <optional>
+#include <span>
 #include <qsox/BaseSocket.hpp>
-#include <qsox/TcpStream.hpp>
 
 struct WOLFSSL_CTX;
 struct WOLFSSL;
@@ -22,11 +25,16 @@ using TlsResult = geode::Result<T, TlsError>;
 
 class TlsSession {
 public:
-    WOLFSSL_CTX* ctx = nullptr;
+    std::shared_ptr<TlsContext> context;
     WOLFSSL* ssl = nullptr;
     qsox::SockFd fd = qsox::BaseSocket::InvalidSockFd;
 
-    static TlsResult<TlsSession> create(qsox::TcpStream&& stream, bool insecure);
+    // `host` is sent as SNI and, together with `port`, keys the context's session cache
+    // takes ownership of a connected socket
+    static TlsResult<TlsSession> create(qsox::SockFd fd, std::shared_ptr<TlsContext> context, std::string_view host, uint16_t port);
+    // the server side of an accepted socket, `context` comes from TlsContext::createServer.
+    // takes ownership of the socket
+    static TlsResult<TlsSession> accept(qsox::SockFd fd, std::shared_ptr<TlsContext> context);
     ~TlsSession();
 
     TlsSession(const TlsSession&) = delete;
@@ -34,14 +42,35 @@ public:
     TlsSession(TlsSession&&);
     TlsSession& operator=(TlsSession&&);
 
-    TlsResult<> handshake();
+    // Early data is sent as TLS 1.3 0-RTT data when the resumed session allows it, otherwise it is
+    // left alone. Returns how many of its bytes the server accepted; the rest (all of it if the server
+    // rejected 0-RTT) must be sent normally afterwards.
+    // 0-RTT data can be replayed by an attacker, so it should only carry requests that are safe to repeat
+    TlsResult<size_t> handshake(std::span<const uint8_t> earlyData = {});
+    // Server side, for non-blocking sockets: advances the handshake as far as the socket allows.
+    // true once it is complete, false while it waits for the client
+    TlsResult<bool> tryAccept();
+    // whether the last handshake resumed a cached session instead of doing a full one
+    bool resumed() const;
 
     TlsResult<size_t> send(const void* data, size_t size);
     TlsResult<size_t> receive(void* buffer, size_t size);
+
+    // for non-blocking sockets: std::nullopt when wolfSSL wants to read or write first.
+    // a write that returned std::nullopt must be retried with the same data
+    TlsResult<std::optional<size_t>> trySend(const void* data, size_t size);
+    TlsResult<std::optional<size_t>> tryReceive(void* buffer, size_t size);
     TlsResult<> shutdown();
 
+    // decrypted bytes waiting to be read, which the socket no longer signals
+    size_t bufferedInput() const;
+
 private:
-    TlsSession(WOLFSSL_CTX* ctx, WOLFSSL* ssl) : ctx(ctx), ssl(ssl) {}
+    TlsSession(std::shared_ptr<TlsContext> context, WOLFSSL* ssl) : context(std::move(context)), ssl(ssl) {}
+
+    std::string sessionKey;
+    bool established = false;
+    size_t maxEarlyData = 0;
 };
 
 }
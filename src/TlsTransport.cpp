@@ -1,4 +1,7 @@
 #include "TlsTransport.hpp"
+#include "SocketUtil.hpp"
+
+#include <cstring>
 
 using namespace geode;
 
@@ -9,24 +12,211 @@ auto mapResult(T&& res) {
     return std::forward<T>(res).mapErr([](const auto& err) { return std::string{err.message()}; });
 }
 
-Result<std::shared_ptr<BaseTransport>> TlsTransport::connect(const qsox::SocketAddress& address) {
-    GEODE_UNWRAP_INTO(auto stream, mapResult(qsox::TcpStream::connect(address)));
-    GEODE_UNWRAP_INTO(auto session, mapResult(TlsSession::create(std::move(stream), true)));
-    GEODE_UNWRAP(mapResult(session.handshake()));
+Result<std::shared_ptr<TlsTransport>> TlsTransport::connect(
+    qsox::SockFd fd, std::string_view host, uint16_t port, std::shared_ptr<TlsContext> context,
+    std::span<const uint8_t> earlyData, std::chrono::milliseconds handshakeTimeout
+) {
+    GEODE_UNWRAP_INTO(auto session, mapResult(TlsSession::create(fd, std::move(context), host, port)));
+
+    std::unique_ptr<KernelTls> kernel;
+    std::string kernelFallback;
+
+    if (session.context->options().kernelOffload) {
+        auto res = KernelTls::capture(session.ssl, session.fd);
+        if (res.isOk()) {
+            kernel = std::move(res).unwrap();
+        } else {
+            kernelFallback = std::move(res).unwrapErr();
+        }
+    }
+
+    // the handshake blocks inside wolfSSL, where nothing else can wake it; a silent peer must not hold it forever
+    if (!setSocketTimeout(session.fd, handshakeTimeout)) {
+        return Err(lastSocketError());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    GEODE_UNWRAP_INTO(size_t accepted, mapResult(session.handshake(earlyData)));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    (void) setSocketTimeout(session.fd, {});
+
+    if (kernel) {
+        auto res = kernel->install(session.ssl);
+        if (res.isErr()) {
+            kernelFallback = std::move(res).unwrapErr();
+        }
+    }
 
+    // blocking calls wait in poll() instead, so they never sit inside wolfSSL while holding the lock
+    if (!setSocketNonBlocking(session.fd, true)) {
+        return Err(lastSocketError());
+    }
+
+    auto transport = std::make_shared<TlsTransport>(std::move(session));
+    transport->kernel = std::move(kernel);
+    transport->kernelFallback = std::move(kernelFallback);
+    transport->handshakeDuration = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+    transport->earlyAccepted = accepted;
+
+    return Ok(std::move(transport));
+}
+
+Result<std::shared_ptr<TlsTransport>> TlsTransport::accept(qsox::SockFd fd, std::shared_ptr<TlsContext> context) {
+    GEODE_UNWRAP_INTO(auto session, mapResult(TlsSession::accept(fd, std::move(context))));
     return Ok(std::make_shared<TlsTransport>(std::move(session)));
 }
 
+Result<bool> TlsTransport::tryAccept() {
+    std::lock_guard lock(sessionMutex);
+    return mapResult(session.tryAccept());
+}
+
+bool TlsTransport::hasPendingOutput() const {
+    std::lock_guard lock(sessionMutex);
+    return writePending;
+}
+
+bool TlsTransport::hasPendingInput() const {
+    std::lock_guard lock(sessionMutex);
+    return session.bufferedInput() > 0;
+}
+
+Result<> TlsTransport::waitSocket(short events) {
+    pollfd fd{session.fd, events, 0};
+
+    while (pollSockets(&fd, 1, -1) < 0) {
+        if (lastSocketErrorCode() != EINTR) {
+            return Err(lastSocketError());
+        }
+    }
+
+    return Ok();
+}
+
 Result<size_t> TlsTransport::send(const void* data, size_t size) {
-    return mapResult(session.send(data, size));
+    ConstBuffer buffer{data, size};
+    return this->sendv({&buffer, 1});
 }
 
 Result<size_t> TlsTransport::receive(void* buffer, size_t size) {
-    return mapResult(session.receive(buffer, size));
+    while (true) {
+        GEODE_UNWRAP_INTO(auto received, this->tryReceive(buffer, size));
+        if (received) {
+            return Ok(*received);
+        }
+
+        GEODE_UNWRAP(this->waitSocket(POLLIN));
+    }
+}
+
+static size_t coalesce(std::vector<uint8_t>& out, std::span<const ConstBuffer> buffers) {
+    size_t total = 0;
+    for (auto& buffer : buffers) {
+        total += buffer.size;
+    }
+
+    out.resize(total);
+
+    size_t offset = 0;
+    for (auto& buffer : buffers) {
+        std::memcpy(out.data() + offset, buffer.data, buffer.size);
+        offset += buffer.size;
+    }
+
+    return total;
+}
+
+Result<size_t> TlsTransport::sendv(std::span<const ConstBuffer> buffers) {
+    std::optional<size_t> taken;
+
+    while (true) {
+        GEODE_UNWRAP_INTO(taken, this->trySendv(buffers));
+        if (taken) {
+            break;
+        }
+
+        GEODE_UNWRAP(this->waitSocket(POLLOUT));
+    }
+
+    // like a blocking write, return once the record is on its way rather than held by wolfSSL
+    while (this->hasPendingOutput()) {
+        GEODE_UNWRAP(this->waitSocket(POLLOUT));
+        GEODE_UNWRAP(this->trySendv({}));
+    }
+
+    return Ok(*taken);
+}
+
+Result<> TlsTransport::setNonBlocking(bool) {
+    // the socket always is, see connect(); only the blocking calls wait
+    return Ok();
+}
+
+Result<std::optional<size_t>> TlsTransport::tryReceive(void* buffer, size_t size) {
+    if (kernel && kernel->receiving()) {
+        GEODE_UNWRAP_INTO(auto received, kernel->receive(buffer, size));
+        this->countRead(received.value_or(0));
+        return Ok(received);
+    }
+
+    std::lock_guard lock(sessionMutex);
+    auto res = mapResult(session.tryReceive(buffer, size));
+    this->countRead(res.isOk() ? res.unwrap().value_or(0) : 0);
+    return res;
+}
+
+Result<std::optional<size_t>> TlsTransport::trySendv(std::span<const ConstBuffer> buffers) {
+    // the kernel cuts records itself, so the buffers go out as they are
+    if (kernel && kernel->sending()) {
+        GEODE_UNWRAP_INTO(auto sent, kernel->send(buffers));
+        this->countWrite(sent.value_or(0));
+        return Ok(sent);
+    }
+
+    std::lock_guard lock(sessionMutex);
+
+    // finish the record wolfSSL is still holding before taking anything new
+    if (writePending) {
+        GEODE_UNWRAP_INTO(auto sent, mapResult(session.trySend(writeBuffer.data(), writeBuffer.size())));
+        // its bytes were counted when wolfSSL first took them
+        this->countWrite(0);
+
+        if (!sent) {
+            return Ok(std::nullopt);
+        }
+
+        writePending = false;
+    }
+
+    size_t total = coalesce(writeBuffer, buffers);
+    if (total == 0) {
+        return Ok(std::optional<size_t>{0});
+    }
+
+    GEODE_UNWRAP_INTO(auto sent, mapResult(session.trySend(writeBuffer.data(), total)));
+    this->countWrite(total);
+
+    // the bytes are ours now either way, a blocked write is retried from writeBuffer
+    writePending = !sent.has_value();
+    return Ok(std::optional<size_t>{total});
 }
 
 Result<> TlsTransport::shutdown() {
-    return mapResult(session.shutdown());
+    Result<> res = Ok();
+
+    // wolfSSL no longer knows the sequence number its alert would have to carry
+    if (kernel && kernel->sending()) {
+        res = kernel->sendCloseNotify();
+    } else {
+        std::lock_guard lock(sessionMutex);
+        res = mapResult(session.shutdown());
+    }
+
+    // the alert alone leaves a thread in receive() parked in poll(), with nothing left to read
+    (void) shutdownSocket(session.fd);
+
+    return res;
 }
 
 }
\ No newline at end of file
@@ -1,24 +1,89 @@
 #pragma once
 
 #include <BaseTransport.hpp>
-#include <qsox/TcpStream.hpp>
+#include <qsox/BaseSocket.hpp>
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include "KernelTls.hpp"
 #include "TlsSession.hpp"
 
 namespace ws {
 
+// Thread safe in the way a socket is: one thread may be receiving while another sends, as threaded
+// clients do. Every wolfSSL call on the session happens under one lock, and since the socket is
+// non-blocking nothing waits while holding it; the blocking calls wait in poll() between attempts
 class TlsTransport : public BaseTransport {
 public:
-    static geode::Result<std::shared_ptr<BaseTransport>> connect(const qsox::SocketAddress& address);
+    static geode::Result<std::shared_ptr<TlsTransport>> connect(
+        qsox::SockFd fd, std::string_view host, uint16_t port, std::shared_ptr<TlsContext> context,
+        std::span<const uint8_t> earlyData = {}, std::chrono::milliseconds handshakeTimeout = {}
+    );
+
+    // Server side: wraps an accepted socket without handshaking. The socket should be non-blocking,
+    // tryAccept() is then called whenever it becomes readable until the handshake is done
+    static geode::Result<std::shared_ptr<TlsTransport>> accept(qsox::SockFd fd, std::shared_ptr<TlsContext> context);
+    geode::Result<bool> tryAccept();
 
     geode::Result<size_t> send(const void* data, size_t size) override;
     geode::Result<size_t> receive(void* buffer, size_t size) override;
     geode::Result<> shutdown() override;
 
+    // coalesces into one write so small frames go out as a single TLS record
+    geode::Result<size_t> sendv(std::span<const ConstBuffer> buffers) override;
+
+    intptr_t nativeHandle() const override {
+        return static_cast<intptr_t>(session.fd);
+    }
+
+    geode::Result<> setNonBlocking(bool enabled) override;
+    geode::Result<std::optional<size_t>> tryReceive(void* buffer, size_t size) override;
+    geode::Result<std::optional<size_t>> trySendv(std::span<const ConstBuffer> buffers) override;
+
+    bool hasPendingOutput() const override;
+    // decrypted bytes of a record that was only partly read
+    bool hasPendingInput() const override;
+
+    // whether records are sealed and opened by the kernel, see TlsOptions::kernelOffload
+    bool kernelOffloaded() const {
+        return kernel && (kernel->sending() || kernel->receiving());
+    }
+
+    // why a connection that asked for kernel TLS stayed with wolfSSL
+    const std::string& kernelOffloadError() const {
+        return kernelFallback;
+    }
+
+    bool resumed() const {
+        return session.resumed();
+    }
+
+    std::chrono::microseconds handshakeTime() const {
+        return handshakeDuration;
+    }
+
+    // how much of the early data passed to connect() the server accepted as 0-RTT data
+    size_t earlyDataAccepted() const {
+        return earlyAccepted;
+    }
+
     TlsTransport(TlsSession&& session) : session(std::move(session)) {}
 
 private:
+    // wolfSSL reads through this, so it has to outlive the session
+    std::unique_ptr<KernelTls> kernel;
+    std::string kernelFallback;
+    // wolfSSL does not allow a read and a write on one session at the same time
+    mutable std::mutex sessionMutex;
     TlsSession session;
+    std::vector<uint8_t> writeBuffer;
+    // wolfSSL wants writeBuffer passed again before anything new can be written
+    bool writePending = false;
+    std::chrono::microseconds handshakeDuration{};
+    size_t earlyAccepted = 0;
+
+    // waits until the socket is ready for `events`, without a timeout
+    geode::Result<> waitSocket(short events);
 };
 
-}
\ No newline at end of file
+}
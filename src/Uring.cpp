@@ -0,0 +1,267 @@
+#include <Uring.hpp>
+#include "IoUring.hpp"
+#include "UringTransport.hpp"
+
+#include <bit>
+#include <cerrno>
+#include <vector>
+
+#if MINIWS_IO_URING
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+using namespace geode;
+
+namespace ws {
+
+// every transport on a driver shares the one group of receive buffers
+static constexpr uint16_t BufferGroup = 0;
+
+Result<std::shared_ptr<UringDriver>> UringDriver::create(UringOptions options) {
+#if MINIWS_IO_URING
+    // buffer ids are 16 bit, and the buffer ring wraps with a mask
+    if (options.bufferCount == 0 || options.bufferCount > 32768 || !std::has_single_bit(options.bufferCount)) {
+        return Err("bufferCount must be a power of two, at most 32768");
+    }
+
+    auto driver = std::shared_ptr<UringDriver>(new UringDriver());
+
+    GEODE_UNWRAP_INTO(driver->ring, IoUring::create(options.entries));
+    GEODE_UNWRAP(driver->ring->provideBuffers(BufferGroup, options.bufferCount, options.bufferSize));
+    GEODE_UNWRAP(driver->probe());
+
+    return Ok(driver);
+#else
+    return Err("io_uring is only available on Linux");
+#endif
+}
+
+std::shared_ptr<UringDriver> UringDriver::shared() {
+    static std::mutex mutex;
+    static std::shared_ptr<UringDriver> driver;
+    static bool tried = false;
+
+    std::lock_guard lock(mutex);
+
+    // a kernel without io_uring stays without it, so only ask once
+    if (!tried) {
+        tried = true;
+        auto res = UringDriver::create();
+        if (res.isOk()) {
+            driver = res.unwrap();
+        }
+    }
+
+    return driver;
+}
+
+UringDriver::~UringDriver() = default;
+
+UringStats UringDriver::stats() const {
+    return UringStats{
+        .enters = enters.load(std::memory_order_relaxed),
+        .submissions = submissions.load(std::memory_order_relaxed),
+        .completions = completions.load(std::memory_order_relaxed),
+        .bufferShortages = bufferShortages.load(std::memory_order_relaxed),
+    };
+}
+
+#if MINIWS_IO_URING
+
+Result<> UringDriver::probe() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        return Err("unable to probe io_uring: socketpair failed");
+    }
+
+    // nothing else uses the ring yet, so this can go around the locking
+    constexpr uint64_t ProbeData = 1;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+    auto sqe = ring->nextSqe();
+    prepareMultishotReceive(sqe, fds[0], BufferGroup);
+    sqe->user_data = ProbeData;
+    ring->publish();
+
+    (void) ::send(fds[1], "x", 1, 0);
+
+    bool supported = false;
+    bool finished = false;
+
+    auto handle = [&](const io_uring_cqe& cqe) {
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            ring->recycleBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+
+        if (cqe.res == 1 && (cqe.flags & IORING_CQE_F_BUFFER) && (cqe.flags & IORING_CQE_F_MORE)) {
+            supported = true;
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            finished = true;
+        }
+    };
+
+    int submitted = ring->enter(1, 1, deadline);
+    ring->drain(handle);
+
+    // ends the receive if it is still armed
+    ::shutdown(fds[0], SHUT_RDWR);
+
+    while (submitted == 1 && !finished && std::chrono::steady_clock::now() < deadline) {
+        ring->enter(0, 1, deadline);
+        ring->drain(handle);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+
+    if (!supported) {
+        return Err("io_uring does not support multishot receives with provided buffers (needs Linux 6.0)");
+    }
+
+    // a receive that did not finish in time would complete into a transport that does not exist
+    if (!finished) {
+        return Err("io_uring probe did not finish");
+    }
+
+    return Ok();
+}
+
+io_uring_sqe* UringDriver::prepare(std::unique_lock<std::mutex>& lock) {
+    while (true) {
+        if (auto sqe = ring->nextSqe()) {
+            ++unsubmitted;
+            return sqe;
+        }
+
+        // full; whatever is queued has to go to the kernel first
+        this->enter(lock, 0, std::nullopt);
+    }
+}
+
+void UringDriver::submit(std::unique_lock<std::mutex>& lock) {
+    ring->publish();
+
+    // a leader that is not blocked in the kernel yet takes these along when it does, saving a syscall
+    if (unsubmitted == 0 || (leader && !inKernel)) {
+        return;
+    }
+
+    this->enter(lock, 0, std::nullopt);
+}
+
+int UringDriver::enter(std::unique_lock<std::mutex>& lock, unsigned waitFor, std::optional<std::chrono::steady_clock::time_point> deadline) {
+    ring->publish();
+    unsigned count = std::exchange(unsubmitted, 0);
+
+    lock.unlock();
+    int res = ring->enter(count, waitFor, deadline);
+    lock.lock();
+
+    enters.fetch_add(1, std::memory_order_relaxed);
+
+    // interrupted or timed out before submitting, those entries are still queued
+    unsigned taken = res > 0 ? static_cast<unsigned>(res) : 0;
+    if (taken < count) {
+        unsubmitted += count - taken;
+    }
+
+    submissions.fetch_add(taken, std::memory_order_relaxed);
+    return res;
+}
+
+void UringDriver::reap(std::unique_lock<std::mutex>& lock) {
+    // sends that wrote only part of their data continue once the queue is drained
+    std::vector<UringTransport*> resend;
+
+    unsigned count = ring->drain([&](const io_uring_cqe& cqe) {
+        if (cqe.user_data == 0) {
+            return;
+        }
+
+        auto transport = reinterpret_cast<UringTransport*>(cqe.user_data & ~UringTransport::OpMask);
+        if (transport->complete(cqe.user_data & UringTransport::OpMask, cqe.res, cqe.flags)) {
+            resend.push_back(transport);
+        }
+    });
+
+    completions.fetch_add(count, std::memory_order_relaxed);
+
+    for (auto transport : resend) {
+        transport->continueSend(lock);
+    }
+}
+
+bool UringDriver::waitFor(
+    std::unique_lock<std::mutex>& lock,
+    const std::function<bool()>& done,
+    std::optional<std::chrono::steady_clock::time_point> deadline
+) {
+    while (!done()) {
+        if (leader) {
+            // someone else is reaping; they wake everyone once there is something new
+            if (deadline) {
+                if (completed.wait_until(lock, *deadline) == std::cv_status::timeout) {
+                    return done();
+                }
+            } else {
+                completed.wait(lock);
+            }
+
+            continue;
+        }
+
+        // completions may have been posted since the last leader left
+        this->reap(lock);
+        if (done()) {
+            break;
+        }
+
+        if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+            return false;
+        }
+
+        leader = true;
+        inKernel = true;
+        this->enter(lock, 1, deadline);
+        inKernel = false;
+
+        this->reap(lock);
+
+        // submissions made while this thread was reaping were left for it
+        while (unsubmitted > 0 && this->enter(lock, 0, std::nullopt) > 0) {}
+
+        leader = false;
+        completed.notify_all();
+    }
+
+    return true;
+}
+
+#else
+
+Result<> UringDriver::probe() {
+    return Err("io_uring is only available on Linux");
+}
+
+io_uring_sqe* UringDriver::prepare(std::unique_lock<std::mutex>&) {
+    return nullptr;
+}
+
+void UringDriver::submit(std::unique_lock<std::mutex>&) {}
+
+int UringDriver::enter(std::unique_lock<std::mutex>&, unsigned, std::optional<std::chrono::steady_clock::time_point>) {
+    return -ENOSYS;
+}
+
+void UringDriver::reap(std::unique_lock<std::mutex>&) {}
+
+bool UringDriver::waitFor(std::unique_lock<std::mutex>&, const std::function<bool()>& done, std::optional<std::chrono::steady_clock::time_point>) {
+    return done();
+}
+
+#endif
+
+}
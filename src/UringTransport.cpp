@@ -0,0 +1,310 @@
+#include "UringTransport.hpp"
+
+#if MINIWS_IO_URING
+
+#include "SocketUtil.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace geode;
+
+namespace ws {
+
+// matches UringDriver, which registers a single buffer group
+static constexpr uint16_t BufferGroup = 0;
+
+// a single IORING_OP_SEND takes at most this much, the result has to fit an int
+static constexpr size_t MaxSendSize = 1 << 30;
+
+UringTransport::UringTransport(std::shared_ptr<UringDriver> driver, qsox::SockFd fd)
+    : driver(std::move(driver)), fd(fd) {}
+
+UringTransport::~UringTransport() {
+    std::unique_lock lock(driver->mutex);
+
+    // ends the receive and fails a send that is stuck on a full socket
+    ::shutdown(fd, SHUT_RDWR);
+
+    if (receiveArmed) {
+        prepareCancel(driver->prepare(lock), this->userData(ReceiveOp));
+        driver->submit(lock);
+    }
+
+    driver->waitFor(lock, [this] { return outstanding == 0; });
+
+    for (auto& chunk : chunks) {
+        driver->ring->recycleBuffer(chunk.buffer);
+    }
+
+    closeSocket(fd);
+}
+
+bool UringTransport::complete(uint64_t op, int32_t result, uint32_t flags) {
+    if (op == ReceiveOp) {
+        if (flags & IORING_CQE_F_BUFFER) {
+            auto id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+
+            if (result > 0) {
+                chunks.push_back(Chunk{ .buffer = id, .offset = 0, .size = static_cast<uint32_t>(result) });
+                this->countRead(static_cast<size_t>(result));
+            } else {
+                driver->ring->recycleBuffer(id);
+            }
+        }
+
+        if (result == 0 || result == -ECANCELED) {
+            eof = true;
+        } else if (result == -ENOBUFS) {
+            // every buffer is held by some connection; give the readers a moment to hand some back
+            rearmAt = Clock::now() + std::chrono::milliseconds(1);
+            driver->bufferShortages.fetch_add(1, std::memory_order_relaxed);
+        } else if (result < 0) {
+            receiveError = -result;
+        }
+
+        if (!(flags & IORING_CQE_F_MORE)) {
+            receiveArmed = false;
+            --outstanding;
+        }
+
+        return false;
+    }
+
+    if (result <= 0) {
+        sendError = result < 0 ? -result : EPIPE;
+        sendInFlight = false;
+        --outstanding;
+        return false;
+    }
+
+    this->countWrite(static_cast<size_t>(result));
+    sendingOffset += static_cast<size_t>(result);
+
+    if (sendingOffset < sending.size() || !outbox.empty()) {
+        // stays outstanding until the continuation completes
+        return true;
+    }
+
+    sendInFlight = false;
+    --outstanding;
+    return false;
+}
+
+void UringTransport::armReceive(std::unique_lock<std::mutex>& lock) {
+    if (receiveArmed || eof || receiveError != 0 || Clock::now() < rearmAt) {
+        return;
+    }
+
+    receiveArmed = true;
+    ++outstanding;
+
+    auto sqe = driver->prepare(lock);
+    prepareMultishotReceive(sqe, fd, BufferGroup);
+    sqe->user_data = this->userData(ReceiveOp);
+
+    driver->submit(lock);
+}
+
+bool UringTransport::awaitInput(std::unique_lock<std::mutex>& lock, std::optional<Clock::time_point> deadline) {
+    auto ready = [this] {
+        return !chunks.empty() || eof || receiveError != 0;
+    };
+
+    while (!ready()) {
+        if (deadline && Clock::now() >= *deadline) {
+            return false;
+        }
+
+        if (!receiveArmed) {
+            if (Clock::now() < rearmAt) {
+                driver->completed.wait_until(lock, deadline ? std::min(*deadline, rearmAt) : rearmAt);
+                continue;
+            }
+
+            this->armReceive(lock);
+        }
+
+        // also wakes up when the receive stops, so it can be re-armed
+        driver->waitFor(lock, [&] { return ready() || !receiveArmed; }, deadline);
+    }
+
+    return true;
+}
+
+size_t UringTransport::copyOut(void* buffer, size_t size) {
+    auto out = static_cast<uint8_t*>(buffer);
+    size_t copied = 0;
+
+    while (copied < size && !chunks.empty()) {
+        auto& chunk = chunks.front();
+        size_t step = std::min<size_t>(size - copied, chunk.size);
+
+        std::memcpy(out + copied, driver->ring->buffer(chunk.buffer) + chunk.offset, step);
+        copied += step;
+        chunk.offset += static_cast<uint32_t>(step);
+        chunk.size -= static_cast<uint32_t>(step);
+
+        if (chunk.size == 0) {
+            driver->ring->recycleBuffer(chunk.buffer);
+            chunks.pop_front();
+        }
+    }
+
+    return copied;
+}
+
+Result<size_t> UringTransport::takeReceived(void* buffer, size_t size) {
+    // data that arrived before an error or the end of the stream still goes out first
+    if (!chunks.empty()) {
+        return Ok(this->copyOut(buffer, size));
+    }
+
+    if (receiveError != 0) {
+        return Err(socketErrorMessage(receiveError));
+    }
+
+    return Ok(0);
+}
+
+Result<size_t> UringTransport::receive(void* buffer, size_t size) {
+    std::unique_lock lock(driver->mutex);
+
+    this->awaitInput(lock, std::nullopt);
+    return this->takeReceived(buffer, size);
+}
+
+Result<std::optional<size_t>> UringTransport::tryReceive(void* buffer, size_t size) {
+    std::unique_lock lock(driver->mutex);
+
+    this->armReceive(lock);
+
+    // whatever already completed can be picked up without entering the kernel
+    if (chunks.empty() && !driver->leader) {
+        driver->reap(lock);
+    }
+
+    if (chunks.empty() && !eof && receiveError == 0) {
+        return Ok(std::nullopt);
+    }
+
+    GEODE_UNWRAP_INTO(size_t received, this->takeReceived(buffer, size));
+    return Ok(std::optional<size_t>{received});
+}
+
+bool UringTransport::waitReadable(std::chrono::milliseconds timeout) {
+    std::unique_lock lock(driver->mutex);
+    return this->awaitInput(lock, Clock::now() + timeout);
+}
+
+bool UringTransport::hasPendingInput() const {
+    std::lock_guard lock(driver->mutex);
+    return !chunks.empty() || eof || receiveError != 0;
+}
+
+bool UringTransport::hasPendingOutput() const {
+    std::lock_guard lock(driver->mutex);
+    return sendInFlight;
+}
+
+Result<bool> UringTransport::reserveOutput(std::unique_lock<std::mutex>& lock, bool wait) {
+    if (sendError == 0 && outbox.size() >= MaxQueuedOutput) {
+        if (!wait) {
+            return Ok(false);
+        }
+
+        driver->waitFor(lock, [this] { return outbox.size() < MaxQueuedOutput || sendError != 0; });
+    }
+
+    if (sendError != 0) {
+        return Err(socketErrorMessage(sendError));
+    }
+
+    return Ok(true);
+}
+
+size_t UringTransport::queueOutput(std::span<const ConstBuffer> buffers) {
+    size_t total = 0;
+    for (auto& buffer : buffers) {
+        auto bytes = static_cast<const uint8_t*>(buffer.data);
+        outbox.insert(outbox.end(), bytes, bytes + buffer.size);
+        total += buffer.size;
+    }
+
+    return total;
+}
+
+void UringTransport::startSend(std::unique_lock<std::mutex>& lock) {
+    if (sendInFlight || outbox.empty()) {
+        return;
+    }
+
+    sendInFlight = true;
+    ++outstanding;
+    sendingOffset = sending.size();
+
+    this->continueSend(lock);
+}
+
+void UringTransport::continueSend(std::unique_lock<std::mutex>& lock) {
+    if (sendingOffset == sending.size()) {
+        // the two buffers trade places, so neither allocates once warmed up
+        sending.swap(outbox);
+        outbox.clear();
+        sendingOffset = 0;
+    }
+
+    auto sqe = driver->prepare(lock);
+    prepareSend(sqe, fd, sending.data() + sendingOffset, std::min(sending.size() - sendingOffset, MaxSendSize), SendFlags);
+    sqe->user_data = this->userData(SendOp);
+
+    driver->submit(lock);
+}
+
+Result<size_t> UringTransport::send(const void* data, size_t size) {
+    ConstBuffer buffer{data, size};
+    return this->sendv({&buffer, 1});
+}
+
+Result<size_t> UringTransport::sendv(std::span<const ConstBuffer> buffers) {
+    std::unique_lock lock(driver->mutex);
+    GEODE_UNWRAP(this->reserveOutput(lock, true));
+
+    size_t total = this->queueOutput(buffers);
+    this->startSend(lock);
+
+    return Ok(total);
+}
+
+Result<std::optional<size_t>> UringTransport::trySendv(std::span<const ConstBuffer> buffers) {
+    std::unique_lock lock(driver->mutex);
+    GEODE_UNWRAP_INTO(bool room, this->reserveOutput(lock, false));
+
+    if (!room) {
+        return Ok(std::nullopt);
+    }
+
+    size_t total = this->queueOutput(buffers);
+    this->startSend(lock);
+
+    return Ok(std::optional<size_t>{total});
+}
+
+Result<> UringTransport::shutdown() {
+    {
+        std::unique_lock lock(driver->mutex);
+
+        // a close frame is usually the last thing queued; give it a chance to go out
+        driver->waitFor(lock, [this] { return !sendInFlight; }, Clock::now() + std::chrono::seconds(5));
+    }
+
+    if (::shutdown(fd, SHUT_RDWR) != 0) {
+        return Err(lastSocketError());
+    }
+
+    return Ok();
+}
+
+}
+
+#endif
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "IoUring.hpp"
+
+#if MINIWS_IO_URING
+
+#include <BaseTransport.hpp>
+#include <Uring.hpp>
+#include <qsox/BaseSocket.hpp>
+#include <chrono>
+#include <deque>
+#include <memory>
+
+namespace ws {
+
+// A connected socket driven by a UringDriver instead of send()/recv(). Incoming data arrives through
+// one multishot receive into the driver's provided buffers and is copied out on receive(); outgoing
+// data is copied into an outbox and written by one IORING_OP_SEND at a time, so sends return
+// without waiting for the socket. Errors from a send are reported by the next call.
+class UringTransport : public BaseTransport {
+public:
+    // takes ownership of a connected socket
+    UringTransport(std::shared_ptr<UringDriver> driver, qsox::SockFd fd);
+    // cancels what is still in flight and waits for it, so completions never outlive the transport
+    ~UringTransport() override;
+
+    UringTransport(const UringTransport&) = delete;
+    UringTransport& operator=(const UringTransport&) = delete;
+
+    geode::Result<size_t> send(const void* data, size_t size) override;
+    geode::Result<size_t> receive(void* buffer, size_t size) override;
+    // waits for queued output to go out first
+    geode::Result<> shutdown() override;
+
+    geode::Result<size_t> sendv(std::span<const ConstBuffer> buffers) override;
+
+    intptr_t nativeHandle() const override {
+        return static_cast<intptr_t>(fd);
+    }
+
+    geode::Result<std::optional<size_t>> tryReceive(void* buffer, size_t size) override;
+    geode::Result<std::optional<size_t>> trySendv(std::span<const ConstBuffer> buffers) override;
+
+    bool hasPendingOutput() const override;
+    bool hasPendingInput() const override;
+    bool waitReadable(std::chrono::milliseconds timeout) override;
+
+private:
+    friend class UringDriver;
+
+    using Clock = std::chrono::steady_clock;
+
+    // completions carry the transport's address with the kind of operation in the low bits
+    static constexpr uint64_t ReceiveOp = 1;
+    static constexpr uint64_t SendOp = 2;
+    static constexpr uint64_t OpMask = 3;
+
+    // past this much queued output, sendv waits and trySendv reports would-block
+    static constexpr size_t MaxQueuedOutput = 4 * 1024 * 1024;
+
+    // received bytes still sitting in one of the driver's buffers
+    struct Chunk {
+        uint16_t buffer;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    std::shared_ptr<UringDriver> driver;
+    qsox::SockFd fd;
+
+    // everything below is guarded by the driver's mutex
+
+    bool receiveArmed = false;
+    // after running out of buffers, the receive is re-armed no earlier than this
+    Clock::time_point rearmAt{};
+    std::deque<Chunk> chunks;
+    bool eof = false;
+    int receiveError = 0;
+
+    // the bytes being written by the send in flight; `outbox` collects what comes meanwhile
+    std::vector<uint8_t> sending;
+    size_t sendingOffset = 0;
+    std::vector<uint8_t> outbox;
+    bool sendInFlight = false;
+    int sendError = 0;
+
+    // submitted operations that will still post a completion
+    unsigned outstanding = 0;
+
+    uint64_t userData(uint64_t op) const {
+        return reinterpret_cast<uint64_t>(this) | op;
+    }
+
+    // called by the driver for every completion; returns true if more output must be submitted
+    bool complete(uint64_t op, int32_t result, uint32_t flags);
+
+    void armReceive(std::unique_lock<std::mutex>& lock);
+    // waits until receive() would return right away, or `deadline` passes
+    bool awaitInput(std::unique_lock<std::mutex>& lock, std::optional<Clock::time_point> deadline);
+    size_t copyOut(void* buffer, size_t size);
+    geode::Result<size_t> takeReceived(void* buffer, size_t size);
+
+    // checks for earlier send errors and makes room in the outbox; false if `wait` is off and it is full
+    geode::Result<bool> reserveOutput(std::unique_lock<std::mutex>& lock, bool wait);
+    size_t queueOutput(std::span<const ConstBuffer> buffers);
+    void startSend(std::unique_lock<std::mutex>& lock);
+    // submits the rest of `sending`, or the outbox once that is done
+    void continueSend(std::unique_lock<std::mutex>& lock);
+};
+
+}
+
+#endif
@@ -0,0 +1,408 @@
+#include "Utf8.hpp"
+#include "Mask.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+# define MINIWS_UTF8_X86 1
+# include <immintrin.h>
+#endif
+
+#if defined(MINIWS_UTF8_X86) && (defined(__GNUC__) || defined(__clang__))
+# define MINIWS_UTF8_SIMD 1
+# define MINIWS_TARGET_SSE41 __attribute__((target("sse4.1")))
+# define MINIWS_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(MINIWS_UTF8_X86) && defined(__AVX2__)
+# define MINIWS_UTF8_SIMD 1
+# define MINIWS_TARGET_SSE41
+# define MINIWS_TARGET_AVX2
+#endif
+
+namespace ws {
+
+// Validates (and, when `masked`, first unmasks in place) as many whole vectors of `data` as fit, and
+// returns how many bytes that was. `data` must start on a character boundary. A character cut off at
+// the end is not an error here; the caller checks the bytes from its start again with what follows
+using ValidateFn = size_t(*)(uint8_t* data, size_t size, uint32_t key, bool masked, bool& valid);
+
+// below this, setting up the vectors costs more than the scalar loop
+static constexpr size_t MinVectorSize = 64;
+
+#ifdef MINIWS_UTF8_SIMD
+
+// The lookup algorithm from Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte".
+// Every error shows up in the first 12 bits of some pair of adjacent bytes: each of the three tables
+// maps one nibble of the pair to the errors it could be part of, and a bit set in all three is a real
+// one. The only thing pairs cannot see is a missing third or fourth byte, which is checked separately.
+
+constexpr uint8_t TooShort = 1 << 0;   // 11______ 0_______ or 11______ 11______
+constexpr uint8_t TooLong = 1 << 1;    // 0_______ 10______
+constexpr uint8_t Overlong3 = 1 << 2;  // 11100000 100_____
+constexpr uint8_t TooLarge = 1 << 3;   // 11110100 1001____ and up
+constexpr uint8_t Surrogate = 1 << 4;  // 11101101 101_____
+constexpr uint8_t Overlong2 = 1 << 5;  // 1100000_ 10______
+constexpr uint8_t TooLarge1000 = 1 << 6; // 11110101 1000____ and up
+constexpr uint8_t Overlong4 = 1 << 6;  // 11110000 1000____
+constexpr uint8_t TwoConts = 1 << 7;   // 10______ 10______
+
+// errors that do not depend on the low nibble of the first byte
+constexpr uint8_t Carry = TooShort | TooLong | TwoConts;
+
+// indexed by the high nibble of the first byte
+alignas(16) constexpr uint8_t Byte1High[16] = {
+    TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,
+    TwoConts, TwoConts, TwoConts, TwoConts,
+    TooShort | Overlong2,
+    TooShort,
+    TooShort | Overlong3 | Surrogate,
+    TooShort | TooLarge | TooLarge1000 | Overlong4,
+};
+
+// indexed by the low nibble of the first byte
+alignas(16) constexpr uint8_t Byte1Low[16] = {
+    Carry | Overlong3 | Overlong2 | Overlong4,
+    Carry | Overlong2,
+    Carry,
+    Carry,
+    Carry | TooLarge,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000 | Surrogate,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+};
+
+// indexed by the high nibble of the second byte
+alignas(16) constexpr uint8_t Byte2High[16] = {
+    TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,
+    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge1000 | Overlong4,
+    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge,
+    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+    TooShort, TooShort, TooShort, TooShort,
+};
+
+// a vector ending inside a character has one of its last three bytes above these
+alignas(32) constexpr uint8_t IncompleteMax[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf,
+};
+
+MINIWS_TARGET_SSE41
+static size_t validateSse41(uint8_t* data, size_t size, uint32_t key, bool masked, bool& valid) {
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(key));
+    const __m128i byte1High = _mm_load_si128(reinterpret_cast<const __m128i*>(Byte1High));
+    const __m128i byte1Low = _mm_load_si128(reinterpret_cast<const __m128i*>(Byte1Low));
+    const __m128i byte2High = _mm_load_si128(reinterpret_cast<const __m128i*>(Byte2High));
+    const __m128i incompleteMax = _mm_load_si128(reinterpret_cast<const __m128i*>(IncompleteMax + 16));
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i highBit = _mm_set1_epi8(static_cast<char>(0x80));
+
+    __m128i previous = _mm_setzero_si128();
+    __m128i previousIncomplete = _mm_setzero_si128();
+    __m128i error = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (masked) {
+            input = _mm_xor_si128(input, mask);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), input);
+        }
+
+        // ASCII only needs the previous vector to have finished its last character
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, previousIncomplete);
+            previousIncomplete = _mm_setzero_si128();
+            previous = input;
+            continue;
+        }
+
+        __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+        __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+        __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+
+        __m128i special = _mm_and_si128(
+            _mm_and_si128(
+                _mm_shuffle_epi8(byte1High, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                _mm_shuffle_epi8(byte1Low, _mm_and_si128(prev1, nibble))
+            ),
+            _mm_shuffle_epi8(byte2High, _mm_and_si128(_mm_srli_epi16(input, 4), nibble))
+        );
+
+        // bytes two after a 3 or 4 byte lead, or three after a 4 byte lead, must be continuations;
+        // exactly those positions have the TwoConts bit set by the tables
+        __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+        __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+        __m128i continuation = _mm_and_si128(_mm_or_si128(third, fourth), highBit);
+
+        error = _mm_or_si128(error, _mm_xor_si128(continuation, special));
+        previousIncomplete = _mm_subs_epu8(input, incompleteMax);
+        previous = input;
+    }
+
+    valid = _mm_testz_si128(error, error);
+    return i;
+}
+
+MINIWS_TARGET_AVX2
+static size_t validateAvx2(uint8_t* data, size_t size, uint32_t key, bool masked, bool& valid) {
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(key));
+    const __m256i byte1High = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(Byte1High)));
+    const __m256i byte1Low = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(Byte1Low)));
+    const __m256i byte2High = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(Byte2High)));
+    const __m256i incompleteMax = _mm256_load_si256(reinterpret_cast<const __m256i*>(IncompleteMax));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i highBit = _mm256_set1_epi8(static_cast<char>(0x80));
+
+    __m256i previous = _mm256_setzero_si256();
+    __m256i previousIncomplete = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+
+    size_t i = 0;
+    while (i + 32 <= size) {
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        if (masked) {
+            input = _mm256_xor_si256(input, mask);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), input);
+        }
+
+        // runs of ASCII are taken two vectors at a time, they only need the vector before them
+        // to have finished its last character
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, previousIncomplete);
+            previousIncomplete = _mm256_setzero_si256();
+            previous = input;
+            i += 32;
+
+            while (i + 64 <= size) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+                if (masked) {
+                    a = _mm256_xor_si256(a, mask);
+                    b = _mm256_xor_si256(b, mask);
+                }
+
+                if (_mm256_movemask_epi8(_mm256_or_si256(a, b)) != 0) {
+                    break;
+                }
+
+                if (masked) {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), a);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 32), b);
+                }
+
+                previous = b;
+                i += 64;
+            }
+
+            continue;
+        }
+
+        // alignr shifts within 128 bit lanes, so the lane below each one is lined up next to it first
+        __m256i below = _mm256_permute2x128_si256(previous, input, 0x21);
+        __m256i prev1 = _mm256_alignr_epi8(input, below, 15);
+        __m256i prev2 = _mm256_alignr_epi8(input, below, 14);
+        __m256i prev3 = _mm256_alignr_epi8(input, below, 13);
+
+        __m256i special = _mm256_and_si256(
+            _mm256_and_si256(
+                _mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, nibble))
+            ),
+            _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble))
+        );
+
+        __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+        __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+        __m256i continuation = _mm256_and_si256(_mm256_or_si256(third, fourth), highBit);
+
+        error = _mm256_or_si256(error, _mm256_xor_si256(continuation, special));
+        previousIncomplete = _mm256_subs_epu8(input, incompleteMax);
+        previous = input;
+        i += 32;
+    }
+
+    valid = _mm256_testz_si256(error, error);
+    return i;
+}
+
+#endif
+
+static ValidateFn selectKernel() {
+#if defined(MINIWS_UTF8_SIMD) && defined(__AVX2__)
+    return &validateAvx2;
+#elif defined(MINIWS_UTF8_SIMD)
+    if (__builtin_cpu_supports("avx2")) {
+        return &validateAvx2;
+    }
+
+    if (__builtin_cpu_supports("sse4.1")) {
+        return &validateSse41;
+    }
+
+    return nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+// where the character that runs past the end of `data` starts, or `size` if none does.
+// `data` must be valid apart from that character
+static size_t lastBoundary(const uint8_t* data, size_t size) {
+    for (size_t back = 1; back <= 3 && back <= size; ++back) {
+        uint8_t byte = data[size - back];
+        if ((byte & 0xc0) == 0x80) {
+            continue;
+        }
+
+        size_t length = byte < 0x80 ? 1 : byte >= 0xf0 ? 4 : byte >= 0xe0 ? 3 : 2;
+        return length > back ? size - back : size;
+    }
+
+    return size;
+}
+
+size_t Utf8Validator::checkScalar(const uint8_t* data, size_t size, bool untilBoundary) {
+    size_t i = 0;
+
+    while (i < size) {
+        if (remaining == 0) {
+            if (untilBoundary) {
+                break;
+            }
+
+            // runs of ASCII go 8 bytes at a time
+            while (i + 8 <= size) {
+                uint64_t word;
+                std::memcpy(&word, data + i, 8);
+                if (word & 0x8080808080808080ull) {
+                    break;
+                }
+
+                i += 8;
+            }
+
+            if (i == size) {
+                break;
+            }
+        }
+
+        uint8_t byte = data[i++];
+
+        if (remaining > 0) {
+            if (byte < low || byte > high) {
+                invalid = true;
+                return i;
+            }
+
+            low = 0x80;
+            high = 0xbf;
+            --remaining;
+            continue;
+        }
+
+        if (byte < 0x80) {
+            continue;
+        }
+
+        // C0 and C1 could only start overlong forms, above F4 is past U+10FFFF
+        if (byte < 0xc2 || byte > 0xf4) {
+            invalid = true;
+            return i;
+        }
+
+        remaining = byte >= 0xf0 ? 3 : byte >= 0xe0 ? 2 : 1;
+
+        // the second byte is narrower after leads that could otherwise encode overlong forms,
+        // surrogates or code points past U+10FFFF
+        switch (byte) {
+            case 0xe0: low = 0xa0; break;
+            case 0xed: high = 0x9f; break;
+            case 0xf0: low = 0x90; break;
+            case 0xf4: high = 0x8f; break;
+            default: break;
+        }
+    }
+
+    return i;
+}
+
+bool Utf8Validator::run(uint8_t* data, size_t size, uint32_t key, size_t offset, bool masked) {
+    static const ValidateFn kernel = selectKernel();
+
+    if (invalid) {
+        return false;
+    }
+
+    // the vectors have to start on a character boundary, so a character left open is finished first
+    size_t i = std::min<size_t>(remaining, size);
+    if (masked) {
+        applyMask(data, i, key, offset);
+    }
+
+    this->checkScalar(data, i, true);
+
+    if (!invalid && kernel && size - i >= MinVectorSize) {
+        bool valid = true;
+        size_t done = kernel(data + i, size - i, masked ? rotateMaskKey(key, offset + i) : 0, masked, valid);
+
+        if (!valid) {
+            invalid = true;
+            return false;
+        }
+
+        // a character cut off by the last vector is checked again from its start, along with what follows
+        size_t start = lastBoundary(data + i, done);
+        this->checkScalar(data + i + start, done - start, false);
+        i += done;
+    }
+
+    if (invalid) {
+        return false;
+    }
+
+    if (masked) {
+        applyMask(data + i, size - i, key, offset + i);
+    }
+
+    this->checkScalar(data + i, size - i, false);
+    return !invalid;
+}
+
+bool Utf8Validator::feed(std::span<const uint8_t> data) {
+    // nothing is written without a mask
+    return this->run(const_cast<uint8_t*>(data.data()), data.size(), 0, 0, false);
+}
+
+bool Utf8Validator::feedMasked(std::span<uint8_t> data, uint32_t key, size_t offset) {
+    return this->run(data.data(), data.size(), key, offset, true);
+}
+
+bool isValidUtf8(std::span<const uint8_t> data) {
+    Utf8Validator validator;
+    return validator.feed(data) && validator.complete();
+}
+
+std::string_view truncateUtf8(std::string_view text, size_t maxSize) {
+    if (text.size() <= maxSize) {
+        return text;
+    }
+
+    // back off over continuation bytes so the cut lands before the character they belong to
+    size_t size = maxSize;
+    while (size > 0 && (static_cast<uint8_t>(text[size]) & 0xc0) == 0x80) {
+        --size;
+    }
+
+    return text.substr(0, size);
+}
+
+}
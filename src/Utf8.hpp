@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace ws {
+
+// Checks that a text message is valid UTF-8 (RFC 3629) as its pieces arrive. Pieces may end anywhere,
+// even inside a character; a character left open is finished with the next piece.
+class Utf8Validator {
+public:
+    // false once anything fed so far was invalid
+    bool feed(std::span<const uint8_t> data);
+
+    // Unmasks `data` in place, like applyMask with the same `key` and `offset`, and checks the
+    // unmasked bytes on the same pass. Once the text is invalid, the rest may be left masked
+    bool feedMasked(std::span<uint8_t> data, uint32_t key, size_t offset = 0);
+
+    // true if everything fed so far is valid and the text does not stop inside a character
+    bool complete() const {
+        return !invalid && remaining == 0;
+    }
+
+    void reset() {
+        *this = Utf8Validator{};
+    }
+
+private:
+    // continuation bytes the current character still needs, and the range the next one must be in
+    uint8_t remaining = 0;
+    uint8_t low = 0x80;
+    uint8_t high = 0xbf;
+    bool invalid = false;
+
+    bool run(uint8_t* data, size_t size, uint32_t key, size_t offset, bool masked);
+    size_t checkScalar(const uint8_t* data, size_t size, bool untilBoundary);
+};
+
+bool isValidUtf8(std::span<const uint8_t> data);
+
+// the longest prefix of `text` that is at most `maxSize` bytes and does not end inside a character
+std::string_view truncateUtf8(std::string_view text, size_t maxSize);
+
+}
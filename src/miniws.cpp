@@ -1,61 +1,94 @@
 #include <algorithm>
 
-#include <map>
-#include <random>
 #include <charconv>
+#include <cctype>
+#include <cstring>
+#include <limits>
 
-#include <qsox/TcpStream.hpp>
-#include <qsox/Resolver.hpp>
 #include <miniws.hpp>
+#include <Reactor.hpp>
 #include "TlsTransport.hpp"
 #include "TcpTransport.hpp"
+#include "UringTransport.hpp"
+#include "Mask.hpp"
+#include "Random.hpp"
+#include "Frame.hpp"
+#include "FrameReader.hpp"
+#include "Deflate.hpp"
+#include "HappyEyeballs.hpp"
+#include "Handshake.hpp"
+#include "SendQueue.hpp"
+#include "LatencyHistogram.hpp"
+#include "ConnectionMetrics.hpp"
+#include "Log.hpp"
+#include "SocketUtil.hpp"
+#include "Utf8.hpp"
 
 // #include <cpr/cpr.h>
-#include <base64.hpp>
 #include <fmt/base.h>
 #include <fmt/format.h>
+#include <fmt/ranges.h>
 
-using namespace qsox;
+using namespace geode;
 
-static void fillRandom(uint8_t* dest, size_t len) {
-    static std::random_device rd;
-    static std::mt19937_64 generator(rd());
+#define LOG_DEBUG(...) MINIWS_LOG(*this, LogSeverity::Debug, __VA_ARGS__)
+#define LOG_INFO(...) MINIWS_LOG(*this, LogSeverity::Info, __VA_ARGS__)
+#define LOG_ERROR(...) MINIWS_LOG(*this, LogSeverity::Error, __VA_ARGS__)
 
-    while (len > 8) {
-        uint64_t value = generator();
-        std::memcpy(dest, &value, sizeof(value));
-        dest += sizeof(value);
-        len -= sizeof(value);
-    }
+#define CHECK_UNWRAP(statement, ...) if (auto res = statement; res.isErr()) { LOG_ERROR(__VA_ARGS__); return; }
+
+namespace ws {
+    using Clock = std::chrono::steady_clock;
+
+    static std::atomic<uint64_t> nextClientId = 1;
 
-    // less than 8 bytes left
-    while (len > 0) {
-        uint8_t value = static_cast<uint8_t>(generator() % 256);
-        *dest++ = value;
-        --len;
+    static bool isControlOpcode(Opcode opcode) {
+        return static_cast<uint8_t>(opcode) & 0x8;
     }
-}
 
-#define CHECK_UNWRAP(statement, ...) if (auto res = statement; res.isErr()) { error(fmt::format(__VA_ARGS__)); return; }
+    Client::Client()
+        : counters(std::make_unique<ConnectionMetrics>()),
+          sendQueue(std::make_unique<SendQueue>()),
+          reader(std::make_unique<FrameReader>()),
+          handshakeResponse(std::make_unique<HttpResponseParser>(MaxHandshakeResponseSize)),
+          rtt(std::make_unique<LatencyHistogram>()),
+          clientId(nextClientId.fetch_add(1, std::memory_order_relaxed)) {
+        sendQueue->metrics = counters.get();
+        reader->metrics = counters.get();
 
-namespace ws {
-    Client::Client() {
         // set default logging function
-        onLog([](LogSeverity severity, std::string message) {
-            fmt::println("[{}] {}", severityToString(severity), message);
+        onLogRecord([](const LogRecord& record) {
+            fmt::println("[{}] {}", severityToString(record.severity), record.message);
         });
     }
 
+    Client::~Client() noexcept {
+        // the thread touches this client until it is done. close() shuts the socket down, which wakes it
+        // from a read; one still connecting gives up within ConnectOptions::timeout
+        close();
+        joinWatchThread();
+        SendQueue::release(heldFrames);
+    }
+
+    void Client::joinWatchThread() {
+        if (!watchThread.joinable()) {
+            return;
+        }
+
+        // a callback running on it may be what closes the client
+        if (watchThread.get_id() == std::this_thread::get_id()) {
+            watchThread.detach();
+        } else {
+            watchThread.join();
+        }
+    }
+
     std::string Client::createHandshakeRequest(ServerAddress address) {
         std::string url = address.host;
         int port = address.port;
         std::string path = address.path;
 
-
-        std::array<uint8_t, 16> random_bytes;
-        fillRandom(random_bytes.data(), random_bytes.size());
-
-        std::string_view bytes(reinterpret_cast<char*>(random_bytes.data()), random_bytes.size());
+        handshakeKey = generateHandshakeKey();
 
         std::string request =
             "GET " + path + " HTTP/1.1\r\n"
@@ -63,35 +96,294 @@ namespace ws {
             "Origin: http://" + url + "\r\n"
             "Upgrade: websocket\r\n"
             "Connection: Upgrade\r\n"
-            "Sec-WebSocket-Key: " + base64_encode(bytes) + "\r\n"
-            "Sec-WebSocket-Version: 13\r\n"
-            "\r\n";
+            "Sec-WebSocket-Key: " + handshakeKey + "\r\n"
+            "Sec-WebSocket-Version: 13\r\n";
+
+        if (compressionOptions) {
+            request += "Sec-WebSocket-Extensions: " + PerMessageDeflate::offer(*compressionOptions) + "\r\n";
+        }
+
+        request += "\r\n";
 
         return request;
     }
 
-    std::vector<uint8_t> Client::createMessageFrame(std::string message) {
-        std::vector<uint8_t> frame;
-        frame.push_back(0x80 | 0x1); // FIN + opcode
-        frame.push_back(0x80 | message.size()); // mask + payload size
+    uint64_t Client::sendFrame(Opcode opcode, std::span<const uint8_t> payload) {
+        auto frame = sendQueue->newFrame(opcode);
+        frame->payload.assign(payload.begin(), payload.end());
+        counters->countAllocations(payload.empty() ? 1 : 2);
+
+        // counted before the writer can see it, so releasing never runs ahead
+        size_t buffered = bufferedBytes.fetch_add(payload.size(), std::memory_order_relaxed) + payload.size();
+        if (backpressure.highWaterMark > 0 && buffered >= backpressure.highWaterMark) {
+            overHighWater.store(true, std::memory_order_relaxed);
+        }
+
+        sendQueue->push(frame);
 
-        // generated with chatgpt bc im dumb
-        // Generate masking key
-        uint8_t masking_key[4];
-        for (int i = 0; i < 4; ++i)
-            masking_key[i] = rand() % 256;
+        // data frames leave in the order they were queued, so counting them is enough to tell when one went out
+        uint64_t sequence = isControlOpcode(opcode) ? 0 : dataQueued.fetch_add(1, std::memory_order_relaxed) + 1;
 
-        frame.insert(frame.end(), masking_key, masking_key + 4);
+        // anything queued before the handshake is flushed once it completes
+        if (!connected) {
+            return sequence;
+        }
 
-        // Mask the payload
-        for (size_t i = 0; i < message.size(); ++i) {
-            frame.push_back(message[i] ^ masking_key[i % 4]);
+        // poll mode writes on the next poll()
+        if (reactor) {
+            reactor->requestFlush(reactorId);
+        } else if (!pollMode) {
+            flushSendQueue();
         }
 
-        return frame;
+        return sequence;
     }
 
-    Result<> Client::open(std::string_view url) {
+    void Client::flushSendQueue() {
+        // whoever gets the writer role writes out everything queued so far, including frames
+        // other threads pushed while it was busy; they return right away instead of waiting.
+        // checking again after giving the role up catches frames pushed in between
+        while (!sendQueue->empty() && sendQueue->tryBeginWrite()) {
+            auto res = writeQueuedFrames();
+            sendQueue->endWrite();
+
+            if (res.isErr()) {
+                LOG_ERROR("unable to send message frame: {}", res.unwrapErr());
+                return;
+            }
+        }
+    }
+
+    bool Client::admit(size_t size) {
+        size_t high = backpressure.highWaterMark;
+        size_t buffered = bufferedBytes.load(std::memory_order_relaxed);
+
+        if (high == 0 || buffered == 0 || buffered + size <= high) {
+            return true;
+        }
+
+        overHighWater.store(true, std::memory_order_relaxed);
+
+        // queued frames only start leaving once the handshake is done
+        bool writing = connected;
+
+        switch (backpressure.policy) {
+            case OverflowPolicy::Block: {
+                // the loop thread and poll() are what would free the space, so they cannot wait for it
+                if (!writing || pollMode || (reactor && reactor->inLoop())) {
+                    return false;
+                }
+
+                std::unique_lock lock(bufferMutex);
+                bufferSpace.wait(lock, [&] {
+                    return bufferedBytes.load(std::memory_order_relaxed) <= backpressure.lowWaterMark || !connected;
+                });
+
+                return connected;
+            }
+
+            case OverflowPolicy::DropOldest:
+                // trimmed right here unless a writer is busy, which then trims on its next turn
+                if (writing && sendQueue->tryBeginWrite()) {
+                    takeQueuedFrames(size);
+                    heldFrames.swap(writeBatch);
+                    sendQueue->endWrite();
+                }
+
+                return writing;
+
+            case OverflowPolicy::FailFast:
+                return false;
+
+            case OverflowPolicy::Disconnect:
+                if (writing) {
+                    LOG_ERROR("{} bytes still waiting to be sent, closing the connection", buffered);
+                    setCloseReason("send buffer full");
+                    close();
+                }
+
+                return false;
+        }
+
+        return false;
+    }
+
+    void Client::releaseBuffered(size_t bytes) {
+        if (bytes == 0) {
+            return;
+        }
+
+        size_t left = bufferedBytes.fetch_sub(bytes, std::memory_order_relaxed) - bytes;
+        if (left > backpressure.lowWaterMark || !overHighWater.exchange(false, std::memory_order_relaxed)) {
+            return;
+        }
+
+        // taking the lock orders this with a sender about to wait, so the wakeup cannot slip in between
+        {
+            std::lock_guard lock(bufferMutex);
+        }
+        bufferSpace.notify_all();
+
+        if (writableCallback) {
+            writableCallback();
+        }
+    }
+
+    void Client::dropOldest(std::vector<OutgoingFrame*>& frames, size_t incoming) {
+        size_t high = backpressure.highWaterMark;
+        if (backpressure.policy != OverflowPolicy::DropOldest || high == 0) {
+            return;
+        }
+
+        // data frames are in the order they were sent; the newest always stays, unless
+        // a message about to be queued takes its place
+        auto newest = frames.end();
+        if (incoming == 0) {
+            auto last = std::find_if(frames.rbegin(), frames.rend(), [](OutgoingFrame* frame) {
+                return !isControlOpcode(frame->opcode);
+            });
+            if (last == frames.rend()) {
+                return;
+            }
+
+            newest = std::prev(last.base());
+        }
+
+        // counting the incoming message keeps the queue at the mark once it is added
+        size_t buffered = bufferedBytes.load(std::memory_order_relaxed) + incoming;
+        size_t excess = buffered > high ? buffered - high : 0;
+
+        std::vector<OutgoingFrame*> dropped;
+        size_t droppedBytes = 0;
+        auto keep = std::remove_if(frames.begin(), newest, [&](OutgoingFrame* frame) {
+            if (droppedBytes >= excess || isControlOpcode(frame->opcode)) {
+                return false;
+            }
+
+            droppedBytes += frame->payload.size();
+            dropped.push_back(frame);
+            return true;
+        });
+        if (dropped.empty()) {
+            return;
+        }
+
+        frames.erase(keep, newest);
+
+        // nobody is told, so their awaiters finish as if they had been written
+        dataTrimmed.fetch_add(dropped.size(), std::memory_order_relaxed);
+        LOG_DEBUG("dropped {} queued messages ({} bytes) over the send buffer limit", dropped.size(), droppedBytes);
+
+        SendQueue::release(dropped);
+        releaseBuffered(droppedBytes);
+    }
+
+    void Client::takeQueuedFrames(size_t incoming) {
+        // frames a trimming sender took out are older than anything still queued. the two vectors
+        // trade places rather than being copied, so both keep their capacity
+        auto& frames = writeBatch;
+        frames.swap(heldFrames);
+        sendQueue->takeAll(frames);
+
+        // nothing may follow a close frame, and control frames come first, so a queued close drops all data behind it
+        auto it = std::find_if(frames.begin(), frames.end(), [](OutgoingFrame* frame) {
+            return frame->opcode == Opcode::Close;
+        });
+
+        if (closeSent || it != frames.end()) {
+            auto keep = closeSent ? frames.begin() : it + 1;
+            std::vector<OutgoingFrame*> dropped(keep, frames.end());
+            size_t droppedBytes = 0;
+            for (auto frame : dropped) {
+                dataDropped += !isControlOpcode(frame->opcode);
+                droppedBytes += frame->payload.size();
+            }
+            SendQueue::release(dropped);
+            releaseBuffered(droppedBytes);
+            frames.erase(keep, frames.end());
+            closeSent = true;
+        }
+
+        this->dropOldest(frames, incoming);
+    }
+
+    Result<uint32_t> Client::prepareFrame(OutgoingFrame& frame) {
+        uint8_t rsv = 0;
+        bool dataFrame = frame.opcode == Opcode::Text || frame.opcode == Opcode::Binary;
+
+        // compression happens here rather than in send() so frames hit the shared deflate context in wire order
+        if (deflate && dataFrame && deflate->shouldCompress(frame.payload.size())) {
+            GEODE_UNWRAP_INTO(auto compressed, deflate->compress(frame.payload));
+            frame.payload.assign(compressed.begin(), compressed.end());
+            rsv = 0x4;
+        }
+
+        counters->countFrameOut(static_cast<uint8_t>(frame.opcode), frame.payload.size());
+
+        uint32_t maskingKey = randomMaskKey();
+        frame.headerSize = encodeFrameHeader(frame.header, static_cast<uint8_t>(frame.opcode), frame.payload.size(), maskingKey, true, rsv);
+
+        return Ok(maskingKey);
+    }
+
+    void Client::encodeQueuedFrames(std::vector<uint8_t>& out) {
+        takeQueuedFrames();
+        dataEncoded += dataTrimmed.exchange(0, std::memory_order_relaxed);
+
+        for (auto frame : writeBatch) {
+            dataEncoded += !isControlOpcode(frame->opcode);
+            // before compression, which changes the size
+            outboxPayloadBytes += frame->payload.size();
+
+            auto key = prepareFrame(*frame);
+            if (key.isErr()) {
+                LOG_ERROR("unable to compress message: {}", key.unwrapErr());
+                continue;
+            }
+
+            size_t offset = out.size();
+            out.resize(offset + frame->headerSize + frame->payload.size());
+            std::memcpy(out.data() + offset, frame->header, frame->headerSize);
+            applyMaskCopy(out.data() + offset + frame->headerSize, frame->payload.data(), frame->payload.size(), key.unwrap());
+        }
+
+        SendQueue::release(writeBatch);
+    }
+
+    Result<> Client::writeQueuedFrames() {
+        takeQueuedFrames();
+        gatherBuffers.clear();
+        size_t payloadBytes = 0;
+
+        for (auto frame : writeBatch) {
+            payloadBytes += frame->payload.size();
+
+            auto key = prepareFrame(*frame);
+            if (key.isErr()) {
+                LOG_ERROR("unable to compress message: {}", key.unwrapErr());
+                continue;
+            }
+
+            applyMask(frame->payload.data(), frame->payload.size(), key.unwrap());
+
+            gatherBuffers.push_back({frame->header, frame->headerSize});
+            gatherBuffers.push_back({frame->payload.data(), frame->payload.size()});
+        }
+
+        // the whole batch goes out as one gathered write, or one TLS record, unless it holds more
+        // than MaxGatherBuffers / 2 frames
+        auto res = stream->sendAllv(gatherBuffers);
+        SendQueue::release(writeBatch);
+        releaseBuffered(payloadBytes);
+
+        if (res.isErr()) {
+            return Err(res.unwrapErr());
+        }
+
+        return Ok();
+    }
+
+    static Result<ServerAddress> parseUrl(std::string_view url) {
         ServerAddress addr{};
 
         if (url.starts_with("ws://")) {
@@ -122,6 +414,11 @@ namespace ws {
             addr.port = addr.secure ? 443 : 80;
         }
 
+        return Ok(std::move(addr));
+    }
+
+    Result<> Client::open(std::string_view url) {
+        GEODE_UNWRAP_INTO(auto addr, parseUrl(url));
         return this->open(std::move(addr));
     }
 
@@ -130,150 +427,1190 @@ namespace ws {
             return Err("already connected!");
         }
 
-        // bool secure = address.url.starts_with("wss://");
-        bool secure = true;
+        // the last connection's thread stops once it notices close(); one still setting up is given up here
+        if (watchThread.joinable() && !connectCancelled) {
+            close();
+        }
+        joinWatchThread();
+        connectCancelled = false;
 
         this->address = address;
+        closeSent = false;
+        awaitable = false;
 
-        std::string url = address.host;
-        uint16_t port = address.port;
-        std::string path = address.path;
+        pingOutstanding = false;
+        timerArmed = false;
+        rtt->reset();
 
-        auto resolveRes = qsox::resolver::resolve(url);
-        if (resolveRes.isErr()) {
-            return Err(fmt::format("failed to resolve address: {}", resolveRes.unwrapErr().message()));
+        {
+            std::lock_guard lock(closeMutex);
+            closeReason.clear();
         }
+        incoming.reset();
+        incomingTaken = false;
+        readPaused = false;
 
-        info(fmt::format("resolved address: {}", resolveRes.unwrap().toString()));
+        // nothing half read from the last server may be taken as the start of the new one's frames
+        reader->reset();
 
-        if (secure) {
-            GEODE_UNWRAP_INTO(stream, TlsTransport::connect({resolveRes.unwrap(), port}));
-        } else {
-            GEODE_UNWRAP_INTO(stream, TcpTransport::connect({resolveRes.unwrap(), port}));
+        // compression is whatever the next handshake negotiates, nothing frames pipelined ahead of it may use
+        deflate.reset();
+
+        // frames taken by the last connection are done with one way or the other
+        dataEncoded += std::exchange(dataDropped, 0) + dataTrimmed.exchange(0, std::memory_order_relaxed);
+        dataWritten = dataEncoded;
+        releaseBuffered(std::exchange(outboxPayloadBytes, 0));
+
+        if (!resolverCache) {
+            resolverCache = ResolverCache::shared();
+        }
+
+        if (address.secure && !tlsContext) {
+            GEODE_UNWRAP_INTO(tlsContext, TlsContext::shared());
+        }
+
+        openedAt = Clock::now();
+
+        // start the lookup right away, the connecting thread picks up the answer
+        auto addresses = resolverCache->resolveAsync(address.host);
+
+        // nothing below may block the caller: resolving, connecting and the TLS handshake
+        // happen on the connection's own thread, failures are reported through the log
+        if (reactor || pollMode) {
+            pollReady = false;
+
+            watchThread = std::thread([this, addresses]() {
+                auto connect = [&]() -> Result<> {
+                    GEODE_UNWRAP(this->connectTransport(addresses));
+
+                    // the upgrade request is the first thing in the outbox; the reactor, or poll(), sends it once the socket is writable
+                    GEODE_UNWRAP(stream->setNonBlocking(true));
+
+                    if (connectCancelled) {
+                        return Ok();
+                    }
+
+                    if (!reactor) {
+                        pollReady.store(true, std::memory_order_release);
+                        return Ok();
+                    }
+
+                    // the loop may be destroying this client right now and waiting for us, so never block on it.
+                    // close() cancels under the same lock, so the client is either added before or not at all
+                    while (!reactor->loopMutex.try_lock()) {
+                        if (connectCancelled) {
+                            return Ok();
+                        }
+
+                        std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    }
+
+                    std::lock_guard lock(reactor->loopMutex, std::adopt_lock);
+                    if (connectCancelled) {
+                        return Ok();
+                    }
+
+                    GEODE_UNWRAP(reactor->add(this, stream->nativeHandle()));
+                    return Ok();
+                };
+
+                if (auto res = connect(); res.isErr()) {
+                    LOG_ERROR("unable to connect: {}", res.unwrapErr());
+                    this->failWaiters(res.unwrapErr());
+                }
+            });
+
+            return Ok();
         }
 
-        watchThread = std::thread([this]() {
+        watchThread = std::thread([this, addresses]() {
+            if (auto res = this->connectTransport(addresses); res.isErr()) {
+                LOG_ERROR("unable to connect: {}", res.unwrapErr());
+                return;
+            }
+
+            if (connectCancelled) {
+                return;
+            }
+
             this->watch();
         });
-        watchThread.detach();
 
         return Ok();
     }
 
-    void Client::watch() {
+    Result<> Client::connectTransport(std::shared_future<ResolveResult> addresses) {
+        auto elapsedSince = [](Clock::time_point start) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+        };
+
+        timings = {};
+        auto start = Clock::now();
+
+        ResolveResult resolved = addresses.get();
+        if (resolved.isErr()) {
+            return Err(resolved.unwrapErr());
+        }
+
+        timings.resolve = elapsedSince(start);
+        LOG_INFO("resolved {} to {}", address.host, fmt::join(resolved.unwrap(), ", "));
+
+        // the upgrade request, plus queued messages when pipelining, goes in the outbox first.
+        // nobody else writes before the handshake completes, and no reactor knows this client yet
         std::string request = createHandshakeRequest(address);
+        outbox.assign(request.begin(), request.end());
+        outboxOffset = 0;
+        handshakeResponse->reset();
+
+        if (pipelineHandshake && sendQueue->tryBeginWrite()) {
+            encodeQueuedFrames(outbox);
+            sendQueue->endWrite();
+        }
 
-        CHECK_UNWRAP(
-            stream->send(request.c_str(), request.size()),
-            "unable to send handshake request: {}", res.unwrapErr()
-        )
+        start = Clock::now();
 
-        char buffer[4096];
-        CHECK_UNWRAP(
-            stream->receive(buffer, sizeof(buffer) - 1),
-            "unable to receive handshake response: {}", res.unwrapErr()
-        )
+        uint16_t port = static_cast<uint16_t>(address.port);
+        GEODE_UNWRAP_INTO(auto fd, happyEyeballsConnect(resolved.unwrap(), port, connectOptions));
 
-        if (std::string(buffer).find("HTTP/1.1 101") == std::string::npos) {
-            error("handshake did NOT succeed...");
-            return;
+        if (address.secure) {
+            std::span<const uint8_t> earlyData;
+            if (earlyDataEnabled) {
+                earlyData = outbox;
+            }
+
+            // the handshake gets what is left of the connect timeout
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(start + connectOptions.timeout - Clock::now());
+            if (left.count() <= 0) {
+                closeSocket(fd);
+                return Err("connection timed out");
+            }
+
+            GEODE_UNWRAP_INTO(auto transport, TlsTransport::connect(fd, address.host, port, tlsContext, earlyData, left));
+
+            // whatever the server took as 0-RTT data is already sent
+            outboxOffset = transport->earlyDataAccepted();
+
+            timings.tlsHandshake = transport->handshakeTime();
+            timings.tlsResumed = transport->resumed();
+            timings.earlyDataBytes = outboxOffset;
+            timings.tlsKernelOffload = transport->kernelOffloaded();
+            timings.tcpConnect = elapsedSince(start) - timings.tlsHandshake;
+
+            LOG_INFO(
+                "connected in {}us, {} tls handshake took {}us ({} bytes of early data accepted)",
+                timings.tcpConnect.count(), timings.tlsResumed ? "resumed" : "full", timings.tlsHandshake.count(), timings.earlyDataBytes
+            );
+
+            if (timings.tlsKernelOffload) {
+                LOG_INFO("tls records are handled by the kernel");
+            } else if (!transport->kernelOffloadError().empty()) {
+                LOG_INFO("staying with wolfSSL for tls records: {}", transport->kernelOffloadError());
+            }
+
+            stream = std::move(transport);
+        } else {
+#if MINIWS_IO_URING
+            // the reactor and poll() wait on the socket itself, so only threaded clients can hand it to io_uring
+            if (uringDriver && !reactor && !pollMode) {
+                stream = std::make_shared<UringTransport>(uringDriver, fd);
+            } else {
+                stream = std::make_shared<TcpTransport>(fd);
+            }
+#else
+            stream = std::make_shared<TcpTransport>(fd);
+#endif
+            timings.tcpConnect = elapsedSince(start);
+        }
+
+        stream->setMetrics(counters.get());
+
+        return Ok();
+    }
+
+    Result<> Client::completeHandshake(const HttpResponseParser& response) {
+        if (response.status() != 101) {
+            return Err(fmt::format("handshake failed, server answered {} {}", response.status(), response.reason()));
+        }
+
+        // RFC 6455 section 4.1: anything else means this is not the server we talked to, or not a WebSocket server
+        if (!response.headerHasToken("Upgrade", "websocket") || !response.headerHasToken("Connection", "upgrade")) {
+            return Err("handshake failed, response is missing the Upgrade/Connection headers");
+        }
+
+        if (response.header("Sec-WebSocket-Accept") != expectedAcceptKey(handshakeKey)) {
+            return Err("handshake failed, Sec-WebSocket-Accept does not match the key we sent");
+        }
+
+        auto extensions = response.header("Sec-WebSocket-Extensions");
+        if (extensions) {
+            std::optional<DeflateParams> params;
+            if (compressionOptions) {
+                params = PerMessageDeflate::accept(*extensions, *compressionOptions);
+            }
+
+            if (!params) {
+                fail(1010, "unsupported extension response");
+                return Err("handshake failed, unsupported extension response");
+            }
+
+            auto created = PerMessageDeflate::create(*compressionOptions, *params, memory);
+            if (created.isErr()) {
+                fail(1011, "unable to set up compression");
+                return Err(fmt::format("handshake failed, {}", created.unwrapErr()));
+            }
+
+            deflate = std::move(created).unwrap();
+            reader->deflate = deflate.get();
+            LOG_INFO("negotiated {}", *extensions);
         }
 
-        info("handshake complete; watching for messages...");
+        timings.total = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - openedAt);
+        counters->countHandshake(timings.total);
+
+        LOG_INFO("handshake complete; watching for messages...");
         connected = true;
 
-        std::thread([this]() {
-            for (auto msg : queue) {
-                send(msg);
+        // write out whatever was sent while connecting, poll() does so on its way out
+        if (reactor) {
+            reactor->requestFlush(reactorId);
+        } else if (!pollMode) {
+            flushSendQueue();
+        }
+
+        startKeepalive(Clock::now());
+
+        return Ok();
+    }
+
+    bool Client::processIncoming() {
+        auto timeCallback = [this](auto&& callback) {
+            auto start = Clock::now();
+            callback();
+            counters->countCallback(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start));
+        };
+
+        // dispatch everything already buffered. in coroutine mode, stop at a message for receive(), parsing
+        // anything behind it would overwrite its payload; in poll mode, once the call's limit is reached
+        while (!incoming && dispatchBudget > 0) {
+            auto event = reader->next();
+            if (!event) {
+                break;
             }
-        }).detach();
 
-        // start thread with message frames
-        while (isConnected()) {
-            char ws_buffer[2];
-            CHECK_UNWRAP(
-                stream->receiveExact(ws_buffer, 2),
-                "unable to receieve message: {}", res.unwrapErr()
-            )
+            switch (event->type) {
+                case FrameEvent::Type::Message:
+                    if (!isControlOpcode(event->opcode) && awaitable) {
+                        incoming = ReceivedMessage{event->opcode, std::as_bytes(event->payload)};
+                    } else if (!isControlOpcode(event->opcode)) {
+                        timeCallback([&] { dispatchMessage(event->opcode, event->payload); });
+                        --dispatchBudget;
+                    } else if (!handleControl(event->opcode, event->payload)) {
+                        return false;
+                    }
+                    break;
+
+                case FrameEvent::Type::Fragment:
+                    if (fragmentCallback) {
+                        timeCallback([&] { fragmentCallback(std::as_bytes(event->payload), event->last); });
+                    }
+                    --dispatchBudget;
+                    break;
+
+                case FrameEvent::Type::Error:
+                    fail(event->closeCode, event->reason);
+                    return false;
+            }
+        }
+
+        return true;
+    }
 
-            bool fin = ws_buffer[0] & 0x80;
-            uint8_t opcode = ws_buffer[0] & 0x0F;
-            bool masked = ws_buffer[1] & 0x80;
-            uint64_t len = ws_buffer[1] & 0x7F;
-
-            if (len == 126) {
-                uint8_t ext[2];
-                CHECK_UNWRAP(
-                    stream->receiveExact(ext, 2),
-                    "unable to get length: {}", res.unwrapErr()
-                )
-                len = (ext[0] << 8) | ext[1];
-            } else if (len == 127) {
-                uint8_t ext[8];
-                CHECK_UNWRAP(
-                    stream->receiveExact(ext, 8),
-                    "unable to get length: {}", res.unwrapErr()
-                )
-                len = 0;
-                for (int i = 0; i < 8; ++i)
-                    len = (len << 8) | ext[i];
-            }
-
-            uint8_t recv_masking_key[4];
-            if (masked) {
-                CHECK_UNWRAP(
-                    stream->receiveExact(recv_masking_key, 4),
-                    "unable to get masking key: {}", res.unwrapErr()
-                )
-            }
-
-            std::vector<uint8_t> payload(len);
+    void Client::watch() {
+        // the part of the upgrade request that did not already go out as early data
+        if (outboxOffset < outbox.size()) {
             CHECK_UNWRAP(
-                stream->receiveExact(payload.data(), len),
-                "unable to receieve payload: {}", res.unwrapErr()
+                stream->sendAll(outbox.data() + outboxOffset, outbox.size() - outboxOffset),
+                "unable to send handshake request: {}", res.unwrapErr()
             )
+        }
+
+        outbox.clear();
+        outboxOffset = 0;
+        releaseBuffered(std::exchange(outboxPayloadBytes, 0));
+
+        while (handshakeResponse->state() == HttpResponseParser::State::Incomplete) {
+            uint8_t buffer[4096];
+            auto res = stream->receive(buffer, sizeof(buffer));
+            if (res.isErr()) {
+                LOG_ERROR("unable to receive handshake response: {}", res.unwrapErr());
+                return;
+            }
 
-            if (masked) {
-                for (size_t i = 0; i < len; ++i)
-                    payload[i] ^= recv_masking_key[i % 4];
+            if (res.unwrap() == 0) {
+                LOG_ERROR("connection closed during handshake");
+                return;
             }
 
-            msgCallback(std::string(payload.begin(), payload.end()));
+            handshakeResponse->feed({buffer, res.unwrap()});
         }
 
-        close();
-    }
+        if (handshakeResponse->state() == HttpResponseParser::State::Error) {
+            LOG_ERROR("invalid handshake response: {}", handshakeResponse->error());
+            return;
+        }
 
-    void Client::send(std::string data) {
-        if (!isConnected()) {
-            info("adding to queue");
-            queue.push_back(data);
+        if (auto res = completeHandshake(*handshakeResponse); res.isErr()) {
+            LOG_ERROR("{}", res.unwrapErr());
             return;
         }
 
-        std::vector<uint8_t> frame = createMessageFrame(data);
+        // frames that came in the same read as the response
+        reader->feed(handshakeResponse->leftover());
+
+        while (isConnected()) {
+            if (!processIncoming()) {
+                return;
+            }
+
+            if (keepalive.interval.count() > 0 && !waitReadable()) {
+                return;
+            }
+
+            auto res = reader->fill(*stream);
+            if (res.isErr()) {
+                LOG_ERROR("unable to receieve message: {}", res.unwrapErr());
+                return;
+            }
+
+            if (res.unwrap() == 0) {
+                LOG_INFO("connection closed by server");
+                break;
+            }
+        }
 
-        CHECK_UNWRAP(
-            stream->send(frame.data(), frame.size()),
-            "unable to send message frame: {}", res.unwrapErr()
-        )
+        close();
     }
 
-    void Client::close() {
-        if (stream) {
-            CHECK_UNWRAP(
-                stream->shutdown(),
-                "unable to shutdown stream: {}", res.unwrapErr()
-            )
+    bool Client::waitReadable() {
+        // the read blocks, so with keepalive on wait for data no longer than the next ping or pong deadline
+        while (isConnected()) {
+            if (stream->hasPendingInput()) {
+                return true;
+            }
+
+            auto now = Clock::now();
+            keepaliveTick(now);
+
+            if (!isConnected()) {
+                return false;
+            }
+
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(nextKeepaliveDeadline() - now);
+
+            if (stream->waitReadable(wait)) {
+                return true;
+            }
         }
+
+        return false;
     }
 
-    std::string Client::severityToString(LogSeverity severity) {
-        std::map<LogSeverity, std::string> severityMap = {
-            { LogSeverity::Debug, "Debug" },
-            { LogSeverity::Error, "Error" },
-            { LogSeverity::Info, "Info" }
-        };
-        return severityMap[severity];
+    void Client::reactorReadable() {
+        if (!connected) {
+            while (true) {
+                uint8_t buffer[4096];
+                auto res = stream->tryReceive(buffer, sizeof(buffer));
+                if (res.isErr()) {
+                    LOG_ERROR("unable to receive handshake response: {}", res.unwrapErr());
+                    setCloseReason(res.unwrapErr());
+                    close();
+                    return;
+                }
+
+                if (!res.unwrap()) {
+                    return;
+                }
+
+                if (*res.unwrap() == 0) {
+                    LOG_ERROR("connection closed during handshake");
+                    setCloseReason("connection closed during handshake");
+                    close();
+                    return;
+                }
+
+                auto state = handshakeResponse->feed({buffer, *res.unwrap()});
+
+                if (state == HttpResponseParser::State::Error) {
+                    LOG_ERROR("invalid handshake response: {}", handshakeResponse->error());
+                    setCloseReason(fmt::format("invalid handshake response: {}", handshakeResponse->error()));
+                    close();
+                    return;
+                }
+
+                if (state == HttpResponseParser::State::Complete) {
+                    if (auto res = completeHandshake(*handshakeResponse); res.isErr()) {
+                        LOG_ERROR("{}", res.unwrapErr());
+                        setCloseReason(res.unwrapErr());
+                        close();
+                        return;
+                    }
+
+                    reader->feed(handshakeResponse->leftover());
+
+                    // the coroutine reads for itself once it calls receive()
+                    if (connectWaiter) {
+                        std::exchange(connectWaiter, nullptr).resume();
+                        return;
+                    }
+
+                    break;
+                }
+            }
+        }
+
+        if (!readAvailable()) {
+            return;
+        }
+
+        if (!incoming) {
+            return;
+        }
+
+        // resuming may end the coroutine that owns this client, so it is the last thing done here
+        if (receiveWaiter && !incomingTaken) {
+            std::exchange(receiveWaiter, nullptr).resume();
+            return;
+        }
+
+        // the coroutine still holds a message and has not asked for the next
+        readPaused = true;
+        updateInterest();
+    }
+
+    bool Client::readAvailable() {
+        // level triggered, but TLS may hold decrypted bytes the socket no longer signals, so read until it would block.
+        // a callback may close the client along the way
+        while (connected) {
+            if (!processIncoming()) {
+                return false;
+            }
+
+            if (!connected) {
+                return false;
+            }
+
+            if (incoming || dispatchBudget == 0 || readBudget == 0) {
+                // delivery stopped for now; past the mark the socket is left to TCP flow control until it goes on
+                if (!readPaused && undeliveredFull()) {
+                    readPaused = true;
+                    updateInterest();
+                }
+
+                return true;
+            }
+
+            // everything complete was delivered, so what is left needs more bytes
+            if (readPaused) {
+                readPaused = false;
+                updateInterest();
+            }
+
+            // up to the mark; a message larger than it on its own is still read whole
+            size_t room = SIZE_MAX;
+            if (backpressure.maxUndelivered > 0 && reader->buffered() < backpressure.maxUndelivered) {
+                room = backpressure.maxUndelivered - reader->buffered();
+            }
+
+            auto res = reader->tryFill(*stream, room);
+            if (res.isErr()) {
+                LOG_ERROR("unable to receieve message: {}", res.unwrapErr());
+                setCloseReason(res.unwrapErr());
+                close();
+                return false;
+            }
+
+            if (!res.unwrap()) {
+                return true;
+            }
+
+            if (*res.unwrap() == 0) {
+                LOG_INFO("connection closed by server");
+                setCloseReason("connection closed by server");
+                close();
+                return false;
+            }
+
+            readBudget -= std::min(readBudget, *res.unwrap());
+        }
+
+        return false;
+    }
+
+    bool Client::undeliveredFull() const {
+        return backpressure.maxUndelivered > 0 && reader->buffered() >= backpressure.maxUndelivered;
+    }
+
+    void Client::reactorWritable() {
+        auto res = flushOutbox();
+        if (res.isErr()) {
+            LOG_ERROR("unable to send message frame: {}", res.unwrapErr());
+            setCloseReason(res.unwrapErr());
+            close();
+            return;
+        }
+
+        this->resumeSenders();
+    }
+
+    void Client::resumeSenders() {
+        if (sendWaiters.empty()) {
+            return;
+        }
+
+        std::vector<std::coroutine_handle<>> ready;
+        std::erase_if(sendWaiters, [&](const SendWaiter& waiter) {
+            if (waiter.sequence > dataWritten) {
+                return false;
+            }
+
+            ready.push_back(waiter.handle);
+            return true;
+        });
+
+        // resuming may end the coroutine that owns this client, so nothing of it is touched afterwards
+        for (auto handle : ready) {
+            handle.resume();
+        }
+    }
+
+    void Client::setCloseReason(std::string_view reason) {
+        std::lock_guard lock(closeMutex);
+        if (closeReason.empty()) {
+            closeReason = reason;
+        }
+    }
+
+    bool Client::hasCloseReason() const {
+        std::lock_guard lock(closeMutex);
+        return !closeReason.empty();
+    }
+
+    std::string Client::closeError() const {
+        std::lock_guard lock(closeMutex);
+        return closeReason.empty() ? std::string("not connected") : closeReason;
+    }
+
+    void Client::failWaiters(std::string_view reason) {
+        if (!reactor) {
+            return;
+        }
+
+        setCloseReason(reason);
+
+        // resumed from the loop rather than here, which may be deep inside this client or on another thread
+        for (auto handle : {std::exchange(connectWaiter, nullptr), std::exchange(receiveWaiter, nullptr)}) {
+            if (handle) {
+                reactor->post(handle);
+            }
+        }
+
+        for (auto& waiter : sendWaiters) {
+            reactor->post(waiter.handle);
+        }
+
+        sendWaiters.clear();
+    }
+
+    void Client::reactorTimer(TimePoint now) {
+        // an older wakeup can fire after a newer, earlier one was scheduled
+        if (now >= armedDeadline) {
+            timerArmed = false;
+        }
+
+        keepaliveTick(now);
+
+        if (reactorId != 0 && connected) {
+            armKeepaliveTimer();
+        }
+    }
+
+    Result<> Client::flushOutbox() {
+        while (true) {
+            // refill once the previous batch is fully written, so each wakeup costs one write
+            if (outboxOffset == outbox.size()) {
+                outbox.clear();
+                outboxOffset = 0;
+                dataWritten = dataEncoded;
+                releaseBuffered(std::exchange(outboxPayloadBytes, 0));
+
+                // a sender trimming the queue (see OverflowPolicy::DropOldest) holds the writer role for a moment;
+                // it queues a frame right after, which brings us back
+                if (connected && sendQueue->tryBeginWrite()) {
+                    encodeQueuedFrames(outbox);
+                    sendQueue->endWrite();
+                }
+            }
+
+            if (outbox.empty() && !stream->hasPendingOutput()) {
+                break;
+            }
+
+            ConstBuffer buffer{outbox.data() + outboxOffset, outbox.size() - outboxOffset};
+            GEODE_UNWRAP_INTO(auto sent, stream->trySendv({&buffer, 1}));
+
+            if (!sent || (*sent == 0 && buffer.size > 0)) {
+                break;
+            }
+
+            outboxOffset += *sent;
+        }
+
+        this->updateInterest();
+
+        return Ok();
+    }
+
+    void Client::updateInterest() {
+        if (!reactor) {
+            return;
+        }
+
+        bool pending = outboxOffset < outbox.size() || stream->hasPendingOutput();
+        reactor->setInterest(reactorId, stream->nativeHandle(), !readPaused, pending);
+    }
+
+    void Client::dispatchMessage(Opcode opcode, std::span<const uint8_t> payload) {
+        if (opcode == Opcode::Binary && binaryCallback) {
+            binaryCallback(std::as_bytes(payload));
+            return;
+        }
+
+        std::string_view text{reinterpret_cast<const char*>(payload.data()), payload.size()};
+
+        if (msgViewCallback) {
+            msgViewCallback(text);
+        } else if (msgCallback) {
+            msgCallback(std::string(text));
+        }
+    }
+
+    bool Client::handleControl(Opcode opcode, std::span<const uint8_t> payload) {
+        switch (opcode) {
+            case Opcode::Ping:
+                sendFrame(Opcode::Pong, payload);
+                return true;
+
+            case Opcode::Pong:
+                handlePong(payload);
+                return true;
+
+            default:
+                break;
+        }
+
+        uint16_t code = 1005;
+        std::string_view reason;
+        if (payload.size() >= 2) {
+            code = static_cast<uint16_t>((payload[0] << 8) | payload[1]);
+            reason = {reinterpret_cast<const char*>(payload.data()) + 2, payload.size() - 2};
+        }
+
+        // a lone byte is half a code, and codes that must not be sent are not echoed back either
+        if (payload.size() == 1 || (payload.size() >= 2 && !isValidCloseCode(code))) {
+            fail(1002, "invalid close frame");
+            return false;
+        }
+
+        LOG_INFO("server closed the connection ({}): {}", code, reason);
+        setCloseReason(fmt::format("server closed the connection ({}): {}", code, reason));
+
+        // echo the code back (RFC 6455 section 5.5.1); if we already sent a close, the queue drops this one
+        closeWith(code == 1005 ? 1000 : code, {});
+        return false;
+    }
+
+    void Client::startKeepalive(TimePoint now) {
+        if (keepalive.interval.count() <= 0) {
+            return;
+        }
+
+        pingOutstanding = false;
+        nextPingAt = now + keepalive.interval;
+
+        if (reactor) {
+            armKeepaliveTimer();
+        }
+    }
+
+    void Client::keepaliveTick(TimePoint now) {
+        if (keepalive.interval.count() <= 0 || !connected) {
+            return;
+        }
+
+        if (pingOutstanding) {
+            if (now - pingSentAt >= keepalive.timeout) {
+                LOG_ERROR("no pong within {}ms, closing the connection", keepalive.timeout.count());
+                setCloseReason(fmt::format("no pong within {}ms", keepalive.timeout.count()));
+                connected = false;
+                close();
+            }
+
+            return;
+        }
+
+        if (now >= nextPingAt) {
+            sendPing(now);
+        }
+    }
+
+    Client::TimePoint Client::nextKeepaliveDeadline() const {
+        return pingOutstanding ? pingSentAt + keepalive.timeout : nextPingAt;
+    }
+
+    void Client::sendPing(TimePoint now) {
+        // the pong echoes the send time back, which identifies it as the answer to this ping
+        pingStamp = static_cast<uint64_t>(now.time_since_epoch().count());
+
+        uint8_t payload[8];
+        for (size_t i = 0; i < 8; ++i) {
+            payload[i] = static_cast<uint8_t>(pingStamp >> (56 - 8 * i));
+        }
+
+        pingSentAt = now;
+        pingOutstanding = true;
+        nextPingAt = now + keepalive.interval;
+
+        sendFrame(Opcode::Ping, payload);
+    }
+
+    void Client::handlePong(std::span<const uint8_t> payload) {
+        // unsolicited pongs are allowed and carry nothing to measure
+        if (!pingOutstanding || payload.size() != 8) {
+            return;
+        }
+
+        uint64_t stamp = 0;
+        for (uint8_t byte : payload) {
+            stamp = (stamp << 8) | byte;
+        }
+
+        if (stamp != pingStamp) {
+            return;
+        }
+
+        rtt->record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - pingSentAt));
+        pingOutstanding = false;
+
+        if (reactor) {
+            armKeepaliveTimer();
+        }
+    }
+
+    void Client::armKeepaliveTimer() {
+        auto deadline = nextKeepaliveDeadline();
+
+        // an earlier wakeup is already pending, and arms the next one when it fires
+        if (timerArmed && armedDeadline <= deadline) {
+            return;
+        }
+
+        timerArmed = true;
+        armedDeadline = deadline;
+        reactor->scheduleTimer(reactorId, deadline);
+    }
+
+    void Client::sendClose(uint16_t code, std::string_view reason) {
+        reason = truncateUtf8(reason, MaxCloseReasonSize);
+
+        uint8_t payload[125];
+        payload[0] = static_cast<uint8_t>(code >> 8);
+        payload[1] = static_cast<uint8_t>(code);
+        if (!reason.empty()) {
+            std::memcpy(payload + 2, reason.data(), reason.size());
+        }
+
+        sendFrame(Opcode::Close, {payload, 2 + reason.size()});
+    }
+
+    void Client::fail(uint16_t code, std::string_view reason) {
+        LOG_ERROR("closing connection ({}): {}", code, reason);
+        closeWith(code, reason);
+    }
+
+    void Client::closeWith(uint16_t code, std::string_view reason) {
+        setCloseReason(fmt::format("closed the connection ({}): {}", code, reason));
+
+        sendClose(code, reason);
+
+        // on the reactor thread, or in poll(); push the close frame out before unregistering, as far as the socket takes it
+        if ((reactor && reactorId != 0) || (pollMode && pollReady)) {
+            (void) flushOutbox();
+        }
+
+        connected = false;
+        close();
+    }
+
+    void Client::onFragment(std::function<void(std::span<const std::byte> data, bool last)> callback) {
+        fragmentCallback = callback;
+        reader->streaming = static_cast<bool>(fragmentCallback);
+    }
+
+    void Client::enableCompression(CompressionOptions options) {
+        compressionOptions = options;
+    }
+
+    void Client::setMaxMessageSize(size_t size) {
+        reader->maxMessageSize = size;
+    }
+
+    void Client::setBackpressure(BackpressureOptions options) {
+        backpressure = options;
+    }
+
+    Client::SendAwaiter Client::send(std::string_view data) {
+        return send(std::as_bytes(std::span{data}), Opcode::Text);
+    }
+
+    Client::SendAwaiter Client::send(std::span<const std::byte> data, Opcode opcode) {
+        std::span<const uint8_t> bytes{reinterpret_cast<const uint8_t*>(data.data()), data.size()};
+
+        if (!isConnected()) {
+            LOG_DEBUG("adding to queue");
+        }
+
+        if (!this->admit(bytes.size())) {
+            return SendAwaiter{this, 0, true};
+        }
+
+        return SendAwaiter{this, sendFrame(opcode, bytes)};
+    }
+
+    Client::ConnectAwaiter Client::connect(ServerAddress address) {
+        return ConnectAwaiter{this, Ok(std::move(address))};
+    }
+
+    Client::ConnectAwaiter Client::connect(std::string_view url) {
+        return ConnectAwaiter{this, parseUrl(url)};
+    }
+
+    Client::ReceiveAwaiter Client::receive() {
+        return ReceiveAwaiter{this};
+    }
+
+    bool Client::ConnectAwaiter::await_suspend(std::coroutine_handle<> handle) {
+        if (address.isErr()) {
+            error = address.unwrapErr();
+            return false;
+        }
+
+        if (!client->reactor) {
+            error = "connect() needs a reactor, see setReactor()";
+            return false;
+        }
+
+        // a failure on the connecting thread hands the handle to the reactor, which only resumes it after this returns
+        client->connectWaiter = handle;
+
+        if (auto res = client->open(address.unwrap()); res.isErr()) {
+            client->connectWaiter = nullptr;
+            error = res.unwrapErr();
+            return false;
+        }
+
+        client->awaitable = true;
+        return true;
+    }
+
+    Result<> Client::ConnectAwaiter::await_resume() {
+        if (!error.empty()) {
+            return Err(error);
+        }
+
+        if (!client->connected) {
+            return Err(client->closeError());
+        }
+
+        return Ok();
+    }
+
+    bool Client::pollReceive() {
+        if (!awaitable || !connected) {
+            return true;
+        }
+
+        // the previous message is given up, parsing carries on behind it
+        if (incomingTaken) {
+            incoming.reset();
+            incomingTaken = false;
+        }
+
+        if (incoming) {
+            return true;
+        }
+
+        if (readPaused) {
+            readPaused = false;
+            updateInterest();
+        }
+
+        readAvailable();
+        return incoming || !connected;
+    }
+
+    bool Client::ReceiveAwaiter::await_ready() {
+        return client->pollReceive();
+    }
+
+    void Client::ReceiveAwaiter::await_suspend(std::coroutine_handle<> handle) {
+        client->receiveWaiter = handle;
+    }
+
+    Result<ReceivedMessage> Client::ReceiveAwaiter::await_resume() {
+        if (client->incoming && !client->incomingTaken) {
+            client->incomingTaken = true;
+            return Ok(*client->incoming);
+        }
+
+        if (!client->awaitable) {
+            return Err("receive() needs a connection opened with connect()");
+        }
+
+        return Err(client->closeError());
+    }
+
+    bool Client::SendAwaiter::await_ready() const {
+        // without a reactor the message went out in send() already, or waits for the handshake with nobody to tell
+        return refused || !client->reactor || sequence <= client->dataWritten || client->hasCloseReason();
+    }
+
+    void Client::SendAwaiter::await_suspend(std::coroutine_handle<> handle) {
+        client->sendWaiters.push_back({sequence, handle});
+    }
+
+    Result<> Client::SendAwaiter::await_resume() const {
+        if (refused) {
+            return Err("send buffer full");
+        }
+
+        if (client->reactor && sequence > client->dataWritten) {
+            return Err(client->closeError());
+        }
+
+        return Ok();
+    }
+
+    void Client::setResolver(std::shared_ptr<ResolverCache> cache) {
+        resolverCache = std::move(cache);
+    }
+
+    void Client::setConnectOptions(ConnectOptions options) {
+        connectOptions = options;
+    }
+
+    void Client::setHandshakePipelining(bool enabled) {
+        pipelineHandshake = enabled;
+    }
+
+    void Client::setEarlyData(bool enabled) {
+        earlyDataEnabled = enabled;
+    }
+
+    void Client::setTlsContext(std::shared_ptr<TlsContext> context) {
+        tlsContext = std::move(context);
+    }
+
+    void Client::setKeepalive(KeepaliveOptions options) {
+        keepalive = options;
+    }
+
+    LatencyStats Client::latency() const {
+        return rtt->snapshot();
+    }
+
+    MetricsSnapshot Client::metrics() const {
+        return counters->snapshot();
+    }
+
+    void Client::setReactor(Reactor* reactor) {
+        this->reactor = reactor;
+    }
+
+    void Client::setPollMode(bool enabled) {
+        pollMode = enabled;
+    }
+
+    bool Client::wantsWrite() const {
+        return outboxOffset < outbox.size() || stream->hasPendingOutput();
+    }
+
+    size_t Client::pollService(short events, PollLimits limits) {
+        dispatchBudget = std::max<size_t>(limits.maxMessages, 1);
+        readBudget = std::max<size_t>(limits.maxReadBytes, 1);
+
+        keepaliveTick(Clock::now());
+
+        // queued frames, and the upgrade request until it is out
+        if (pollReady && (events & POLLOUT || (connected && !sendQueue->empty()))) {
+            this->reactorWritable();
+        }
+
+        if (pollReady && (events & (POLLIN | POLLHUP | POLLERR) || pollBacklog || stream->hasPendingInput())) {
+            this->reactorReadable();
+        }
+
+        size_t dispatched = std::max<size_t>(limits.maxMessages, 1) - dispatchBudget;
+        pollBacklog = connected && (dispatchBudget == 0 || readBudget == 0);
+
+        dispatchBudget = SIZE_MAX;
+        readBudget = SIZE_MAX;
+
+        // pongs, and whatever the callbacks sent
+        if (pollReady && connected && !sendQueue->empty()) {
+            this->reactorWritable();
+        }
+
+        return dispatched;
+    }
+
+    size_t Client::poll(std::chrono::milliseconds timeout, PollLimits limits) {
+        Client* self = this;
+        return pollAll({&self, 1}, timeout, limits);
+    }
+
+    size_t Client::pollAll(std::span<Client* const> clients, std::chrono::milliseconds timeout, PollLimits limits) {
+        // kept between calls, so polling every frame does not allocate; a callback polling from inside
+        // the dispatch loop below gets its own, since the outer call is still walking these
+        thread_local std::vector<pollfd> cachedFds;
+        thread_local std::vector<Client*> cachedPolled;
+        thread_local bool dispatching = false;
+
+        std::vector<pollfd> nestedFds;
+        std::vector<Client*> nestedPolled;
+        bool nested = dispatching;
+        auto& fds = nested ? nestedFds : cachedFds;
+        auto& polled = nested ? nestedPolled : cachedPolled;
+        fds.clear();
+        polled.clear();
+
+        auto now = Clock::now();
+        auto wait = std::max<int64_t>(timeout.count(), 0);
+
+        for (auto client : clients) {
+            if (!client->pollMode || !client->pollReady.load(std::memory_order_acquire)) {
+                continue;
+            }
+
+            // work left over from the last call is done right away, and no wait outlasts a keepalive deadline
+            bool queued = client->connected && !client->sendQueue->empty();
+            if (client->pollBacklog || client->stream->hasPendingInput() || queued) {
+                wait = 0;
+            } else if (client->connected && client->keepalive.interval.count() > 0) {
+                auto untilDeadline = std::chrono::ceil<std::chrono::milliseconds>(client->nextKeepaliveDeadline() - now);
+                wait = std::clamp<int64_t>(untilDeadline.count(), 0, wait);
+            }
+
+            // a paused client still gets to dispatch its backlog, it just is not read
+            short events = (client->readPaused ? 0 : POLLIN) | (client->wantsWrite() ? POLLOUT : 0);
+            fds.push_back({static_cast<qsox::SockFd>(client->stream->nativeHandle()), events, 0});
+            polled.push_back(client);
+        }
+
+        if (polled.empty()) {
+            return 0;
+        }
+
+        int waitMs = static_cast<int>(std::min<int64_t>(wait, std::numeric_limits<int>::max()));
+        if (pollSockets(fds.data(), fds.size(), waitMs) < 0 && lastSocketErrorCode() != EINTR) {
+            return 0;
+        }
+
+        size_t dispatched = 0;
+        dispatching = true;
+        for (size_t i = 0; i < polled.size(); ++i) {
+            dispatched += polled[i]->pollService(fds[i].revents, limits);
+        }
+        dispatching = nested;
+
+        return dispatched;
+    }
+
+    void Client::setMemoryResource(std::pmr::memory_resource* memory) {
+        this->memory = memory;
+        sendQueue->memory = memory;
+
+        // the reader allocates its buffers up front, so swap in one built on the new resource
+        auto fresh = std::make_unique<FrameReader>(memory);
+        fresh->maxMessageSize = reader->maxMessageSize;
+        fresh->streaming = reader->streaming;
+        fresh->metrics = reader->metrics;
+        reader = std::move(fresh);
+    }
+
+    void Client::setUringDriver(std::shared_ptr<UringDriver> driver) {
+        uringDriver = std::move(driver);
+    }
+
+    void Client::close() {
+        connected = false;
+        pollReady = false;
+
+        if (reactor) {
+            // ordered with the connecting thread's add, see open()
+            std::lock_guard lock(reactor->loopMutex);
+            connectCancelled = true;
+
+            if (reactorId != 0) {
+                reactor->remove(reactorId, stream->nativeHandle());
+                reactorId = 0;
+            }
+        } else {
+            connectCancelled = true;
+        }
+
+        this->failWaiters("connection closed");
+
+        // senders blocked on a full buffer give up
+        {
+            std::lock_guard lock(bufferMutex);
+        }
+        bufferSpace.notify_all();
+
+        if (stream) {
+            CHECK_UNWRAP(
+                stream->shutdown(),
+                "unable to shutdown stream: {}", res.unwrapErr()
+            )
+        }
+    }
+
+    void Client::writeLog(LogSeverity severity, std::string_view source, std::string_view message) {
+        logCallback(LogRecord{
+            .severity = severity,
+            .connectionId = clientId,
+            .source = source,
+            .message = message
+        });
+    }
+
+    void Client::onLog(std::function<void(LogSeverity, std::string)> callback) {
+        if (!callback) {
+            logCallback = nullptr;
+            return;
+        }
+
+        logCallback = [callback = std::move(callback)](const LogRecord& record) {
+            callback(record.severity, std::string(record.message));
+        };
+    }
+
+    std::string Client::severityToString(LogSeverity severity) {
+        switch (severity) {
+            case LogSeverity::Debug: return "Debug";
+            case LogSeverity::Info: return "Info";
+            case LogSeverity::Error: return "Error";
+        }
+
+        return "Unknown";
     }
 }